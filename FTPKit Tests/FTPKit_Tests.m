@@ -9,12 +9,28 @@
 #import <XCTest/XCTest.h>
 #import "FTPKit.h"
 #import "FTPKit+Protected.h"
+#import "FTPDownloadJournal.h"
 #import "NSDate+NSDate_Additions.h"
 
 @interface FTPKit_Tests : XCTestCase
 
 @end
 
+// FTPClient.m 안의 MLSD/MLST 파싱 메소드
+@interface FTPClient (ParserTests)
+- (NSArray<FTPItem *> * _Nullable)parseMachineListFromLists:(NSString * _Nullable)listString showHiddentFiles:(BOOL)showHiddenFiles;
+- (NSDictionary<NSString *, NSString *> * _Nullable)factsFromLine:(NSString * _Nonnull)line
+                                                          pathname:(NSString * _Nullable * _Nonnull)pathname;
+- (FTPItem * _Nonnull)itemWithFacts:(NSDictionary<NSString *, NSString *> * _Nonnull)facts
+                           filename:(NSString * _Nonnull)filename;
+- (NSDate * _Nullable)dateFromTimeValue:(NSString * _Nullable)value;
+@end
+
+// FTPDownloadJournal.m 안의 구간 병합 메소드
+@interface FTPDownloadJournal (JournalTests)
++ (NSArray<NSArray<NSNumber *> *> * _Nonnull)mergeRanges:(NSArray<NSArray<NSNumber *> *> * _Nonnull)ranges;
+@end
+
 @implementation FTPKit_Tests
 
 - (void)setUp
@@ -39,6 +55,401 @@
     
 }
 
+/**
+ 파싱 테스트용 FTPClient. 접속하지 않는다
+ */
+- (FTPClient *)parserClient
+{
+    return [FTPClient clientWithHost:@"localhost"
+                                port:21
+                            encoding:NSUTF8StringEncoding
+                            username:@"anonymous"
+                            password:@""];
+}
+
+- (void)testFactsFromLine
+{
+    FTPClient *ftp = [self parserClient];
+    NSString *pathname = nil;
+    
+    // 사실 이름은 소문자로 바뀌고, 경로는 첫 공백 뒤의 나머지 전체
+    NSDictionary<NSString *, NSString *> *facts = [ftp factsFromLine:@"Type=file;Size=1024;Modify=20240102030405;UNIQUE=801g4804; my file.txt\r\n"
+                                                            pathname:&pathname];
+    XCTAssertEqualObjects(facts[@"type"], @"file");
+    XCTAssertEqualObjects(facts[@"size"], @"1024");
+    XCTAssertEqualObjects(facts[@"modify"], @"20240102030405");
+    XCTAssertEqualObjects(facts[@"unique"], @"801g4804");
+    XCTAssertEqualObjects(pathname, @"my file.txt");
+    
+    // 값에 = 이 들어간 심볼릭 링크는 첫 = 에서 나눈다
+    facts = [ftp factsFromLine:@"type=OS.unix=slink:/var/target;perm=r; link" pathname:&pathname];
+    XCTAssertEqualObjects(facts[@"type"], @"OS.unix=slink:/var/target");
+    XCTAssertEqualObjects(facts[@"perm"], @"r");
+    XCTAssertEqualObjects(pathname, @"link");
+    
+    // 사실이 없는 줄은 빈 사전
+    facts = [ftp factsFromLine:@" empty" pathname:&pathname];
+    XCTAssertNotNil(facts);
+    XCTAssertEqual([facts count], 0);
+    XCTAssertEqualObjects(pathname, @"empty");
+    
+    // 이름이 없거나 = 이 없는 사실은 건너뛴다
+    facts = [ftp factsFromLine:@"=x;size;type=dir; dir" pathname:&pathname];
+    XCTAssertEqual([facts count], 1);
+    XCTAssertEqualObjects(facts[@"type"], @"dir");
+    
+    // 경로가 없는 줄은 형식 오류
+    XCTAssertNil([ftp factsFromLine:@"type=file;size=1;" pathname:&pathname]);
+    XCTAssertNil([ftp factsFromLine:@"type=file;size=1; " pathname:&pathname]);
+    XCTAssertNil([ftp factsFromLine:@"" pathname:&pathname]);
+}
+
+- (void)testItemWithFacts
+{
+    FTPClient *ftp = [self parserClient];
+    
+    FTPItem *item = [ftp itemWithFacts:@{ @"type": @"file", @"size": @"4294967296", @"modify": @"20240102030405", @"unique": @"u1" }
+                              filename:@"big.bin"];
+    XCTAssertEqualObjects(item.filename, @"big.bin");
+    XCTAssertFalse(item.isDir);
+    XCTAssertFalse(item.isHidden);
+    XCTAssertEqual(item.size, 4294967296L);
+    XCTAssertEqualObjects(item.modificationDate, [NSDate dateWithTimeIntervalSince1970:1704164645]);
+    XCTAssertEqualObjects(item.uniqueIdentifier, @"u1");
+    
+    // 심볼릭 링크는 디렉토리로 간주한다
+    item = [ftp itemWithFacts:@{ @"type": @"OS.unix=slink:/var/target" } filename:@"link"];
+    XCTAssertTrue(item.isDir);
+    item = [ftp itemWithFacts:@{ @"type": @"os.unix=symlink" } filename:@"link"];
+    XCTAssertTrue(item.isDir);
+    
+    // 디렉토리 크기는 size 가 없으면 sizd
+    item = [ftp itemWithFacts:@{ @"type": @"Dir", @"sizd": @"4096" } filename:@".config"];
+    XCTAssertTrue(item.isDir);
+    XCTAssertTrue(item.isHidden);
+    XCTAssertEqual(item.size, 4096);
+    
+    // 사실이 없는 경우
+    item = [ftp itemWithFacts:@{} filename:@"unknown"];
+    XCTAssertFalse(item.isDir);
+    XCTAssertEqual(item.size, 0);
+    XCTAssertNil(item.modificationDate);
+    XCTAssertNil(item.uniqueIdentifier);
+}
+
+- (void)testDateFromTimeValue
+{
+    FTPClient *ftp = [self parserClient];
+    
+    XCTAssertEqualObjects([ftp dateFromTimeValue:@"20240102030405"], [NSDate dateWithTimeIntervalSince1970:1704164645]);
+    XCTAssertEqualObjects([ftp dateFromTimeValue:@" 19991231235959\r\n"], [NSDate dateWithTimeIntervalSince1970:946684799]);
+    // 밀리초 이하 부분
+    XCTAssertEqualWithAccuracy([[ftp dateFromTimeValue:@"20240102030405.25"] timeIntervalSince1970], 1704164645.25, 0.0001);
+    XCTAssertEqualWithAccuracy([[ftp dateFromTimeValue:@"20240102030405.123456"] timeIntervalSince1970], 1704164645.123456, 0.0001);
+    // 형식 오류
+    XCTAssertNil([ftp dateFromTimeValue:nil]);
+    XCTAssertNil([ftp dateFromTimeValue:@""]);
+    XCTAssertNil([ftp dateFromTimeValue:@"2024010203"]);
+    XCTAssertNil([ftp dateFromTimeValue:@"2024010203xx5959"]);
+}
+
+- (void)testParseEpsv
+{
+    XCTAssertEqual(FtpParseEpsv("229 Entering Extended Passive Mode (|||6446|)"), 6446);
+    // | 가 아닌 구분 문자
+    XCTAssertEqual(FtpParseEpsv("229 ok (!!!65535!)"), 65535);
+    // 포트 범위 오류
+    XCTAssertEqual(FtpParseEpsv("229 (|||65536|)"), 0);
+    XCTAssertEqual(FtpParseEpsv("229 (|||0|)"), 0);
+    // 형식 오류
+    XCTAssertEqual(FtpParseEpsv("229 (||||)"), 0);
+    XCTAssertEqual(FtpParseEpsv("229 (|||12a|)"), 0);
+    XCTAssertEqual(FtpParseEpsv("229 (||1|)"), 0);
+    XCTAssertEqual(FtpParseEpsv("229 (|||21"), 0);
+    XCTAssertEqual(FtpParseEpsv("229 (|"), 0);
+    XCTAssertEqual(FtpParseEpsv("229 Entering Extended Passive Mode"), 0);
+}
+
+- (void)testParseMachineList
+{
+    FTPClient *ftp = [self parserClient];
+    NSString *list = @"type=cdir;modify=20240102030405; .\r\n"
+                     @"type=pdir;modify=20240102030405; ..\r\n"
+                     @"type=CDir; /home/user\r\n"
+                     @"type=file;size=10;modify=20240102030405; a.txt\r\n"
+                     @"type=dir;modify=20240102030405; .hidden\r\n"
+                     @"type=OS.unix=slink:/tmp;modify=20240102030405; tmp\r\n"
+                     @"garbage\r\n";
+    
+    // 현재/상위 디렉토리 항목과 형식 오류 줄은 제외
+    NSArray<FTPItem *> *items = [ftp parseMachineListFromLists:list showHiddentFiles:true];
+    XCTAssertEqual([items count], 3);
+    XCTAssertEqualObjects([items valueForKey:@"filename"], (@[ @"a.txt", @".hidden", @"tmp" ]));
+    
+    // 감춤 파일 제외
+    items = [ftp parseMachineListFromLists:list showHiddentFiles:false];
+    XCTAssertEqualObjects([items valueForKey:@"filename"], (@[ @"a.txt", @"tmp" ]));
+    
+    XCTAssertNil([ftp parseMachineListFromLists:@"" showHiddentFiles:true]);
+}
+
+/**
+ 스케줄러 테스트용 FTPTransferScheduler. 공유 스케줄러와 작업을 섞지 않도록 새로 만든다
+ */
+- (FTPTransferScheduler *)schedulerWithMaximumJobs:(NSUInteger)maximum
+                                           perHost:(NSUInteger)perHost
+                                          reserved:(NSUInteger)reserved
+{
+    FTPTransferScheduler *scheduler = [[FTPTransferScheduler alloc] init];
+    scheduler.maximumConcurrentJobs = maximum;
+    scheduler.maximumJobsPerHost = perHost;
+    scheduler.reservedInteractiveJobs = reserved;
+    return scheduler;
+}
+
+/**
+ gate 가 열릴 때까지 작업자를 차지하는 작업 추가. 작업이 시작된 뒤 반환한다
+ */
+- (void)occupyScheduler:(FTPTransferScheduler *)scheduler
+                   host:(NSString *)host
+                   gate:(dispatch_semaphore_t)gate
+{
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    [scheduler scheduleJobForHost:host priority:FTPPriorityDefault block:^(FTPScheduledJob *job) {
+        dispatch_semaphore_signal(started);
+        dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+    }];
+    XCTAssertEqual(dispatch_semaphore_wait(started, dispatch_time(DISPATCH_TIME_NOW, 2 * NSEC_PER_SEC)), 0);
+}
+
+/**
+ 시작 순서를 order 에 기록하고 expectation 을 완료하는 작업 추가
+ */
+- (FTPScheduledJob *)scheduleJob:(NSString *)name
+                            host:(NSString *)host
+                        priority:(FTPPriority)priority
+                       scheduler:(FTPTransferScheduler *)scheduler
+                           order:(NSMutableArray<NSString *> *)order
+                     expectation:(XCTestExpectation *)expectation
+{
+    return [scheduler scheduleJobForHost:host priority:priority block:^(FTPScheduledJob *job) {
+        @synchronized (order) {
+            [order addObject:name];
+        }
+        [expectation fulfill];
+    }];
+}
+
+- (void)testSchedulerPriorityOrder
+{
+    // 작업자를 하나만 두고, 차지한 동안 쌓인 작업의 시작 순서를 확인
+    FTPTransferScheduler *scheduler = [self schedulerWithMaximumJobs:1 perHost:1 reserved:0];
+    dispatch_semaphore_t gate = dispatch_semaphore_create(0);
+    [self occupyScheduler:scheduler host:@"a" gate:gate];
+    
+    NSMutableArray<NSString *> *order = [[NSMutableArray alloc] init];
+    NSArray<NSArray *> *jobs = @[ @[ @"background", @(FTPPriorityBackground) ],
+                                  @[ @"default-1", @(FTPPriorityDefault) ],
+                                  @[ @"interactive-1", @(FTPPriorityInteractive) ],
+                                  @[ @"default-2", @(FTPPriorityDefault) ],
+                                  @[ @"interactive-2", @(FTPPriorityInteractive) ] ];
+    for (NSArray *job in jobs) {
+        [self scheduleJob:job[0]
+                     host:@"a"
+                 priority:(FTPPriority)[job[1] intValue]
+                scheduler:scheduler
+                    order:order
+              expectation:[self expectationWithDescription:job[0]]];
+    }
+    XCTAssertEqual(scheduler.pendingJobCount, 5);
+    XCTAssertEqual(scheduler.runningJobCount, 1);
+    
+    // 우선순위가 높은 작업부터, 같은 우선순위에서는 먼저 추가된 작업부터 시작된다
+    dispatch_semaphore_signal(gate);
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    XCTAssertEqualObjects(order, (@[ @"interactive-1", @"interactive-2", @"default-1", @"default-2", @"background" ]));
+}
+
+- (void)testSchedulerHostLimit
+{
+    // 호스트별 2개 중 1개는 FTPPriorityInteractive 작업용으로 남겨 둔다
+    FTPTransferScheduler *scheduler = [self schedulerWithMaximumJobs:8 perHost:2 reserved:1];
+    dispatch_semaphore_t gate = dispatch_semaphore_create(0);
+    [self occupyScheduler:scheduler host:@"a" gate:gate];
+    
+    // 같은 호스트의 일반 작업은 남은 작업자가 있어도 기다린다
+    NSMutableArray<NSString *> *order = [[NSMutableArray alloc] init];
+    XCTestExpectation *queued = [self expectationWithDescription:@"default-a"];
+    [self scheduleJob:@"default-a" host:@"a" priority:FTPPriorityDefault scheduler:scheduler order:order expectation:queued];
+    XCTAssertEqual(scheduler.pendingJobCount, 1);
+    XCTAssertEqual(scheduler.runningJobCount, 1);
+    
+    // 목록 요청은 남겨 둔 작업자로, 다른 호스트의 작업은 a 의 제한과 관계없이 바로 시작된다
+    XCTestExpectation *interactive = [self expectationWithDescription:@"interactive-a"];
+    XCTestExpectation *otherHost = [self expectationWithDescription:@"default-b"];
+    [self scheduleJob:@"interactive-a" host:@"a" priority:FTPPriorityInteractive scheduler:scheduler order:order expectation:interactive];
+    [self scheduleJob:@"default-b" host:@"b" priority:FTPPriorityDefault scheduler:scheduler order:order expectation:otherHost];
+    [self waitForExpectations:@[ interactive, otherHost ] timeout:2];
+    XCTAssertEqual(scheduler.pendingJobCount, 1);
+    
+    // 차지한 작업이 끝나면 기다리던 작업이 시작된다
+    dispatch_semaphore_signal(gate);
+    [self waitForExpectations:@[ queued ] timeout:2];
+    XCTAssertEqualObjects([order lastObject], @"default-a");
+}
+
+- (void)testSchedulerReprioritize
+{
+    FTPTransferScheduler *scheduler = [self schedulerWithMaximumJobs:1 perHost:1 reserved:0];
+    dispatch_semaphore_t gate = dispatch_semaphore_create(0);
+    [self occupyScheduler:scheduler host:@"a" gate:gate];
+    
+    NSMutableArray<NSString *> *order = [[NSMutableArray alloc] init];
+    FTPScheduledJob *background = [self scheduleJob:@"background"
+                                               host:@"a"
+                                           priority:FTPPriorityBackground
+                                          scheduler:scheduler
+                                              order:order
+                                        expectation:[self expectationWithDescription:@"background"]];
+    [self scheduleJob:@"default" host:@"a" priority:FTPPriorityDefault scheduler:scheduler order:order expectation:[self expectationWithDescription:@"default"]];
+    
+    // 대기 중에 올린 우선순위는 다음 작업을 고를 때 반영된다
+    background.priority = FTPPriorityInteractive;
+    XCTAssertFalse(background.isStarted);
+    dispatch_semaphore_signal(gate);
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    XCTAssertEqualObjects(order, (@[ @"background", @"default" ]));
+}
+
+- (void)testSchedulerCancelledJobBypassesLimits
+{
+    FTPTransferScheduler *scheduler = [self schedulerWithMaximumJobs:1 perHost:1 reserved:0];
+    dispatch_semaphore_t gate = dispatch_semaphore_create(0);
+    [self occupyScheduler:scheduler host:@"a" gate:gate];
+    
+    __block BOOL wasCancelled = false;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"cancelled"];
+    FTPScheduledJob *job = [scheduler scheduleJobForHost:@"a" priority:FTPPriorityBackground block:^(FTPScheduledJob *scheduledJob) {
+        wasCancelled = scheduledJob.isCancelled;
+        [expectation fulfill];
+    }];
+    XCTAssertEqual(scheduler.pendingJobCount, 1);
+    
+    // 취소된 작업은 작업자가 모두 차 있어도 바로 실행되어 자원을 정리한다
+    [job cancel];
+    [self waitForExpectations:@[ expectation ] timeout:2];
+    XCTAssertTrue(wasCancelled);
+    XCTAssertEqual(scheduler.pendingJobCount, 0);
+    dispatch_semaphore_signal(gate);
+}
+
+/**
+ 저널 테스트용 임시 디렉토리 생성
+ */
+- (NSString *)journalTestDirectory
+{
+    NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    XCTAssertTrue([[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:true attributes:nil error:NULL]);
+    return directory;
+}
+
+/**
+ 저장 경로의 저널 파일을 직접 기록. 잘못된 저널을 만들 때 사용한다
+ */
+- (void)writeJournal:(NSDictionary *)dictionary savePath:(NSString *)savePath
+{
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:dictionary
+                                                              format:NSPropertyListBinaryFormat_v1_0
+                                                             options:0
+                                                               error:NULL];
+    XCTAssertTrue([data writeToFile:[FTPDownloadJournal journalPathForSavePath:savePath] atomically:true]);
+}
+
+- (void)testDownloadJournalMergeRanges
+{
+    // 정렬되지 않은 구간, 겹치는 구간, 이어지는 구간, 빈 구간
+    NSArray *merged = [FTPDownloadJournal mergeRanges:@[ @[ @10, @20 ], @[ @0, @5 ], @[ @15, @30 ], @[ @5, @8 ],
+                                                         @[ @40, @50 ], @[ @50, @60 ], @[ @70, @70 ], @[ @12, @14 ] ]];
+    XCTAssertEqualObjects(merged, (@[ @[ @0, @8 ], @[ @10, @30 ], @[ @40, @60 ] ]));
+    XCTAssertEqualObjects([FTPDownloadJournal mergeRanges:@[]], @[]);
+}
+
+- (void)testDownloadJournalCommit
+{
+    NSString *directory = [self journalTestDirectory];
+    NSString *savePath = [directory stringByAppendingPathComponent:@"file.bin"];
+    XCTAssertTrue([[NSData data] writeToFile:savePath atomically:false]);
+    NSFileHandle *handle = [NSFileHandle fileHandleForUpdatingAtPath:savePath];
+    
+    FTPDownloadJournal *journal = [[FTPDownloadJournal alloc] initWithSavePath:savePath
+                                                                    remotePath:@"/remote/file.bin"
+                                                                      fileSize:100
+                                                              modificationDate:@"20240102030405"];
+    // 기록 전에는 저널 파일이 없다
+    XCTAssertNil([FTPDownloadJournal journalAtSavePath:savePath remotePath:@"/remote/file.bin" fileSize:100 modificationDate:@"20240102030405"]);
+    
+    // 기록할 때마다 기존 구간과 병합된다
+    XCTAssertTrue([journal commitRanges:@[ @[ @0, @10 ], @[ @10, @20 ], @[ @30, @40 ] ] fileDescriptor:handle.fileDescriptor]);
+    XCTAssertEqualObjects(journal.committedRanges, (@[ @[ @0, @20 ], @[ @30, @40 ] ]));
+    XCTAssertEqual([journal committedLength], 30);
+    XCTAssertTrue([journal commitRanges:@[ @[ @15, @35 ] ] fileDescriptor:handle.fileDescriptor]);
+    XCTAssertEqualObjects(journal.committedRanges, (@[ @[ @0, @40 ] ]));
+    
+    // 같은 원격 파일이면 기록된 구간을 다시 읽는다
+    FTPDownloadJournal *loaded = [FTPDownloadJournal journalAtSavePath:savePath remotePath:@"/remote/file.bin" fileSize:100 modificationDate:@"20240102030405"];
+    XCTAssertEqualObjects(loaded.committedRanges, (@[ @[ @0, @40 ] ]));
+    XCTAssertEqual([loaded committedLength], 40);
+    
+    // 원격 경로, 크기, 수정일이 다르면 이어받지 않는다
+    XCTAssertNil([FTPDownloadJournal journalAtSavePath:savePath remotePath:@"/remote/other.bin" fileSize:100 modificationDate:@"20240102030405"]);
+    XCTAssertNil([FTPDownloadJournal journalAtSavePath:savePath remotePath:@"/remote/file.bin" fileSize:101 modificationDate:@"20240102030405"]);
+    XCTAssertNil([FTPDownloadJournal journalAtSavePath:savePath remotePath:@"/remote/file.bin" fileSize:100 modificationDate:@"20240102030406"]);
+    XCTAssertNil([FTPDownloadJournal journalAtSavePath:savePath remotePath:@"/remote/file.bin" fileSize:100 modificationDate:@""]);
+    
+    // 동기화할 수 없는 파일 디스크립터는 기록하지 않는다
+    XCTAssertFalse([journal commitRanges:@[ @[ @40, @50 ] ] fileDescriptor:-1]);
+    XCTAssertEqualObjects(journal.committedRanges, (@[ @[ @0, @40 ] ]));
+    
+    [journal remove];
+    XCTAssertNil([FTPDownloadJournal journalAtSavePath:savePath remotePath:@"/remote/file.bin" fileSize:100 modificationDate:@"20240102030405"]);
+    [handle closeFile];
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
+- (void)testDownloadJournalRejectsInvalidRanges
+{
+    NSString *directory = [self journalTestDirectory];
+    NSString *savePath = [directory stringByAppendingPathComponent:@"file.bin"];
+    NSDictionary *header = @{ @"remotePath": @"/remote/file.bin", @"fileSize": @100, @"modificationDate": @"" };
+    FTPDownloadJournal *(^load)(NSArray *) = ^FTPDownloadJournal *(NSArray *ranges) {
+        NSMutableDictionary *dictionary = [header mutableCopy];
+        dictionary[@"ranges"] = ranges;
+        [self writeJournal:dictionary savePath:savePath];
+        return [FTPDownloadJournal journalAtSavePath:savePath remotePath:@"/remote/file.bin" fileSize:100 modificationDate:@""];
+    };
+    
+    // 저장된 구간도 병합해서 읽는다
+    XCTAssertEqualObjects(load(@[ @[ @20, @30 ], @[ @0, @10 ], @[ @5, @20 ] ]).committedRanges, (@[ @[ @0, @30 ] ]));
+    XCTAssertEqualObjects(load(@[]).committedRanges, @[]);
+    
+    // 파일 범위를 벗어난 구간
+    XCTAssertNil(load(@[ @[ @0, @101 ] ]));
+    XCTAssertNil(load(@[ @[ @-1, @10 ] ]));
+    // 빈 구간, 뒤집힌 구간
+    XCTAssertNil(load(@[ @[ @10, @10 ] ]));
+    XCTAssertNil(load(@[ @[ @20, @10 ] ]));
+    // 형식 오류
+    XCTAssertNil(load(@[ @[ @10 ] ]));
+    XCTAssertNil(load(@[ @[ @0, @10, @20 ] ]));
+    XCTAssertNil(load(@[ @"0-10" ]));
+    
+    // plist 가 아닌 저널
+    XCTAssertTrue([[@"ranges=0-10" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:[FTPDownloadJournal journalPathForSavePath:savePath] atomically:true]);
+    XCTAssertNil([FTPDownloadJournal journalAtSavePath:savePath remotePath:@"/remote/file.bin" fileSize:100 modificationDate:@""]);
+    
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
 - (void)testFtp
 {
     FTPClient * ftp = [[FTPClient alloc] initWithHost:@"djhan.asuscomm.com"
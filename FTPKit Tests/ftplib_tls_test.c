@@ -0,0 +1,153 @@
+/*
+ * ftplib_tls_test.c - ftplib FTPS 전송 테스트
+ *
+ * ftps_standin.py 에 접속해서 다음을 확인한다
+ * - 자체 서명 인증서는 FTPLIB_TLS_NOVERIFY 없이는 거부된다
+ * - FtpWriteFd 로 올리고 FtpReadFd 로 받은 파일이 원본과 같다
+ * - 데이터 접속이 제어 접속의 TLS 세션을 재사용한다
+ * - 커널 TLS 적용 여부 (FtpTLSOffload). 적용된 경우 splice/SSL_sendfile 경로로 전송된다
+ *
+ * usage: ftplib_tls_test <port> <stand-in root directory>
+ * FTPLIB_USE_OPENSSL 로 빌드해야 한다. run_ftplib_tls_test.sh 참고
+ *
+ * return 0 if every check passed
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/ssl.h>
+#include "ftplib.h"
+
+#define TEST_SIZE (3 * 1024 * 1024 + 123)
+
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok)
+        failures++;
+}
+
+/*
+ * 두 파일 내용 비교
+ *
+ * return 1 if equal, 0 otherwise
+ */
+static int same_file(const char *a, const char *b)
+{
+    FILE *fa = fopen(a, "rb");
+    FILE *fb = fopen(b, "rb");
+    int ca, cb, rv = (fa != NULL) && (fb != NULL);
+    while (rv)
+    {
+        ca = fgetc(fa);
+        cb = fgetc(fb);
+        if (ca != cb)
+            rv = 0;
+        if (ca == EOF)
+            break;
+    }
+    if (fa != NULL)
+        fclose(fa);
+    if (fb != NULL)
+        fclose(fb);
+    return rv;
+}
+
+static netbuf *login(const char *host, int flags)
+{
+    netbuf *conn;
+    if (!FtpConnect(host, &conn))
+        return NULL;
+    if (!FtpAuthTLS("localhost", flags, conn) || !FtpLogin("test", "test", conn))
+    {
+        FtpClose(conn);
+        return NULL;
+    }
+    return conn;
+}
+
+int main(int argc, char *argv[])
+{
+    char host[64], source[1024], remote[1024], target[1024];
+    netbuf *conn, *nData;
+    long long int offset;
+    int fd, i, offload = 0, reused = 1;
+    char *buf;
+
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <port> <stand-in root directory>\n", argv[0]);
+        return 2;
+    }
+    snprintf(host, sizeof(host), "127.0.0.1:%s", argv[1]);
+    snprintf(source, sizeof(source), "%s/source.bin", argv[2]);
+    snprintf(remote, sizeof(remote), "%s/uploaded.bin", argv[2]);
+    snprintf(target, sizeof(target), "%s/downloaded.bin", argv[2]);
+    FtpInit();
+
+    // 압축되지 않는 내용으로 원본 생성
+    buf = malloc(TEST_SIZE);
+    srand(5);
+    for (i = 0; i < TEST_SIZE; i++)
+        buf[i] = (char)rand();
+    fd = open(source, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    check(fd >= 0 && write(fd, buf, TEST_SIZE) == TEST_SIZE, "create source file");
+    close(fd);
+    free(buf);
+
+    conn = login(host, 0);
+    check(conn == NULL, "self-signed certificate is rejected without NOVERIFY");
+    if (conn != NULL)
+        FtpQuit(conn);
+
+    conn = login(host, FTPLIB_TLS_NOVERIFY);
+    check(conn != NULL, "AUTH TLS login with NOVERIFY");
+    if (conn == NULL)
+        return 1;
+
+    // 업로드: FtpWriteFd
+    fd = open(source, O_RDONLY);
+    check(FtpAccess("uploaded.bin", FTPLIB_FILE_WRITE, FTPLIB_IMAGE, 0, conn, &nData), "STOR data connection");
+    reused &= SSL_session_reused((SSL *)nData->tls);
+    offload |= FtpTLSOffload(nData);
+    offset = 0;
+    while ((i = FtpWriteFd(fd, offset, 1048576, nData)) > 0)
+        offset += i;
+    close(fd);
+    check(i == 0 && offset == TEST_SIZE, "FtpWriteFd sends the whole file");
+    check(FtpClose(nData), "STOR completes with 226");
+    check(same_file(source, remote), "uploaded file matches source");
+
+    // 다운로드: FtpReadFd
+    fd = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    check(FtpAccess("source.bin", FTPLIB_FILE_READ, FTPLIB_IMAGE, 0, conn, &nData), "RETR data connection");
+    reused &= SSL_session_reused((SSL *)nData->tls);
+    offload |= FtpTLSOffload(nData);
+    offset = 0;
+    while ((i = FtpReadFd(fd, offset, 1048576, nData)) > 0)
+        offset += i;
+    close(fd);
+    check(i == 0 && offset == TEST_SIZE, "FtpReadFd receives the whole file");
+    check(FtpClose(nData), "RETR completes with 226");
+    check(same_file(source, target), "downloaded file matches source");
+
+    check(reused, "data connections resume the control TLS session");
+    check(FtpPing(FTPLIB_PING_TIMEOUT, conn), "control connection is usable after transfers");
+    FtpQuit(conn);
+
+    // 커널 TLS 는 커널 모듈과 OpenSSL 빌드에 따라 다르므로 결과만 출력한다
+    printf("INFO: kernel TLS send %s, receive %s\n",
+           (offload & FTPLIB_KTLS_SEND) ? "active" : "inactive",
+           (offload & FTPLIB_KTLS_RECV) ? "active" : "inactive");
+
+    unlink(source);
+    unlink(remote);
+    unlink(target);
+    printf("%d failure(s)\n", failures);
+    return failures != 0;
+}
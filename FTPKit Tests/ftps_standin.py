@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""
+ftplib TLS 테스트용 최소 FTPS (AUTH TLS) 서버.
+
+- 시작할 때 openssl 로 자체 서명 인증서를 만들고, 첫 줄에 "PORT <번호>" 를 출력한다
+- 데이터 접속은 PROT P 인 경우 TLS 로 감싸며, 제어 접속의 세션 재사용 여부를 "DATA reused=<0|1>" 로 출력한다
+
+usage: ftps_standin.py <root directory>
+"""
+import os
+import socket
+import ssl
+import subprocess
+import sys
+import tempfile
+import threading
+
+ROOT = os.path.abspath(sys.argv[1])
+CERTDIR = tempfile.mkdtemp()
+CERT = os.path.join(CERTDIR, 'cert.pem')
+KEY = os.path.join(CERTDIR, 'key.pem')
+subprocess.run(['openssl', 'req', '-x509', '-newkey', 'rsa:2048', '-nodes', '-days', '1',
+                '-subj', '/CN=localhost', '-keyout', KEY, '-out', CERT],
+               check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+CTX = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+CTX.load_cert_chain(CERT, KEY)
+# 커널 TLS 를 지원하는 Python/OpenSSL 인 경우 서버도 사용
+if hasattr(ssl, 'OP_ENABLE_KTLS'):
+    CTX.options |= ssl.OP_ENABLE_KTLS
+LOCK = threading.Lock()
+
+
+def report(line):
+    with LOCK:
+        print(line, flush=True)
+
+
+class Session(threading.Thread):
+    def __init__(self, conn):
+        super().__init__(daemon=True)
+        self.conn = conn
+        self.file = conn.makefile('rb')
+        self.listener = None
+        self.prot = False
+        self.rest = 0
+
+    def send(self, line):
+        self.conn.sendall((line + '\r\n').encode())
+
+    def local(self, path):
+        return os.path.join(ROOT, os.path.normpath('/' + path).lstrip('/'))
+
+    def data(self):
+        conn, _ = self.listener.accept()
+        self.listener.close()
+        self.listener = None
+        if self.prot:
+            conn = CTX.wrap_socket(conn, server_side=True)
+            report('DATA reused=%d' % conn.session_reused)
+        return conn
+
+    def run(self):
+        self.send('220 ftps stand-in ready')
+        while True:
+            line = self.file.readline()
+            if not line:
+                break
+            cmd, _, arg = line.decode().rstrip('\r\n').partition(' ')
+            try:
+                if not self.command(cmd.upper(), arg):
+                    break
+            except OSError as e:
+                self.send('550 ' + str(e))
+        self.conn.close()
+
+    def command(self, cmd, arg):
+        if cmd == 'AUTH':
+            self.send('234 AUTH TLS ok')
+            try:
+                self.conn = CTX.wrap_socket(self.conn, server_side=True)
+            except ssl.SSLError as e:
+                # 인증서 검증 실패 등으로 클라이언트가 핸드셰이크를 중단한 경우
+                report('AUTH failed: ' + e.reason)
+                return False
+            self.file = self.conn.makefile('rb')
+        elif cmd == 'USER':
+            self.send('331 password please')
+        elif cmd == 'PASS':
+            self.send('230 logged in')
+        elif cmd == 'PBSZ':
+            self.send('200 PBSZ=0')
+        elif cmd == 'PROT':
+            self.prot = arg == 'P'
+            self.send('200 PROT ' + arg)
+        elif cmd == 'TYPE':
+            self.send('200 TYPE ' + arg)
+        elif cmd == 'NOOP':
+            self.send('200 NOOP ok')
+        elif cmd == 'EPSV':
+            self.listener = socket.socket()
+            self.listener.bind(('127.0.0.1', 0))
+            self.listener.listen(1)
+            self.send('229 Entering Extended Passive Mode (|||%d|)' % self.listener.getsockname()[1])
+        elif cmd == 'SIZE':
+            self.send('213 %d' % os.path.getsize(self.local(arg)))
+        elif cmd == 'REST':
+            self.rest = int(arg)
+            self.send('350 restarting at %d' % self.rest)
+        elif cmd == 'RETR':
+            with open(self.local(arg), 'rb') as f:
+                f.seek(self.rest)
+                self.rest = 0
+                self.send('150 sending')
+                conn = self.data()
+                while True:
+                    block = f.read(65536)
+                    if not block:
+                        break
+                    conn.sendall(block)
+                conn.close()
+            self.send('226 transfer complete')
+        elif cmd == 'STOR':
+            with open(self.local(arg), 'wb') as f:
+                self.send('150 receiving')
+                conn = self.data()
+                while True:
+                    block = conn.recv(65536)
+                    if not block:
+                        break
+                    f.write(block)
+                conn.close()
+            self.send('226 transfer complete')
+        elif cmd == 'QUIT':
+            self.send('221 bye')
+            return False
+        else:
+            self.send('502 not implemented')
+        return True
+
+
+listener = socket.socket()
+listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+listener.bind(('127.0.0.1', 0))
+listener.listen(8)
+report('PORT %d' % listener.getsockname()[1])
+while True:
+    conn, _ = listener.accept()
+    Session(conn).start()
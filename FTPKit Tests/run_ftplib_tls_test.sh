@@ -0,0 +1,25 @@
+#!/bin/sh
+#
+# ftplib FTPS 전송 테스트 실행
+#
+# ftplib 를 FTPLIB_USE_OPENSSL 로 빌드하고, ftps_standin.py 를 띄운 뒤 ftplib_tls_test 를 실행한다.
+# python3, openssl, OpenSSL 개발 헤더가 필요하다.
+#
+set -e
+TESTS=$(cd "$(dirname "$0")" && pwd)
+SRC="$TESTS/../Libraries/include/ftplib/src"
+WORK=$(mktemp -d)
+trap 'kill $SERVER 2>/dev/null; rm -rf "$WORK"' EXIT
+
+${CC:-cc} -Wall -DFTPLIB_USE_OPENSSL -I"$SRC" -o "$WORK/ftplib_tls_test" \
+    "$TESTS/ftplib_tls_test.c" "$SRC/ftplib.c" -lssl -lcrypto -lpthread
+
+mkdir "$WORK/root"
+python3 "$TESTS/ftps_standin.py" "$WORK/root" > "$WORK/server.log" &
+SERVER=$!
+while ! grep -q '^PORT ' "$WORK/server.log"; do
+    sleep 0.1
+done
+PORT=$(sed -n 's/^PORT //p' "$WORK/server.log")
+
+"$WORK/ftplib_tls_test" "$PORT" "$WORK/root"
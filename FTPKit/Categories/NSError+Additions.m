@@ -34,6 +34,9 @@ NSString *const FTPErrorDomain = @"FTPKit";
         case 23:
             message = NSLocalizedString(@"You set wrong offset or wrong file size.", @"");
             break;
+        case 24:
+            message = NSLocalizedString(@"Remote file was changed while resuming.", @"");
+            break;
         case 30:
             message = NSLocalizedString(@"Failed to upload file.", @"");
             break;
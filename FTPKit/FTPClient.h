@@ -4,14 +4,18 @@
  Consider implementing more of the commands specified at:
  http://en.wikipedia.org/wiki/List_of_FTP_commands
  
- Currently this creates a new connection to the FTP server for every command
- issued. This means the state of the current working directory is NOT kept and.
- therefore, some commands are not of use.
+ Logged-in connections are kept in a per-credentials FTPConnectionPool and
+ reused between commands. Each connection remembers its negotiated TYPE and
+ working directory, so redundant TYPE commands are skipped and file commands
+ are routed to a connection already positioned in the parent directory, using a
+ relative path there. All public methods still take absolute paths.
  
  */
 
 #import "ftplib.h"
 #import "FTPCredentials.h"
+#import "FTPConnectionPool.h"
+#import "FTPTransferScheduler.h"
 
 
 // MARK: - Global Variables -
@@ -38,6 +42,8 @@ typedef enum {
     FTP_FailedToSaveToLocal         = 22,
     // offset / length 를 잘못 지정
     FTP_FailedToReadByWrongSize     = 23,
+    // 이어받는 도중 서버 파일이 바뀜
+    FTP_RemoteFileChanged           = 24,
 
     // 파일 업로드에 실패
     FTP_FailedToUploadFile          = 30,
@@ -49,6 +55,16 @@ typedef enum {
     
 } FTPErrorCode;
 
+/// 스트리밍 다운로드에서 데이터 조각을 처리한 뒤의 동작
+typedef enum {
+    // 계속 받는다
+    FTPStreamContinue               = 0,
+    // 반환된 NSProgress 의 resume 이 호출될 때까지 읽기를 멈춘다
+    FTPStreamPause                  = 1,
+    // 전송을 중지한다. 완료 핸들러에는 FTP_Aborted 에러가 전달된다
+    FTPStreamStop                   = 2,
+} FTPStreamAction;
+
 // MARK: - FTPItem Class -
 /**
  FTPItem Class
@@ -66,6 +82,29 @@ typedef enum {
 @property (nonatomic) long int size;
 /// 수정일
 @property (atomic) NSDate * _Nullable modificationDate;
+/// 서버가 알려준 고유 식별자 (MLSD/MLST 의 unique). 지원하지 않는 서버는 nil
+@property (atomic) NSString * _Nullable uniqueIdentifier;
+@end
+
+
+// MARK: - FTPMirrorSummary Class -
+/**
+ 미러링 결과 요약
+ */
+@interface FTPMirrorSummary : NSObject
+
+/// 받은 파일 수
+@property (nonatomic) NSInteger filesTransferred;
+/// 받은 길이 (bytes)
+@property (nonatomic) long long int bytesTransferred;
+/// 바뀌지 않아서 건너뛴 파일 수
+@property (nonatomic) NSInteger filesSkipped;
+/// 건너뛴 파일의 길이 합 (bytes)
+@property (nonatomic) long long int bytesSkipped;
+/// 원격에 없어서 제거한 로컬 항목 수
+@property (nonatomic) NSInteger itemsDeleted;
+/// 받지 못한 파일과 목록을 가져오지 못한 디렉토리 수
+@property (nonatomic) NSInteger failedCount;
 @end
 
 
@@ -79,6 +118,9 @@ typedef enum {
 /** Credentials used to login to the server. */
 @property (nonatomic, readonly) FTPCredentials* _Nonnull credentials;
 
+/** 로그인된 접속을 재사용하는 접속 풀. 같은 접속 정보를 사용하는 FTPClient 간에 공유된다. */
+@property (nonatomic, readonly) FTPConnectionPool * _Nonnull connectionPool;
+
 /**
  The last encountered error. Please note that this value does not get nil'ed
  when a new operation takes place. Therefore, do not use 'lastError' as a way
@@ -87,6 +129,30 @@ typedef enum {
  */
 @property (nonatomic, readonly) NSError * _Nullable lastError;
 
+/**
+ 이 클라이언트의 전송마다 적용할 최대 전송률(bytes/초). 기본값은 0 으로, 제한하지 않는다.
+
+ 접속 풀과 전역 제한이 있는 경우 그 중 가장 작은 값이 적용된다.
+ */
+@property (atomic) long long int maximumBytesPerTransfer;
+
+/**
+ 접속 풀과 전역 전송률 제한을 다른 전송과 나눠 가질 때의 가중치. 기본값은 1.
+
+ 화면에 바로 필요한 전송은 크게, 백그라운드 미리 받기는 작게 지정하면 제한된 대역폭을 그 비율로 나눠 쓴다.
+ */
+@property (atomic) NSUInteger transferWeight;
+
+/**
+ 비동기 작업을 실행하는 스케줄러. 기본값은 공유 스케줄러.
+
+ 목록, 디렉토리 생성/삭제 등은 FTPPriorityInteractive 로, 파일 전송은 transferPriority 로 추가된다.
+ */
+@property (atomic, strong) FTPTransferScheduler * _Nonnull scheduler;
+
+/** 이후 시작하는 파일 전송의 우선순위. 기본값은 FTPPriorityDefault. */
+@property (atomic) FTPPriority transferPriority;
+
 /**
  Factory method to create FTPClient instance.
  
@@ -135,6 +201,16 @@ typedef enum {
                               username:(NSString * _Nonnull)username
                               password:(NSString * _Nonnull)password;
 
+/**
+ 대기 중인 전송의 우선순위 변경.
+
+ 화면에 보이는 항목의 전송을 먼저 받도록 할 때 사용한다. 이미 시작된 전송에는 영향이 없다.
+
+ @param priority 변경할 우선순위
+ @param progress 전송 메쏘드가 반환한 NSProgress
+ */
+- (void)setPriority:(FTPPriority)priority ofProgress:(NSProgress * _Nonnull)progress;
+
 /**
  Get the size, in bytes, for remote file at 'path'. This can not be used
  for directories.
@@ -152,7 +228,7 @@ typedef enum {
  @param remotePath 목록을 가져올 경로
  @param showHiddenFiles 감춤 파일 표시 여부
  @param completion 완료 핸들러로 읽어들인 FTPItem 배열 반환. 실패시 error 값이 반환.
- @return NSProgress 반환. 실패시 NULL 반환.
+ @return NSProgress 반환. 접속 실패 등은 완료 핸들러로 반환
  */
 - (NSProgress * _Nullable)listContentsAtPath:(NSString * _Nonnull)remotePath
                              showHiddenFiles:(BOOL)showHiddenFiles
@@ -167,7 +243,7 @@ typedef enum {
  @param remotePath Full path of remote file to download.
  @param savePath 다운로드 받은 파일을 저장할 경로.
  @param completion 완료 핸들러. 실패시 error 반환.
- @return NSProgress 반환. 실패시 NULL 반환
+ @return NSProgress 반환. 경로를 변환할 수 없는 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
  */
 - (NSProgress * _Nullable)downloadFile:(NSString * _Nonnull)remotePath
                             toSavePath:(NSString * _Nonnull)savePath
@@ -179,16 +255,72 @@ typedef enum {
  - 반환된 NSProgress를 이용해 작업 취소 가능
 
  @param remotePath Full path of remote file to download.
- @param offset 다운로드를 시작할 offset 위치. 처음부터 다운로드시 0 지정
- @param length 다운로드 받을 길이. 전체 다운로드시 0 지정
+ @param offset 다운로드를 시작할 offset 위치. 처음부터 다운로드시 0 지정. 파일 크기 이상이면 실패한다
+ @param length 다운로드 받을 길이. 파일 끝을 넘으면 파일 끝까지 받는다. 전체 다운로드시 0 지정
  @param completion 완료 핸들러. 성공시 data 반환. 실패시 error 반환.
- @return NSProgress 반환. 실패시 NULL 반환
+ @return NSProgress 반환. 경로를 변환할 수 없는 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
  */
 - (NSProgress * _Nullable)downloadFile:(NSString * _Nonnull)remotePath
                             toSavePath:(NSString * _Nonnull)savePath
                                 offset:(long long int)offset
                                 length:(long long int)length
                             completion:(void (^ _Nonnull)(NSError * _Nullable error))completion;
+/**
+ FTP 경로의 파일을 여러 접속으로 나눠서 동시에 다운로드.
+ 
+ - 파일을 구간으로 나눠 접속 풀의 여러 접속으로 동시에 받는다
+ - 전송률이 오르는 동안 maximumSegments 까지 접속을 늘린다
+ - 반환된 NSProgress는 전체 진행 상태이며, 이를 이용해 작업 취소 가능
+
+ @param remotePath Full path of remote file to download.
+ @param savePath 다운로드 받은 파일을 저장할 경로.
+ @param maximumSegments 최대 동시 접속 수. 1 이하이거나 파일이 작은 경우 하나의 접속으로 다운로드
+ @param completion 완료 핸들러. 실패시 error 반환.
+ @return NSProgress 반환. 실패시 NULL 반환
+ */
+- (NSProgress * _Nullable)downloadFile:(NSString * _Nonnull)remotePath
+                            toSavePath:(NSString * _Nonnull)savePath
+                       maximumSegments:(NSInteger)maximumSegments
+                            completion:(void (^ _Nonnull)(NSError * _Nullable error))completion;
+/**
+ FTP 경로의 파일을 재시작 후에도 이어받을 수 있도록 다운로드.
+ 
+ - 저장 파일 옆의 저널(<저장 경로>.ftpjournal)에 디스크에 기록된 구간을 남긴다
+ - 같은 저장 경로로 다시 호출하면, 원격 파일 크기와 수정일이 같은 경우 남은 구간만 이어받는다
+ - 실패하거나 취소된 경우 받은 파일과 저널을 유지하고, 완료시 저널을 삭제한다
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param remotePath Full path of remote file to download.
+ @param savePath 다운로드 받은 파일을 저장할 경로.
+ @param maximumSegments 최대 동시 접속 수
+ @param completion 완료 핸들러. 실패시 error 반환.
+ @return NSProgress 반환. 실패시 NULL 반환
+ */
+- (NSProgress * _Nullable)resumableDownloadFile:(NSString * _Nonnull)remotePath
+                                     toSavePath:(NSString * _Nonnull)savePath
+                                maximumSegments:(NSInteger)maximumSegments
+                                     completion:(void (^ _Nonnull)(NSError * _Nullable error))completion;
+/**
+ 전송 정체나 접속 끊김을 감시하면서 FTP 경로의 파일을 다운로드.
+ 
+ - stallTimeout 동안 받은 데이터가 없거나 접속이 끊긴 경우, 재접속 후 받은 위치부터 REST 로 이어받는다
+ - 이어받기 전 서버 파일 크기와 수정일을 확인해서, 바뀐 경우 FTP_RemoteFileChanged 에러로 중지한다
+ - 재시도는 대기 시간을 늘려가며 maximumRetries 번까지 한다
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param remotePath Full path of remote file to download.
+ @param savePath 다운로드 받은 파일을 저장할 경로.
+ @param stallTimeout 정체로 판단하는 시간(초)
+ @param maximumRetries 최대 재시도 횟수
+ @param completion 완료 핸들러. 실제 재시도 횟수 반환. 실패시 error 반환.
+ @return NSProgress 반환. 실패시 NULL 반환
+ */
+- (NSProgress * _Nullable)supervisedDownloadFile:(NSString * _Nonnull)remotePath
+                                      toSavePath:(NSString * _Nonnull)savePath
+                                    stallTimeout:(NSTimeInterval)stallTimeout
+                                  maximumRetries:(NSInteger)maximumRetries
+                                      completion:(void (^ _Nonnull)(NSInteger retries,
+                                                                    NSError * _Nullable error))completion;
 /**
  FTP 경로에서 데이터 다운로드.
  
@@ -197,7 +329,7 @@ typedef enum {
 
  @param remotePath Full path of remote file to download.
  @param completion 완료 핸들러. 성공시 data 반환. 실패시 error 반환.
- @return NSProgress 반환. 실패시 NULL 반환
+ @return NSProgress 반환. 경로를 변환할 수 없는 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
  */
 - (NSProgress * _Nullable)downloadFile:(NSString * _Nonnull)remotePath
                             completion:(void (^ _Nonnull)(NSData * _Nullable data,
@@ -208,16 +340,111 @@ typedef enum {
  - 반환된 NSProgress를 이용해 작업 취소 가능
 
  @param remotePath Full path of remote file to download.
- @param offset 다운로드를 시작할 offset 위치. 처음부터 다운로드시 0 지정
- @param length 다운로드 받을 길이. 전체 다운로드시 0 지정
+ @param offset 다운로드를 시작할 offset 위치. 처음부터 다운로드시 0 지정. 파일 크기 이상이면 실패한다
+ @param length 다운로드 받을 길이. 파일 끝을 넘으면 파일 끝까지 받는다. 전체 다운로드시 0 지정
  @param completion 완료 핸들러. 성공시 data 반환. 실패시 error 반환.
- @return NSProgress 반환. 실패시 NULL 반환
+ @return NSProgress 반환. 경로를 변환할 수 없는 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
  */
 - (NSProgress * _Nullable)downloadFile:(NSString * _Nonnull)remotePath
                                 offset:(long long int)offset
                                 length:(long long int)length
                             completion:(void (^ _Nonnull)(NSData * _Nullable data,
                                                           NSError * _Nullable error))completion;
+/**
+ FTP 경로의 파일을 받는 대로 조각 단위로 전달.
+ 
+ - 파일 전체를 메모리에 모으지 않으므로, 파일 크기와 관계없이 사용하는 메모리가 일정하다
+ - chunkHandler 가 FTPStreamPause 를 반환하면, 반환된 NSProgress 의 resume 이 호출될 때까지 읽지 않는다.
+   그동안 서버는 TCP 수신 창이 차면 전송을 멈춘다. NSProgress 의 pause 로도 멈출 수 있다
+ - chunkHandler 와 completion 은 백그라운드 큐에서 순서대로 호출된다
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param remotePath Full path of remote file to download.
+ @param offset 다운로드를 시작할 offset 위치. 처음부터 다운로드시 0 지정
+ @param chunkHandler 데이터 조각 핸들러. 받은 데이터와 파일에서의 위치를 전달받고, 다음 동작을 반환한다.
+ @param completion 완료 핸들러. 실패 또는 중지시 error 반환.
+ @return NSProgress 반환. 실패시 NULL 반환
+ */
+- (NSProgress * _Nullable)streamFile:(NSString * _Nonnull)remotePath
+                              offset:(long long int)offset
+                        chunkHandler:(FTPStreamAction (^ _Nonnull)(NSData * _Nonnull chunk,
+                                                                   long long int chunkOffset))chunkHandler
+                          completion:(void (^ _Nonnull)(NSError * _Nullable error))completion;
+/**
+ 여러 파일을 정해진 수의 접속으로 나눠서 다운로드.
+ 
+ - 파일 목록을 작업자(접속)마다 나눠 두고, 자기 몫을 먼저 끝낸 작업자는 다른 작업자의 남은 파일을 가져와서 받는다.
+   큰 파일이나 느린 파일이 한 작업자에 몰려도 다른 접속이 쉬지 않는다
+ - 각 작업자는 접속 하나로 여러 파일을 이어서 받고, 다음 파일의 데이터 접속을 미리 열어 둔다
+ - 파일 하나가 실패해도 나머지 파일은 계속 받는다. 실패한 파일의 저장 파일은 제거된다
+ - 반환된 NSProgress 는 처리한 파일 수를 나타내며, 이를 이용해 작업 취소 가능
+
+ @param files 원격 경로를 키로, 저장할 경로를 값으로 하는 사전
+ @param sessions 동시에 사용할 최대 접속 수
+ @param itemCompletion 파일마다 호출되는 완료 핸들러. 실패시 error 반환. 여러 작업자에서 동시에 호출될 수 있다
+ @param completion 모든 파일을 처리한 뒤 호출되는 완료 핸들러. 실패한 파일 수 반환. 취소시 FTP_Aborted 에러 반환
+ @return NSProgress 반환
+ */
+- (NSProgress * _Nonnull)downloadFiles:(NSDictionary<NSString *, NSString *> * _Nonnull)files
+                              sessions:(NSInteger)sessions
+                        itemCompletion:(void (^ _Nullable)(NSString * _Nonnull remotePath,
+                                                           NSError * _Nullable error))itemCompletion
+                            completion:(void (^ _Nonnull)(NSInteger failedCount,
+                                                          NSError * _Nullable error))completion;
+/**
+ FTP 디렉토리 아래 전체를 여러 접속으로 동시에 탐색.
+ 
+ - 접속마다 작업자가 하나씩 디렉토리 목록을 가져오며, 각 디렉토리의 목록을 받는 대로 entryHandler 로 전달한다
+ - 하위 디렉토리는 깊이 우선으로 탐색하고, 공유 대기 목록의 크기를 제한해서 넓은 트리에서도 대기 목록이 크게 늘지 않는다
+ - 목록을 가져오지 못한 디렉토리는 error 와 함께 전달되며, 나머지 디렉토리는 계속 탐색한다
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param remotePath 탐색을 시작할 FTP 디렉토리 경로
+ @param sessions 동시에 사용할 최대 접속 수
+ @param maximumDepth 최대 탐색 깊이. 0 이면 시작 디렉토리만 가져온다. 0 보다 작으면 제한하지 않는다
+ @param showHiddenFiles 감춤 파일 포함 여부
+ @param filter 항목 선택 조건. 상위 디렉토리 경로, 항목, 항목의 깊이(시작 디렉토리의 항목이 1)를 전달받는다.
+        NO 를 반환한 항목은 전달하지 않고, 디렉토리인 경우 들어가지도 않는다. nil 이면 모든 항목을 선택한다
+ @param entryHandler 디렉토리 목록 핸들러. 디렉토리 경로와 선택된 항목을 전달받는다. 실패시 items 는 nil 이고 error 가 전달된다.
+        여러 작업자에서 동시에 호출될 수 있다
+ @param completion 완료 핸들러. 시작 디렉토리 목록을 가져오지 못했거나 취소된 경우 error 반환
+ @return NSProgress 반환
+ */
+- (NSProgress * _Nonnull)walkDirectoryAtPath:(NSString * _Nonnull)remotePath
+                                    sessions:(NSInteger)sessions
+                                maximumDepth:(NSInteger)maximumDepth
+                             showHiddenFiles:(BOOL)showHiddenFiles
+                                      filter:(BOOL (^ _Nullable)(NSString * _Nonnull parentPath,
+                                                                 FTPItem * _Nonnull item,
+                                                                 NSInteger depth))filter
+                                entryHandler:(void (^ _Nonnull)(NSString * _Nonnull path,
+                                                                NSArray<FTPItem *> * _Nullable items,
+                                                                NSError * _Nullable error))entryHandler
+                                  completion:(void (^ _Nonnull)(NSError * _Nullable error))completion;
+/**
+ FTP 디렉토리 아래 전체를 로컬 디렉토리로 미러링.
+ 
+ - 여러 접속으로 원격 디렉토리 목록을 동시에 가져오며 하위 디렉토리까지 모두 탐색한다
+ - 크기와 수정일이 같은 로컬 파일은 건너뛰고, 새로 생기거나 바뀐 파일만 downloadFiles:sessions:itemCompletion:completion: 으로 받는다
+ - 받은 파일은 같은 디렉토리의 임시 파일에 저장한 뒤 rename 으로 바꿔 넣고, 수정일을 원격 파일에 맞춘다.
+   중간에 실패하거나 취소되어도 기존 파일은 그대로 남는다
+ - deletesExtraneousFiles 가 YES 인 경우, 원격에 없는 로컬 파일/디렉토리를 제거한다.
+   목록을 가져오지 못한 디렉토리는 제거하지 않는다
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param remotePath 미러링할 FTP 디렉토리 경로
+ @param localPath 저장할 로컬 디렉토리 경로. 없는 경우 생성한다
+ @param sessions 동시에 사용할 최대 접속 수
+ @param deletesExtraneousFiles 원격에 없는 로컬 항목 제거 여부
+ @param completion 완료 핸들러. 처리 결과 요약 반환. 시작 디렉토리 목록을 가져오지 못했거나 취소된 경우 error 반환
+ @return NSProgress 반환
+ */
+- (NSProgress * _Nonnull)mirrorDirectory:(NSString * _Nonnull)remotePath
+                        toLocalDirectory:(NSString * _Nonnull)localPath
+                                sessions:(NSInteger)sessions
+                  deletesExtraneousFiles:(BOOL)deletesExtraneousFiles
+                              completion:(void (^ _Nonnull)(FTPMirrorSummary * _Nonnull summary,
+                                                            NSError * _Nullable error))completion;
 
 /**
  로컬 파일을 지정된 FTP 디렉토리로 업로드.
@@ -227,7 +454,7 @@ typedef enum {
  @param localPath 업로드할 로컬 파일 경로.
  @param remoteDirectory 업로드할 FTP 디렉토리 경로.
  @param completion 완료 핸들러. 실패시 error 반환.
- @return NSProgress 반환. 실패시 NULL 반환
+ @return NSProgress 반환. 로컬 파일이 없거나 크기가 0 인 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
  */
 - (NSProgress * _Nullable)uploadFileFrom:(NSString * _Nonnull)localPath
                              toDirectory:(NSString * _Nonnull)remoteDirectory
@@ -240,11 +467,46 @@ typedef enum {
  @param localPath 업로드할 로컬 파일 경로.
  @param remotePath 업로드할 FTP 경로. 정확한 디렉토리 + 파일명까지 기재한다
  @param completion 완료 핸들러. 실패시 error 반환.
- @return NSProgress 반환. 실패시 NULL 반환
+ @return NSProgress 반환. 로컬 파일이 없거나 크기가 0 인 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
  */
 - (NSProgress * _Nullable)uploadFileFrom:(NSString * _Nonnull)localPath
                                       to:(NSString * _Nonnull)remotePath
                               completion:(void (^ _Nonnull)(NSError * _Nullable error))completion;
+/**
+ 로컬 파일을 지정된 FTP 경로로 이어서 업로드.
+ 
+ - 서버에 있는 파일 크기부터 REST + STOR (지원하지 않는 서버는 APPE) 로 이어 올린다
+ - 서버에 파일이 없거나 서버 파일이 더 큰 경우는 처음부터 올린다
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param localPath 업로드할 로컬 파일 경로.
+ @param remotePath 업로드할 FTP 경로. 정확한 디렉토리 + 파일명까지 기재한다
+ @param completion 완료 핸들러. 이번 업로드에서 실제로 보낸 길이 반환. 실패시 error 반환.
+ @return NSProgress 반환. 로컬 파일이 없거나 크기가 0 인 경우 NULL 반환. 이미 모두 올라가 있는 경우와 접속 및 전송 실패는 완료 핸들러로 반환
+ */
+- (NSProgress * _Nullable)resumeUploadFileFrom:(NSString * _Nonnull)localPath
+                                            to:(NSString * _Nonnull)remotePath
+                                    completion:(void (^ _Nonnull)(long long int sentLength,
+                                                                  NSError * _Nullable error))completion;
+/**
+ 계속 늘어나기만 하는 로컬 파일(로그, 저널 등)의 늘어난 부분만 서버 파일 뒤에 덧붙여 업로드.
+ 
+ - 서버 파일 크기 이후 부분만 APPE 로 보낸다
+ - overlapLength 가 지정된 경우 서버 파일 끝 부분을 로컬 파일과 비교해서, 다르면 처음부터 올린다
+ - 서버 파일이 더 크거나 없는 경우도 처음부터 올린다
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param localPath 업로드할 로컬 파일 경로.
+ @param remotePath 업로드할 FTP 경로. 정확한 디렉토리 + 파일명까지 기재한다
+ @param overlapLength 비교할 서버 파일 끝 부분 길이. 비교하지 않는 경우 0 지정
+ @param completion 완료 핸들러. 이번 업로드에서 실제로 보낸 길이 반환. 실패시 error 반환.
+ @return NSProgress 반환. 로컬 파일이 없는 경우 NULL 반환. 보낼 부분이 없는 경우와 접속 및 전송 실패는 완료 핸들러로 반환
+ */
+- (NSProgress * _Nullable)syncAppendFileFrom:(NSString * _Nonnull)localPath
+                                          to:(NSString * _Nonnull)remotePath
+                               overlapLength:(long long int)overlapLength
+                                  completion:(void (^ _Nonnull)(long long int sentLength,
+                                                                NSError * _Nullable error))completion;
 
 /**
  서버의 remotePath 위치에 디렉토리 생성.
@@ -368,6 +630,30 @@ typedef enum {
 - (void)lastModifiedAtPath:(NSString * _Nonnull)remotePath
                 completion:(void (^ _Nonnull)(NSDate * _Nullable modifiedDate, NSError * _Nullable error))completion;
 
+/**
+ 경로 하나의 정보를 가져오는 메쏘드
+ 
+ - 서버가 MLST 를 지원하면 파일/디렉토리 모두 정확한 크기, 수정일(UTC), 고유 식별자를 가져온다
+ - 지원하지 않는 서버는 SIZE/MDTM 으로 대체하므로 파일에만 사용할 수 있다
+ 
+ @param remotePath 정보를 가져올 경로
+ @param error 에러 발생시 에러값을 반환하는 이중 포인터
+ @return 성공시 FTPItem 반환. filename 은 경로의 마지막 요소. 실패시 nil 반환
+ */
+- (FTPItem * _Nullable)itemAtPath:(NSString * _Nonnull)remotePath
+                            error:(NSError *_Nullable * _Nullable)error;
+
+/**
+ Refer to itemAtPath:error:
+ 
+ This adds the ability to perform the operation asynchronously.
+ 
+ @param remotePath 정보를 가져올 경로
+ @param completion 성공시 FTPItem 반환, 실패시 에러값 반환.
+ */
+- (void)itemAtPath:(NSString * _Nonnull)remotePath
+        completion:(void (^ _Nonnull)(FTPItem * _Nullable item, NSError * _Nullable error))completion;
+
 /**
  Check if a remote directory exists.
  
@@ -395,12 +681,10 @@ typedef enum {
 /**
  Change the working directory to remotePath.
  
- @note This is currently used ONLY to determine if a directory exists on the
- server. The state of the cwd is not saved between commands being issued. This
- is because a new connection is created for every command issued.
- 
- Therefore, in its current state, it is used in a very limited scope. Eventually
- you will be able to issue commands in the cwd. Not right now.
+ @note The connection used for this command is returned to the connection
+ pool positioned in remotePath. Later file commands in remotePath prefer that
+ connection and send relative paths, but there is no client-wide cwd: paths
+ given to other methods must still be absolute.
  
  @param remotePath Remote directory path to make current directory.
  @return 성공시 NULL 반환. 실패시 에러 반환
@@ -410,10 +694,9 @@ typedef enum {
 /**
  Returns the current working directory.
  
- @note Currently this will always return the root path. This is because the
- lib creates a new connection for every command issued to the server -- and
- therefore the command will always being in the root path when issuing the
- command.
+ @note Returns the working directory of whichever pooled connection serves the
+ command. This is the login directory unless changeDirectoryToPath: has
+ positioned that connection elsewhere.
  
  @param error 에러 발생시 에러값을 반환하는 이중 포인터
  @return The current working directory.
@@ -1,6 +1,8 @@
+#import <fcntl.h>
 #import "ftpparse.h"
 #import "FTPKit+Protected.h"
 #import "FTPClient.h"
+#import "FTPDownloadJournal.h"
 #import "NSError+Additions.h"
 #import "NSString+Additions.h"
 
@@ -43,6 +45,301 @@
 @end
 
 
+// MARK: - FTPMirrorSummary Class -
+@implementation FTPMirrorSummary
+@end
+
+
+// MARK: - FTPSegment Class -
+/**
+ 분할 다운로드의 한 구간. [position, end) 가 아직 받지 않은 범위
+ */
+@interface FTPSegment : NSObject
+/// 구간 시작 위치
+@property (nonatomic) long long int start;
+/// 다음에 저장할 위치
+@property (nonatomic) long long int position;
+/// 파일에 쓰기를 마친 위치. [start, written) 은 파일에 기록되어 있다
+@property (nonatomic) long long int written;
+/// 구간 끝 (포함하지 않음). 다른 작업자가 뒷부분을 나눠 가져가면 줄어든다
+@property (nonatomic) long long int end;
+/// 작업자가 받고 있는 구간인지 여부
+@property (nonatomic) BOOL active;
+@end
+
+@implementation FTPSegment
+@end
+
+
+// MARK: - FTPSegmentedDownload Class -
+/**
+ 분할 다운로드 공유 상태. 모든 프로퍼티는 @synchronized(self) 안에서 접근한다
+ */
+@interface FTPSegmentedDownload : NSObject
+/// 서버 인코딩으로 변환된 원격 경로
+@property (nonatomic) char *path;
+/// 저장 파일 디스크립터
+@property (nonatomic) int fd;
+/// 전체 파일 크기
+@property (nonatomic) long long int fileSize;
+/// 최대 작업자(접속) 수
+@property (nonatomic) NSInteger maximumSegments;
+/// 현재 작업자 수
+@property (nonatomic) NSInteger workers;
+/// 남은 재접속 횟수
+@property (nonatomic) NSInteger retries;
+/// 작업자를 더 추가할지 여부. 접속을 늘려도 전송률이 오르지 않으면 NO
+@property (nonatomic) BOOL growing;
+/// 마지막 전송률 측정 시각
+@property (nonatomic) NSTimeInterval sampleTime;
+/// 마지막 측정시 완료된 길이
+@property (nonatomic) long long int sampleBytes;
+/// 마지막 측정 전송률 (bytes/sec)
+@property (nonatomic) double sampleRate;
+/// 마지막 측정시 작업자 수
+@property (nonatomic) NSInteger sampleWorkers;
+/// 구간 목록
+@property (nonatomic, strong) NSMutableArray<FTPSegment *> *segments;
+/// 전체 진행 상태
+@property (nonatomic, strong) NSProgress *progress;
+/// 작업자 완료 대기 그룹
+@property (nonatomic, strong) dispatch_group_t group;
+/// 처음 발생한 에러
+@property (nonatomic, strong) NSError *error;
+/// 이어받기 저널. 사용하지 않는 경우 nil
+@property (nonatomic, strong) FTPDownloadJournal *journal;
+/// 마지막 저널 기록시 완료된 길이
+@property (nonatomic) long long int journalBytes;
+/// 저널 기록 중인지 여부
+@property (nonatomic) BOOL journaling;
+@end
+
+@implementation FTPSegmentedDownload
+
+- (void)dealloc {
+    if (_path != NULL) {
+        free(_path);
+    }
+}
+
+/**
+ 작업자에게 할당할 구간 반환
+ 
+ - 받는 작업자가 없는 구간을 우선 반환
+ - 없는 경우 남은 길이가 가장 긴 구간의 뒷부분을 나눠서 반환
+ 
+ @return 남은 구간이 없거나 너무 짧아 나눌 수 없는 경우 nil
+ */
+- (FTPSegment * _Nullable)nextSegment {
+    FTPSegment *largest = nil;
+    for (FTPSegment *segment in self.segments) {
+        if (segment.position >= segment.end) {
+            continue;
+        }
+        if (segment.active == NO) {
+            segment.active = YES;
+            return segment;
+        }
+        if (largest == nil ||
+            segment.end - segment.position > largest.end - largest.position) {
+            largest = segment;
+        }
+    }
+    if (largest == nil ||
+        largest.end - largest.position < kFTPKitMinimumSegmentSize * 2) {
+        return nil;
+    }
+    FTPSegment *segment = [[FTPSegment alloc] init];
+    segment.start = largest.position + (largest.end - largest.position) / 2;
+    segment.position = segment.start;
+    segment.written = segment.start;
+    segment.end = largest.end;
+    segment.active = YES;
+    largest.end = segment.position;
+    [self.segments addObject:segment];
+    return segment;
+}
+
+/**
+ 받을 구간 추가. 작업자는 할당하지 않는다
+ 
+ @param start 구간 시작 위치
+ @param end 구간 끝 (포함하지 않음)
+ */
+- (void)addSegmentFrom:(long long int)start to:(long long int)end {
+    if (start >= end) {
+        return;
+    }
+    FTPSegment *segment = [[FTPSegment alloc] init];
+    segment.start = start;
+    segment.position = start;
+    segment.written = start;
+    segment.end = end;
+    [self.segments addObject:segment];
+}
+
+/// 이번 다운로드에서 파일에 쓴 구간 목록. [시작, 끝) 쌍의 배열
+- (NSArray<NSArray<NSNumber *> *> * _Nonnull)writtenRanges {
+    NSMutableArray<NSArray<NSNumber *> *> *ranges = [[NSMutableArray alloc] init];
+    for (FTPSegment *segment in self.segments) {
+        if (segment.written > segment.start) {
+            [ranges addObject:@[@(segment.start), @(segment.written)]];
+        }
+    }
+    return ranges;
+}
+
+/// 아직 받지 않은 전체 길이
+- (long long int)remainingLength {
+    long long int remaining = 0;
+    for (FTPSegment *segment in self.segments) {
+        remaining += segment.end - segment.position;
+    }
+    return remaining;
+}
+
+/**
+ 전송률을 측정해서 작업자를 추가할지 판단
+ 
+ 작업자를 늘린 직후의 전송률이 늘기 전 접속 하나 몫의 절반도 오르지 않은 경우,
+ 회선 대역폭이 포화된 것으로 보고 더 이상 작업자를 추가하지 않는다.
+ 
+ @return 작업자를 추가해야 하는 경우 true
+ */
+- (BOOL)shouldAddWorker {
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    if (now - self.sampleTime < kFTPKitSegmentSampleInterval) {
+        return false;
+    }
+    long long int completed = self.progress.completedUnitCount;
+    double rate = (double)(completed - self.sampleBytes) / (now - self.sampleTime);
+    if (self.growing &&
+        self.sampleWorkers > 0 &&
+        self.workers > self.sampleWorkers &&
+        rate - self.sampleRate < self.sampleRate / self.sampleWorkers / 2) {
+        FKLogDebug(@"Segmented download saturated at %ld connections", (long)self.sampleWorkers);
+        self.growing = false;
+    }
+    self.sampleTime = now;
+    self.sampleBytes = completed;
+    self.sampleRate = rate;
+    self.sampleWorkers = self.workers;
+    return self.growing && self.workers < self.maximumSegments;
+}
+
+@end
+
+
+// MARK: - FTPBatchDownload Class -
+/**
+ 일괄 다운로드 공유 상태
+ */
+@interface FTPBatchDownload : NSObject
+/// 작업자별 대기 파일 목록. 항목은 [원격 경로, 저장 경로]. 각 목록은 @synchronized(목록) 안에서 접근한다
+@property (nonatomic, strong) NSArray<NSMutableArray<NSArray<NSString *> *> *> *queues;
+/// 처리한 파일 수를 나타내는 진행 상태
+@property (nonatomic, strong) NSProgress *progress;
+/// 작업자 완료 대기 그룹
+@property (nonatomic, strong) dispatch_group_t group;
+/// 실패한 파일 수. @synchronized(self) 안에서 접근한다
+@property (nonatomic) NSInteger failedCount;
+@end
+
+@implementation FTPBatchDownload
+
+/**
+ 작업자가 받을 다음 파일 반환
+ 
+ - 자기 목록의 마지막 파일을 먼저 꺼낸다
+ - 자기 목록이 비었으면 다른 작업자 목록의 앞쪽 절반을 가져온다. 가져온 파일은 다른 작업자가 다시 가져갈 수 있다
+ 
+ @param worker 작업자 번호
+ @return 남은 파일이 없는 경우 nil
+ */
+- (NSArray<NSString *> * _Nullable)nextItemForWorker:(NSUInteger)worker {
+    NSMutableArray<NSArray<NSString *> *> *queue = self.queues[worker];
+    @synchronized (queue) {
+        NSArray<NSString *> *item = [queue lastObject];
+        if (item != nil) {
+            [queue removeLastObject];
+            return item;
+        }
+    }
+    NSUInteger count = [self.queues count];
+    for (NSUInteger i = 1; i < count; i++) {
+        NSMutableArray<NSArray<NSString *> *> *victim = self.queues[(worker + i) % count];
+        NSArray<NSArray<NSString *> *> *stolen = nil;
+        // 두 목록을 동시에 잠그지 않도록 꺼낸 뒤에 옮긴다
+        @synchronized (victim) {
+            NSUInteger half = ([victim count] + 1) / 2;
+            if (half == 0) {
+                continue;
+            }
+            stolen = [victim subarrayWithRange:NSMakeRange(0, half)];
+            [victim removeObjectsInRange:NSMakeRange(0, half)];
+        }
+        NSArray<NSString *> *item = [stolen lastObject];
+        if ([stolen count] > 1) {
+            @synchronized (queue) {
+                [queue addObjectsFromArray:[stolen subarrayWithRange:NSMakeRange(0, [stolen count] - 1)]];
+            }
+        }
+        return item;
+    }
+    return nil;
+}
+
+@end
+
+
+// MARK: - FTPTreeWalk Class -
+/**
+ 병렬 디렉토리 탐색 공유 상태. frontier 와 busy 는 condition 을 잠근 상태에서 접근한다
+ */
+@interface FTPTreeWalk : NSObject
+/// 목록을 가져올 디렉토리. 항목은 [경로, 깊이]. 마지막 항목부터 꺼내서 깊이 우선으로 탐색한다
+@property (nonatomic, strong) NSMutableArray<NSArray *> *frontier;
+/// 목록을 가져오는 중이거나 직접 탐색할 디렉토리가 남은 작업자 수
+@property (nonatomic) NSInteger busy;
+/// 대기 목록이 바뀌었음을 작업자에게 알리는 조건
+@property (nonatomic, strong) NSCondition *condition;
+/// 최대 탐색 깊이. 시작 디렉토리가 0
+@property (nonatomic) NSInteger maximumDepth;
+/// 감춤 파일 포함 여부
+@property (nonatomic) BOOL showHiddenFiles;
+/// 목록을 가져온 디렉토리 수를 나타내는 진행 상태
+@property (nonatomic, strong) NSProgress *progress;
+/// 작업자 완료 대기 그룹
+@property (nonatomic, strong) dispatch_group_t group;
+/// 디렉토리 목록을 가져올 때마다 호출. 들어가서 탐색할 하위 디렉토리를 반환한다
+@property (nonatomic, copy) NSArray<FTPItem *> *(^directoryHandler)(NSString *path, NSInteger depth, NSArray<FTPItem *> *items, NSError *error);
+@end
+
+@implementation FTPTreeWalk
+@end
+
+
+// MARK: - FTPMirror Class -
+/**
+ 미러링 공유 상태. 모든 프로퍼티는 @synchronized(self) 안에서 접근한다
+ */
+@interface FTPMirror : NSObject
+/// 결과 요약
+@property (nonatomic, strong) FTPMirrorSummary *summary;
+/// 받을 파일. 원격 경로 → 임시 저장 경로
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSString *> *downloads;
+/// 받을 파일의 저장 경로와 원격 수정일. 원격 경로 → [저장 경로, 수정일(없으면 NSNull)]
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSArray *> *targets;
+/// 목록을 가져온 로컬 디렉토리별 원격 항목 이름. 원격에 없는 항목 제거에 사용한다
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSSet<NSString *> *> *listedDirectories;
+/// 시작 디렉토리 목록 에러
+@property (nonatomic, strong) NSError *error;
+@end
+
+@implementation FTPMirror
+@end
+
+
 // MARK: - FTPClient Class -
 /**
  FTPClient Class
@@ -51,19 +348,45 @@
 
 @property (nonatomic, strong) FTPCredentials* credentials;
 
-/** Queue used to enforce requests to process in synchronous order. */
-@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) FTPConnectionPool *connectionPool;
 
 /** NSString Encoding */
 @property (nonatomic) int encoding;
 
 /**
- Create connection to FTP server.
+ 접속 풀에서 로그인된 접속을 대여.
+ 
+ @param error 에러 발생시, 에러값을 반환하는 이중 포인터
+ @return netbuf The connection to the FTP server on success. NULL otherwise.
+ */
+- (netbuf * _Nullable)checkoutConnection:(NSError *_Nullable * _Nullable)error;
+
+/**
+ 대여한 접속을 접속 풀에 반납.
+ 
+ @param conn 반납할 접속
+ @param reusable 응답 순서가 어긋나지 않은 상태로 재사용 가능한 경우 true. false 인 경우 접속 종료
+ */
+- (void)checkinConnection:(netbuf * _Nonnull)conn reusable:(BOOL)reusable;
+
+/**
+ 경로의 상위 디렉토리에 위치한 접속을 우선해서 대여.
  
+ @param path 서버 인코딩으로 변환된 절대 경로
  @param error 에러 발생시, 에러값을 반환하는 이중 포인터
  @return netbuf The connection to the FTP server on success. NULL otherwise.
  */
-- (netbuf * _Nullable)connect:(NSError *_Nullable * _Nullable)error;
+- (netbuf * _Nullable)checkoutConnectionForPath:(const char * _Nullable)path
+                                          error:(NSError *_Nullable * _Nullable)error;
+
+/**
+ 접속의 작업 디렉토리 기준 상대 경로 반환.
+ 
+ @param path 서버 인코딩으로 변환된 절대 경로
+ @param conn 사용할 접속
+ @return 작업 디렉토리가 상위 디렉토리와 같은 경우 파일명, 아닌 경우 path 그대로 반환
+ */
+- (const char * _Nullable)path:(const char * _Nullable)path relativeToConnection:(netbuf * _Nonnull)conn;
 
 /**
  서버에 FTP 명령어 전송.
@@ -106,7 +429,10 @@
     self = [super init];
 	if (self) {
 		self.credentials = aLocation;
-        self.queue = dispatch_queue_create("com.upstart-illustration-llc.FTPKitQueue", DISPATCH_QUEUE_SERIAL);
+        self.connectionPool = [FTPConnectionPool poolForCredentials:aLocation encoding:_encoding];
+        self.scheduler = [FTPTransferScheduler sharedScheduler];
+        self.transferPriority = FTPPriorityDefault;
+        self.transferWeight = 1;
 	}
 	return self;
 }
@@ -123,26 +449,38 @@
 
 // MARK: - Internal Transfer Method
 /**
- * 커맨드를 전송, 데이터를 포인터로 반환하는 메쏘드
+ * 커맨드를 전송, 로컬 파일을 업로드하는 메쏘드
  *
  * 파일 업로드 전용 메쏘드이며, 읽기 용도로 사용해선 안 된다
+ * 스케줄러 작업 안에서 호출하며, 전송이 끝날 때까지 반환하지 않는다
  *
  * @param fromPath 업로드할 로컬 파일 경로
  * @param fileSize 업로드할 파일 크기
+ * @param offset 업로드를 시작할 로컬 파일 위치. 처음부터 업로드시 0 지정
  * @param remotePath FTP 파일 경로
- * @param savePath 다운로드 받은 파일을 저장할 경로
  * @param nControl netbuf
- * @param type 전송 타입
+ * @param type 전송 타입. FTPLIB_FILE_WRITE / FTPLIB_FILE_WRITE_OFFSET / FTPLIB_FILE_APPEND 중에서 선택.
  * @param mode 전송 모드. 바이너리/아스키/이미지 중에서 선택.
- * @param completion 완료 핸들러. 실패시에는 NSError 값 반환.
- * @return NSProgress 반환. 해당 NSProgress를 이용, 중지 처리 가능. 접속 불가시 nil 반환
+ * @param progress 진행 상태를 반영할 NSProgress. 취소되면 전송을 중지한다
+ * @param sentLength 이번 전송에서 실제로 보낸 길이. 데이터 접속을 열지 못한 경우 -1
+ * @return 성공시 NULL 반환. 실패시 NSError 반환
  */
-- (NSProgress * _Nullable)ftpXferWriteFrom:(const char * _Nonnull)fromPath
-                                      size:(long long int)fileSize
-                                     toPath:(const char * _Nullable)remotePath
-                                    control:(netbuf *)nControl
-                                       mode:(int)mode
-                                 completion:(void (^)(NSError * _Nullable error))completion {
+- (NSError * _Nullable)ftpXferWriteFrom:(const char * _Nonnull)fromPath
+                                   size:(long long int)fileSize
+                                 offset:(long long int)offset
+                                 toPath:(const char * _Nullable)remotePath
+                                control:(netbuf *)nControl
+                                   type:(int)type
+                                   mode:(int)mode
+                               progress:(NSProgress * _Nonnull)progress
+                             sentLength:(long long int * _Nonnull)sentLength {
+    *sentLength = -1;
+    // 파일 쓰기 동작이 아닌 경우 실패 처리
+    if (type != FTPLIB_FILE_WRITE &&
+        type != FTPLIB_FILE_WRITE_OFFSET &&
+        type != FTPLIB_FILE_APPEND) {
+        return [NSError FTPKitErrorWithCode:FTP_FailedToUploadFile];
+    }
     
     FILE *local = NULL;
 
@@ -159,12 +497,20 @@
     if (local == NULL) {
         strncpy(nControl->response, strerror(errno),
                 sizeof(nControl->response));
-        return NULL;
+        return [NSError FTPKitErrorWithCode:FTP_FailedToOpenFile];
+    }
+    // 이어 올리는 경우 서버에 있는 길이만큼 건너뛴다
+    if (offset > 0 &&
+        fseeko(local, (off_t)offset, SEEK_SET) != 0) {
+        strncpy(nControl->response, strerror(errno),
+                sizeof(nControl->response));
+        fclose(local);
+        return [NSError FTPKitErrorWithCode:FTP_FailedToOpenFile];
     }
 
     // nData를 NULL로 선언
     netbuf *nData = NULL;
-    if (!FtpAccess(remotePath, FTPLIB_FILE_WRITE, mode, 0, nControl, &nData)) {
+    if (!FtpAccess(remotePath, type, mode, offset, nControl, &nData)) {
         // 실패시, 파일 입력 버퍼를 비우고 닫는다
         if (local != NULL) {
             if (nData != NULL) {
@@ -174,82 +520,96 @@
             // 파일을 제거하진 않는다!
             //unlink(fromPath);
         }
-        return NULL;
+        NSString *response = [NSString stringWithCString:FtpLastResponse(nControl) encoding:_encoding];
+        return [NSError FTPKitErrorWithResponse:response];
     }
 
-    NSProgress *progress = [[NSProgress alloc] init];
     [progress setTotalUnitCount:fileSize];
+    [progress setCompletedUnitCount:offset];
     
-    // 백그라운드 큐에서 실행
-    dispatch_async(_queue, ^{
-
-        // 작업 실패 여부
-        bool wasFailed = false;
-        // 작업 강제 중지 여부
-        bool wasAborted = false;
-
-        int input = 0;
-        int write = 0;
-
-        // 버퍼 초기화
-        char *dbuf = malloc(FTPLIB_BUFSIZ);
-        // 전송된 파일 길이
-        long long int progressed = 0;
-
-        while ((input = (int)fread(dbuf, 1, FTPLIB_BUFSIZ, local)) > 0) {
-            if ([progress isCancelled] == true) {
-                wasFailed = true;
-                wasAborted = true;
-                [self stopOperation:nControl];
-                break;
-            }
-            
-            if ((write = FtpWrite(dbuf, input, nData)) < input) {
-                printf("short write: passed %d, wrote %d\n", input, write);
-                wasFailed = true;
-                break;
-            }
-            
-            // 완료 갯수 업데이트
-            progressed += FTPLIB_BUFSIZ;
-            if (progressed > fileSize)
-                progressed = fileSize;
-            [progress setCompletedUnitCount:progressed];
-            //NSLog(@"전송률 = %f", progress.fractionCompleted);
+    // 작업 실패 여부
+    bool wasFailed = false;
+    // 작업 강제 중지 여부
+    bool wasAborted = false;
+
+    int input = 0;
+    int write = 0;
+
+    // 버퍼 초기화
+    char *dbuf = malloc(FTPLIB_BUFSIZ);
+    // 전송된 파일 길이
+    long long int progressed = 0;
+
+    // 바이너리 전송은 로컬 파일에서 소켓으로 바로 보낸다
+    while (mode == FTPLIB_IMAGE &&
+           (input = FtpWriteFd(fileno(local), offset + progressed, kFTPKitWriteChunkSize, nData)) != 0) {
+        if (input < 0) {
+            wasFailed = true;
+            break;
         }
-
-        // nData 를 닫는다
-        FtpClose(nData);
-
-        // 실패
-        if (wasFailed == true) {
-            int errorCode = wasAborted == true ? FTP_Aborted : FTP_FailedToUploadFile;
-            completion([NSError FTPKitErrorWithCode:errorCode]);
+        progressed += input;
+        [progress setCompletedUnitCount:offset + progressed];
+        if ([progress isCancelled] == true) {
+            wasFailed = true;
+            wasAborted = true;
+            [self stopOperation:nControl];
+            break;
         }
-        // 성공
-        else {
-            completion(nil);
+    }
+
+    while (mode != FTPLIB_IMAGE &&
+           (input = (int)fread(dbuf, 1, FTPLIB_BUFSIZ, local)) > 0) {
+        if ([progress isCancelled] == true) {
+            wasFailed = true;
+            wasAborted = true;
+            [self stopOperation:nControl];
+            break;
         }
         
-        // dbuf 해제
-        if (dbuf != NULL) {
-            free(dbuf);
+        if ((write = FtpWrite(dbuf, input, nData)) < input) {
+            printf("short write: passed %d, wrote %d\n", input, write);
+            wasFailed = true;
+            break;
         }
+        
+        // 완료 갯수 업데이트
+        progressed += input;
+        [progress setCompletedUnitCount:offset + progressed];
+        //NSLog(@"전송률 = %f", progress.fractionCompleted);
+    }
 
-        // 파일 입력 버퍼를 비우고 닫는다
-        if (local != NULL) {
-            fclose(local);
-            // 파일을 제거하진 않는다!
-            //unlink(fromPath);
-        }
-    });
+    // nData 를 닫는다. 서버가 저장에 실패한 경우(452 등)도 실패 처리
+    if (!FtpClose(nData) &&
+        wasFailed == false) {
+        wasFailed = true;
+    }
+
+    *sentLength = progressed;
+    NSError *error = NULL;
+    // 실패
+    if (wasFailed == true) {
+        int errorCode = wasAborted == true ? FTP_Aborted : FTP_FailedToUploadFile;
+        error = [NSError FTPKitErrorWithCode:errorCode];
+    }
     
-    return progress;
+    // dbuf 해제
+    if (dbuf != NULL) {
+        free(dbuf);
+    }
+
+    // 파일 입력 버퍼를 비우고 닫는다
+    if (local != NULL) {
+        fclose(local);
+        // 파일을 제거하진 않는다!
+        //unlink(fromPath);
+    }
+    return error;
 }
 /**
  * 커맨드를 전송, 데이터를 포인터로 반환하는 메쏘드
  *
  * 데이터 / 디렉토리 읽기 전용 메쏘드이며, 쓰기 용도로 사용해선 안 된다
+ * 스케줄러 작업 안에서 호출하며, 전송이 끝날 때까지 반환하지 않는다
  *
  * @param remotePath FTP 파일 경로
  * @param savePath 다운로드 받은 파일을 저장할 경로. 직접 NSData로 받고자 하는 경우는 NULL로 지정
@@ -258,24 +618,26 @@
  * @param nControl netbuf
  * @param type 전송 타입
  * @param mode 전송 모드. 바이너리/아스키/이미지 중에서 선택.
- * @param completion 완료 핸들러. 데이터 형식으로 다운로드하는 경우, 성공시 NSData 반환. 실패시에는 NSError 값 반환.
- * @return NSProgress 반환. 해당 NSProgress를 이용, 중지 처리 가능. 접속 불가시 nil 반환
- */
-- (NSProgress * _Nullable)ftpXferReadDataFrom:(const char * _Nonnull)remotePath
-                                       toPath:(const char * _Nullable)savePath
-                                       offset:(long long int)offset
-                                       length:(long long int)length
-                                      control:(netbuf *)nControl
-                                         type:(int)type
-                                         mode:(int)mode
-                                   completion:(void (^)(NSData * _Nullable data,
-                                                        NSError * _Nullable error))completion {
-    // 파일 읽기 또는 디렉토리 읽기 동작이 아닌 경우 NULL 반환
+ * @param progress 진행 상태를 반영할 NSProgress. 취소되면 전송을 중지한다
+ * @param data 데이터 형식으로 다운로드하는 경우, 성공시 받은 NSData 반환. 파일 저장시는 NULL 지정
+ * @return 성공시 NULL 반환. 실패시 NSError 반환
+ */
+- (NSError * _Nullable)ftpXferReadDataFrom:(const char * _Nonnull)remotePath
+                                    toPath:(const char * _Nullable)savePath
+                                    offset:(long long int)offset
+                                    length:(long long int)length
+                                   control:(netbuf *)nControl
+                                      type:(int)type
+                                      mode:(int)mode
+                                  progress:(NSProgress * _Nonnull)progress
+                                      data:(NSData * _Nullable * _Nullable)data {
+    // 파일 읽기 또는 디렉토리 읽기 동작이 아닌 경우 실패 처리
     if (type != FTPLIB_FILE_READ &&
         type != FTPLIB_FILE_READ_OFFSET &&
         type != FTPLIB_DIR &&
-        type != FTPLIB_DIR_VERBOSE) {
-        return NULL;;
+        type != FTPLIB_DIR_VERBOSE &&
+        type != FTPLIB_MLSD) {
+        return [NSError FTPKitErrorWithCode:FTP_FailedToReadByUnknown];
     }
     
     // 데이터 읽기 작업인지 여부
@@ -287,29 +649,34 @@
     
     long long int fullLength = -1;
     
-    // 데이터 파일을 읽는 경우는 fullLength를 파일 크기로 지정
+    // 데이터 파일을 읽는 경우는 fullLength를 offset 부터 받을 길이로 지정
     // 디렉토리 읽기는 -1 유지
     if (isReadData) {
-        if (length <= 0) {
-            fullLength = [self fileSizeAt:remotePath];
+        // remotePath 는 nControl 의 작업 디렉토리 기준 상대 경로일 수 있으므로 같은 접속에서 확인한다
+        long long int fileSize = [self sizeAt:remotePath control:nControl];
+        
+        // 파일 크기를 알 수 없는 경우 중지 처리
+        if (fileSize < 0) {
+            NSString *response = [NSString stringWithCString:FtpLastResponse(nControl) encoding:_encoding];
+            return [NSError FTPKitErrorWithResponse:response];
         }
-        else {
-            fullLength = length;
+        // 파일 크기가 0 인 경우 중지 처리
+        if (fileSize == 0) {
+            return [NSError FTPKitErrorWithCode:FTP_ZeroFileSize];
         }
-        
-        // 전체 크기가 0 또는 그보다 작은 경우 중지 처리
-        if (fullLength <= 0) {
-            return NULL;
+        // offset 이 파일 끝 이후인 경우 중지 처리
+        if (offset >= fileSize) {
+            return [NSError FTPKitErrorWithCode:FTP_FailedToReadByWrongSize];
         }
-        // offset 이 전체 크기보다 큰 경우도 중지 처리
-        if (offset > fullLength) {
-            return NULL;
+        fullLength = fileSize - offset;
+        // 다운로드 길이가 정해진 경우, 파일 끝을 넘지 않도록 줄인다
+        // 파일 끝까지 받는 경우는 중지(ABOR) 없이 끝까지 읽도록 length 를 0 으로 바꾼다
+        if (length > 0 &&
+            length < fullLength) {
+            fullLength = length;
         }
-        // 다운로드 길이가 정해진 경우
-        if (length > 0) {
-            if (fullLength - (offset + length) < 0)
-                // 다운로드 가능한 길이를 변경 처리
-                length = fullLength - offset;
+        else {
+            length = 0;
         }
     }
     
@@ -327,7 +694,7 @@
         if (local == NULL) {
             strncpy(nControl->response, strerror(errno),
                     sizeof(nControl->response));
-            return NULL;
+            return [NSError FTPKitErrorWithCode:FTP_FailedToSaveToLocal];
         }
     }
     
@@ -344,236 +711,263 @@
                 fclose(local);
             }
         }
-        return NULL;
+        NSString *response = [NSString stringWithCString:FtpLastResponse(nControl) encoding:_encoding];
+        return [NSError FTPKitErrorWithResponse:response];
     }
     
-    NSProgress *progress = [[NSProgress alloc] init];
     [progress setTotalUnitCount:fullLength];
 
-    // 백그라운드 큐에서 실행
-    dispatch_async(_queue, ^{
-        // 파일 경로 저장 길이
-        NSInteger saveLength = 0;
-        
-        // 다운로드 버퍼 초기화
-        char *dbuf = malloc(FTPLIB_BUFSIZ);
-        // 버퍼 초기화
-        char *bufferData = NULL;
-        // 버퍼 타겟 사이즈
-        long long int bufferDataSize = 0;
-        if (isReadData == true) {
-            // 마지막 널값 처리를 위해 totalUnitCount 값에 1을 더한다
-            bufferDataSize = fullLength + 1;
-            // 버퍼 크기보다 큰 경우, 버퍼 크기로 재조정
-            if (FTPLIB_BUFFER_LENGTH < bufferDataSize)
-                bufferDataSize = FTPLIB_BUFFER_LENGTH;
-            bufferData = (char *)malloc(bufferDataSize);
-        }
-        else {
-            bufferDataSize = sizeof(char) * FTPLIB_BUFFER_LENGTH;
-            bufferData = (char *)malloc(bufferDataSize);
-        }
-        
-        // 작업 실패 여부
-        bool wasFailed = false;
-        // 작업 강제 중지 여부
-        bool wasAborted = false;
-        // 전송 길이 도달 여부
-        bool isEndOfFile = false;
-        
-        // 전송된 파일 길이
-        long long int progressed = 0;
+    // 파일 경로 저장 길이
+    NSInteger saveLength = 0;
+    
+    // 다운로드 버퍼 초기화
+    char *dbuf = malloc(FTPLIB_BUFSIZ);
+    // 버퍼 초기화
+    char *bufferData = NULL;
+    // 버퍼 크기
+    long long int bufferDataSize = 0;
+    if (isReadData == true) {
+        // 받을 길이를 아는 경우는 한 번에 할당. 마지막 널값 처리를 위해 1을 더한다
+        bufferDataSize = fullLength + 1;
+    }
+    else {
+        bufferDataSize = sizeof(char) * FTPLIB_BUFFER_LENGTH;
+    }
+    if (savePath == NULL) {
+        bufferData = (char *)malloc(bufferDataSize);
+    }
+    
+    // 작업 실패 여부
+    bool wasFailed = false;
+    // 작업 강제 중지 여부
+    bool wasAborted = false;
+    // 전송 길이 도달 여부
+    bool isEndOfFile = false;
+    
+    // 전송된 파일 길이
+    long long int progressed = 0;
+
+    // 한 번에 읽을 길이. 길이가 정해진 경우는 범위를 넘어서 읽지 않는다
+    int readLength = FTPLIB_BUFSIZ;
+    if (isReadData == true &&
+        length > 0 &&
+        length < readLength) {
+        readLength = (int)length;
+    }
 
-        while ((saveLength = FtpRead(dbuf, FTPLIB_BUFSIZ, nData)) > 0) {
-            // progress 중지 발생시
-            if ([progress isCancelled] == true) {
-                wasFailed = true;
+    // 바이너리 파일 저장은 FtpReadFd 로 소켓에서 파일로 바로 저장한다 (Linux 는 splice)
+    bool isDirect = savePath != NULL && mode == FTPLIB_IMAGE;
+    while (isDirect == true) {
+        int chunk = kFTPKitReadChunkSize;
+        if (isReadData == true &&
+            length > 0) {
+            // 정해진 length 에 도달하면 나머지는 받지 않고 중지한다
+            if (progressed >= length) {
+                isEndOfFile = true;
                 wasAborted = true;
-                // 작업 중지 처리
-                [self stopOperation:nControl];
                 break;
             }
+            chunk = (int)MIN((long long int)chunk, length - progressed);
+        }
+        saveLength = FtpReadFd(fileno(local), progressed, chunk, nData);
+        if (saveLength <= 0) {
+            // 0 은 전송 끝 또는 접속 실패 (아래에서 FtpClose 응답과 받은 길이로 확인), -1 은 파일 저장 실패
+            wasFailed = saveLength < 0;
+            break;
+        }
+        progressed += saveLength;
+        if (isReadData) {
+            [progress setCompletedUnitCount:progressed];
+        }
+        if ([progress isCancelled] == true) {
+            wasFailed = true;
+            wasAborted = true;
+            break;
+        }
+    }
 
-            // 예상 총 용량
-            long long int totalLength = progressed + FTPLIB_BUFSIZ;
-
-            // 파일 읽기가 아닌 경우
-            // 즉, 디렉토리 읽기인 경우, bufferData의 메모리 증가가 필요한지 확인 필요
-            if (isReadData == false) {
-                // 현재 저장 공간에 dbuf를 추가한 경우, 메모리 증가가 필요한지 여부를 확인
-                int multiple = ((int)totalLength / FTPLIB_BUFFER_LENGTH) + 1;
-                if (bufferDataSize < multiple * FTPLIB_BUFFER_LENGTH) {
-                    // 메모리 증대 필요시
-                    // realloc 실행
-                    // https://woo-dev.tistory.com/124
-                    char *tempBuffer = bufferData;
-                    // 마지막 널값 처리를 위해 multiple 값에 1을 더한다
-                    bufferDataSize = (multiple * FTPLIB_BUFFER_LENGTH) + 1;
-                    bufferData = (char *)realloc(bufferData, bufferDataSize);
-                    if (bufferData == NULL) {
-                        // 실패시 기존 포인터를 해제하고 중지 처리
-                        wasFailed = true;
-                        free(tempBuffer);
-                        // 작업 중지 처리
-                        [self stopOperation:nControl];
-                        break;
-                    }
-                }
-            }
-            
-            // 파일 읽기인 경우
-            // 정해진 length 가 있는 경우
-            if (isReadData == true &&
-                length > 0) {
-                // totalLength 가 정해진 length 초과
-                if (totalLength >= length) {
-                    // 저장 길이 변경
-                    saveLength = length - progressed;
-                    isEndOfFile = true;
-#if DEBUG
-                    if (saveLength <= 0) {
-                        NSLog(@"저장 가능한 길이가 0 이하. 더 이상의 저장은 불가능");
-                    }
-#endif
-                }
-            }
-            
-            // 파일 저장시
-            if (savePath != NULL &&
-                saveLength > 0) {
-                if (fwrite(dbuf, 1, saveLength, local) == 0)
-                    wasFailed = true;
-            }
-            // 데이터 반환시
-            else {
-                // bufferData에 dbuf를 추가
-                if (strncat(bufferData, dbuf, saveLength) == NULL) {
-                    wasFailed = true;
-                }
-            }
-            
-            // progressed에 현재 버퍼의 길이 추가
-            progressed += FTPLIB_BUFSIZ;
-            // 데이터 파일을 읽는 경우는 진행상태 업데이트
-            if (isReadData) {
-                [progress setCompletedUnitCount:progressed];
-            }
+    while (isDirect == false &&
+           (saveLength = FtpRead(dbuf, readLength, nData)) > 0) {
+        // progress 중지 발생시
+        if ([progress isCancelled] == true) {
+            wasFailed = true;
+            wasAborted = true;
+            break;
+        }
 
-            // 실패 발생시
-            if (wasFailed == true) {
-                // 추가 실패시
-                if (ftplib_debug) {
-                    perror("data read error");
-                }
-                // 실패 처리 필요
-                wasFailed = true;
-                // 정해진 길이 초과시, 중지 처리까지 선언한다
-                if (isEndOfFile == true) {
-                    wasAborted = true;
-                }
-                // 작업 중지 처리
-                [self stopOperation:nControl];
-                break;
-            }
-            
-            // 전송 길이 도달 여부 발생시 (전체 길이가 정해진 길이를 초과한 경우이므로 중지)
-            if (isEndOfFile == true) {
-                wasAborted = true;
-                // 작업 중지 처리
-                [self stopOperation:nControl];
-                break;
+        // 파일 읽기인 경우
+        // 정해진 length 가 있는 경우
+        if (isReadData == true &&
+            length > 0) {
+            // 정해진 length 에 도달
+            if (progressed + saveLength >= length) {
+                // 저장 길이 변경
+                saveLength = length - progressed;
+                isEndOfFile = true;
             }
         }
         
-        // nData 를 닫는다
-        FtpClose(nData);
-
-        // 완료 핸들러 실행 및 종료 처리를 진행
-        
-        // 파일 경로 저장시
+        // 파일 저장시
         if (savePath != NULL) {
-            int resultCode = FTP_Success;
-            if (wasFailed == true) {
-                resultCode = FTP_FailedToReadByUnknown;
-            }
-            else {
-                NSFileManager *fileManager = [NSFileManager defaultManager];
-                // 저장 경로는 UTF8로 인코딩해서 생성
-                NSString *savedPath = [NSString stringWithCString:savePath encoding:NSUTF8StringEncoding];
-                if ([fileManager fileExistsAtPath:savedPath] == false) {
-                    // 파일이 없는 경우 실패 처리
-                    resultCode = FTP_FailedToSaveToLocal;
-                    // 이유는 불확실하지만, 이 시점에서 NSFileManager로 파일 크기 확인이 불가능하므로, 존재 여부만 확인하도록 한다
-                }
-            }
-
-            // 성공시
-            if (resultCode == FTP_Success) {
-                completion(NULL, NULL);
-            }
-            // 실패시
-            else {
-                completion(NULL, [NSError FTPKitErrorWithCode:resultCode]);
-            }
+            if (saveLength > 0 &&
+                fwrite(dbuf, 1, saveLength, local) == 0)
+                wasFailed = true;
         }
         // 데이터 반환시
         else {
-            // 실패
-            // 또는 bufferData가 NIL인 경우
-            if (wasFailed == true ||
-                bufferData == NULL) {
-                int errorCode = wasAborted == true ? FTP_Aborted : FTP_FailedToReadByUnknown;
-                completion(NULL, [NSError FTPKitErrorWithCode:errorCode]);
-            }
-            // 파일 데이터 읽기시
-            // 또는 bufferData가 있는 경우
-            else {
-                // 데이터 파일을 읽는 경우, totalUnitCount에 맞춰서 데이터 생성
-                if (isReadData) {
-                    if (fullLength <= progressed) {
-                        completion([[NSData alloc] initWithBytes:bufferData length:fullLength], NULL);
-                    }
-                    else {
-                        // 용량 불일치로 다운로드 실패
-                        NSError *error = [NSError FTPKitErrorWithCode:FTP_FailedToReadByIncomplete];
-                        completion(NULL, error);
-                    }
+            // 공간이 부족한 경우 두 배로 늘린다. 마지막 널값 자리를 남긴다
+            if (bufferData == NULL ||
+                progressed + saveLength + 1 > bufferDataSize) {
+                long long int newSize = bufferDataSize;
+                while (progressed + saveLength + 1 > newSize) {
+                    newSize *= 2;
                 }
-                // 디렉토리를 읽는 경우
-                else {
-                    if (progressed <= 0) {
-                        // 데이터 길이가 0인 경우
-                        NSError *error = [NSError FTPKitErrorWithCode:FTP_FailedToReadByUnknown];
-                        completion(NULL, error);
-                    }
-                    else {
-                        completion([[NSData alloc] initWithBytes:bufferData length:progressed], NULL);
-                    }
+                char *tempBuffer = bufferData;
+                bufferData = (char *)realloc(bufferData, newSize);
+                if (bufferData == NULL) {
+                    // 실패시 기존 포인터를 해제하고 중지 처리
+                    free(tempBuffer);
+                    wasFailed = true;
+                    break;
                 }
+                bufferDataSize = newSize;
             }
+            // 길이를 따로 관리하므로 NUL 이 포함된 데이터도 잘리지 않는다
+            memcpy(bufferData + progressed, dbuf, saveLength);
+            bufferData[progressed + saveLength] = 0;
         }
         
-        // dbuf 해제
-        if (dbuf != NULL) {
-            free(dbuf);
+        // progressed에 현재 버퍼의 길이 추가
+        progressed += saveLength;
+        // 데이터 파일을 읽는 경우는 진행상태 업데이트
+        if (isReadData) {
+            [progress setCompletedUnitCount:progressed];
+        }
+        if (isReadData == true &&
+            length > 0 &&
+            length - progressed < readLength) {
+            readLength = (int)(length - progressed);
         }
 
-        // 버퍼 해제
-        if (bufferData != NULL) {
-            free(bufferData);
+        // 실패 발생시
+        if (wasFailed == true) {
+            // 추가 실패시
+            if (ftplib_debug) {
+                perror("data read error");
+            }
+            // 실패 처리 필요
+            wasFailed = true;
+            // 정해진 길이 초과시, 중지 처리까지 선언한다
+            if (isEndOfFile == true) {
+                wasAborted = true;
+            }
+            break;
         }
         
-        // 파일 출력 버퍼를 비우고 닫는다
-        if (local != NULL) {
-            fflush(local);
-            if (savePath != NULL) {
-                fclose(local);
+        // 전송 길이 도달 여부 발생시 (정해진 길이를 모두 받은 경우이므로 중지)
+        if (isEndOfFile == true) {
+            wasAborted = true;
+            break;
+        }
+    }
+    
+    // nData 를 닫는다
+    // 끝까지 받지 않은 경우는 ABOR 응답까지 읽어서, 제어 접속을 다음 작업에 그대로 사용할 수 있게 한다
+    if (wasFailed == true ||
+        isEndOfFile == true) {
+        FtpAbort(nData);
+    }
+    // 서버가 전송 실패(426 등)를 응답했거나 접속이 끊긴 경우
+    else if (FtpClose(nData) != 1) {
+        wasFailed = true;
+    }
+    // 받을 길이를 아는데 덜 받은 경우
+    if (wasFailed == false &&
+        isReadData == true &&
+        progressed != fullLength) {
+        wasFailed = true;
+    }
+
+    // 결과 및 종료 처리를 진행
+    NSError *error = NULL;
+    
+    // 파일 경로 저장시
+    if (savePath != NULL) {
+        int resultCode = FTP_Success;
+        if (wasFailed == true) {
+            resultCode = FTP_FailedToReadByUnknown;
+        }
+        else {
+            NSFileManager *fileManager = [NSFileManager defaultManager];
+            // 저장 경로는 UTF8로 인코딩해서 생성
+            NSString *savedPath = [NSString stringWithCString:savePath encoding:NSUTF8StringEncoding];
+            if ([fileManager fileExistsAtPath:savedPath] == false) {
+                // 파일이 없는 경우 실패 처리
+                resultCode = FTP_FailedToSaveToLocal;
+                // 이유는 불확실하지만, 이 시점에서 NSFileManager로 파일 크기 확인이 불가능하므로, 존재 여부만 확인하도록 한다
             }
         }
-    });
+
+        // 실패시
+        if (resultCode != FTP_Success) {
+            error = [NSError FTPKitErrorWithCode:resultCode];
+        }
+    }
+    // 데이터 반환시
+    else {
+        // 실패
+        // 또는 bufferData가 NIL인 경우
+        if (wasFailed == true ||
+            bufferData == NULL) {
+            int errorCode = wasAborted == true ? FTP_Aborted : FTP_FailedToReadByUnknown;
+            error = [NSError FTPKitErrorWithCode:errorCode];
+        }
+        // 파일 데이터 읽기시
+        // 또는 bufferData가 있는 경우
+        else {
+            // 데이터 파일을 읽는 경우, totalUnitCount에 맞춰서 데이터 생성
+            if (isReadData) {
+                if (fullLength <= progressed) {
+                    if (data != NULL) {
+                        *data = [[NSData alloc] initWithBytes:bufferData length:fullLength];
+                    }
+                }
+                else {
+                    // 용량 불일치로 다운로드 실패
+                    error = [NSError FTPKitErrorWithCode:FTP_FailedToReadByIncomplete];
+                }
+            }
+            // 디렉토리를 읽는 경우
+            else {
+                if (progressed <= 0) {
+                    // 데이터 길이가 0인 경우
+                    error = [NSError FTPKitErrorWithCode:FTP_FailedToReadByUnknown];
+                }
+                else if (data != NULL) {
+                    *data = [[NSData alloc] initWithBytes:bufferData length:progressed];
+                }
+            }
+        }
+    }
     
-    // Progress 반환
-    return progress;
+    // dbuf 해제
+    if (dbuf != NULL) {
+        free(dbuf);
+    }
+
+    // 버퍼 해제
+    if (bufferData != NULL) {
+        free(bufferData);
+    }
+    
+    // 파일 출력 버퍼를 비우고 닫는다
+    if (local != NULL) {
+        fflush(local);
+        if (savePath != NULL) {
+            fclose(local);
+        }
+    }
+    return error;
 }
 
 // MARK: - Methods
@@ -596,18 +990,114 @@
  @returns 64비트 정수형으로 크기 반환. 실패시 -1 반환
  */
 - (long long int)fileSizeAt:(const char * _Nonnull)path {
-    netbuf *conn = [self connect:NULL];
+    netbuf *conn = [self checkoutConnectionForPath:path error:NULL];
     if (conn == NULL) {
         return -1;
     }
-    unsigned int bytes;
-    int stat = FtpSize(path, &bytes, FTPLIB_BINARY, conn);
-    FtpQuit(conn);
-    if (stat == 0) {
+    long long int bytes = [self sizeAt:path control:conn];
+    [self checkinConnection:conn reusable:true];
+    if (bytes < 0) {
         FKLogError(@"File most likely does not exist %@", [NSString stringWithCString:path encoding:_encoding]);
         return -1;
     }
-    FKLogDebug(@"%@ bytes %d", [NSString stringWithCString:path encoding:_encoding], bytes);
+    FKLogDebug(@"%@ bytes %lld", [NSString stringWithCString:path encoding:_encoding], bytes);
+    return bytes;
+}
+/**
+ 서버 파일 끝 부분을 받아서 로컬 파일의 같은 위치와 비교
+ 
+ 서버 파일 끝까지 받으므로 전송이 정상 종료되어 접속을 계속 사용할 수 있다.
+ 
+ @param path `const char` 포인터 타입의 절대 경로
+ @param size 서버 파일 크기
+ @param length 비교할 길이
+ @param localPath 비교할 로컬 파일 경로
+ @param conn 사용할 접속
+ @returns 같으면 1, 다르면 0, 전송 실패시 -1 반환
+ */
+- (int)remoteTail:(const char * _Nonnull)path
+             size:(long long int)size
+           length:(long long int)length
+ matchesLocalFile:(const char * _Nonnull)localPath
+          control:(netbuf * _Nonnull)conn {
+    FILE *local = fopen(localPath, "rb");
+    if (local == NULL) {
+        strncpy(conn->response, strerror(errno), sizeof(conn->response));
+        return -1;
+    }
+    long long int start = size - length;
+    if (fseeko(local, (off_t)start, SEEK_SET) != 0) {
+        strncpy(conn->response, strerror(errno), sizeof(conn->response));
+        fclose(local);
+        return -1;
+    }
+    netbuf *nData = NULL;
+    int type = start > 0 ? FTPLIB_FILE_READ_OFFSET : FTPLIB_FILE_READ;
+    if (!FtpAccess([self path:path relativeToConnection:conn], type, FTPLIB_BINARY, start, conn, &nData)) {
+        fclose(local);
+        return -1;
+    }
+    
+    char *dbuf = malloc(FTPLIB_BUFSIZ);
+    char *lbuf = malloc(FTPLIB_BUFSIZ);
+    int match = 1;
+    long long int compared = 0;
+    int input = 0;
+    while ((input = FtpRead(dbuf, FTPLIB_BUFSIZ, nData)) > 0) {
+        // 이미 다른 부분을 찾았어도 226 응답을 받을 수 있도록 끝까지 읽는다
+        if (match == 1 &&
+            (fread(lbuf, 1, input, local) != (size_t)input ||
+             memcmp(dbuf, lbuf, input) != 0)) {
+            match = 0;
+        }
+        compared += input;
+    }
+    if (!FtpClose(nData) ||
+        input < 0) {
+        match = -1;
+    }
+    else if (match == 1 &&
+             compared != length) {
+        // 비교하는 동안 서버 파일이 바뀐 경우
+        match = 0;
+    }
+    free(dbuf);
+    free(lbuf);
+    fclose(local);
+    return match;
+}
+/**
+ 대여한 접속으로 서버 상의 파일 수정일(MDTM 응답) 확인
+ 
+ @param path `const char` 포인터 타입의 절대 경로
+ @param conn 사용할 접속
+ @returns 수정일 문자열. 서버가 MDTM 을 지원하지 않는 경우 빈 문자열 반환
+ */
+- (NSString * _Nonnull)modificationDateAt:(const char * _Nonnull)path control:(netbuf * _Nonnull)conn {
+    char modDate[kFTPKitTempBufferSize];
+    if (!FtpModDate([self path:path relativeToConnection:conn], modDate, sizeof(modDate), conn)) {
+        return @"";
+    }
+    return [NSString stringWithCString:modDate encoding:NSASCIIStringEncoding] ?: @"";
+}
+/**
+ 대여한 접속으로 서버 상의 파일 크기 확인
+ 
+ @param path `const char` 포인터 타입의 절대 경로
+ @param conn 사용할 접속
+ @returns 64비트 정수형으로 크기 반환. 실패시 -1 반환
+ */
+- (long long int)sizeAt:(const char * _Nonnull)path control:(netbuf * _Nonnull)conn {
+    fsz_t bytes;
+    // 4GB 이상의 파일도 처리할 수 있도록 가능한 경우 64비트 크기 사용
+#if defined(__UINT64_MAX)
+    int stat = FtpSizeLong([self path:path relativeToConnection:conn], &bytes, FTPLIB_BINARY, conn);
+#else
+    int stat = FtpSize([self path:path relativeToConnection:conn], &bytes, FTPLIB_BINARY, conn);
+#endif
+    if (stat == 0) {
+        return -1;
+    }
     return (long long int)bytes;
 }
 
@@ -662,53 +1152,57 @@
  @param remotePath 목록을 가져올 경로
  @param showHiddenFiles 감춤 파일 표시 여부
  @param completion 완료 핸들러로 읽어들인 FTPItem 배열 반환. 실패시 error 값이 반환.
- @return NSProgress 반환. 실패시 NULL 반환.
+ @return NSProgress 반환. 접속 실패 등은 완료 핸들러로 반환
  */
 - (NSProgress * _Nullable)listContentsAtPath:(NSString * _Nonnull)remotePath
                              showHiddenFiles:(BOOL)showHiddenFiles
                                   completion:(void (^ _Nonnull)(NSArray<FTPItem *> * _Nullable items, NSError * _Nullable error))completion {
-    NSError *connectionError = NULL;
-    netbuf *conn = [self connect:&connectionError];
-    if (conn == NULL) {
-        // 에러 반환
-        completion(NULL, connectionError);
-        return NULL;
-    }
+    NSProgress *progress = [[NSProgress alloc] init];
+    // 접속 대여와 전송 모두 스케줄러의 작업자에서 실행
+    [self scheduleTransfer:progress priority:FTPPriorityInteractive block:^{
+        // 대기 중에 취소된 경우
+        if ([progress isCancelled] == true) {
+            completion(NULL, [NSError FTPKitErrorWithCode:FTP_Aborted]);
+            return;
+        }
+        NSError *connectionError = NULL;
+        netbuf *conn = [self checkoutConnection:&connectionError];
+        if (conn == NULL) {
+            // 에러 반환
+            completion(NULL, connectionError);
+            return;
+        }
 
-    const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:_encoding];
-    NSProgress *progress = [self ftpXferReadDataFrom:path
-                                              toPath:NULL
-                                              offset:0
-                                              length:0
-                                             control:conn
-                                                type:FTPLIB_DIR_VERBOSE
-                                                mode:FTPLIB_ASCII
-                                          completion:^(NSData * _Nullable data, NSError * _Nullable error) {
+        const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
+        // 서버가 MLST 를 지원하면 형식이 정해진 MLSD 로 목록을 받는다
+        BOOL machineList = (FtpFeatures(conn) & FTPLIB_FEAT_MLST) != 0;
+        NSData *data = NULL;
+        NSError *error = [self ftpXferReadDataFrom:path
+                                            toPath:NULL
+                                            offset:0
+                                            length:0
+                                           control:conn
+                                              type:machineList ? FTPLIB_MLSD : FTPLIB_DIR_VERBOSE
+                                              mode:FTPLIB_ASCII
+                                          progress:progress
+                                              data:&data];
         if (error != NULL) {
             // 에러 발생시, 그대로 에러 반환
             completion(NULL, error);
         }
         else {
-            NSArray *items = [self parseListFromData:data showHiddentFiles:showHiddenFiles];
+            NSArray *items = machineList ? [self parseMachineListFromData:data showHiddentFiles:showHiddenFiles] : [self parseListFromData:data showHiddentFiles:showHiddenFiles];
             if (items == NULL ||
                 [items count] == 0) {
-                NSError *error = [NSError FTPKitErrorWithCode:FTP_FailedToReadByUnknown];
-                completion(NULL, error);
+                completion(NULL, [NSError FTPKitErrorWithCode:FTP_FailedToReadByUnknown]);
             }
             else {
                 completion(items, error);
             }
         }
-        // 접속 종료
-        FtpQuit(conn);
+        // 접속 반납. 전송 실패시에는 재사용하지 않는다
+        [self checkinConnection:conn reusable:(error == NULL)];
     }];
-    // progress 생성 실패시
-    if (progress == NULL) {
-        // 완료 핸들러 종료
-        NSError *error = [NSError FTPKitErrorWithCode:FTP_CannotConnectToServer];
-        completion(NULL, error);
-        return NULL;
-    }
     return progress;
 }
 
@@ -721,7 +1215,7 @@
  @param remotePath Full path of remote file to download.
  @param savePath 다운로드 받은 파일을 저장할 경로.
  @param completion 완료 핸들러. 실패시 error 반환.
- @return NSProgress 반환. 실패시 NULL 반환
+ @return NSProgress 반환. 경로를 변환할 수 없는 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
  */
 - (NSProgress * _Nullable)downloadFile:(NSString * _Nonnull)remotePath
                             toSavePath:(NSString * _Nonnull)savePath
@@ -742,7 +1236,7 @@
  @param offset 다운로드를 시작할 offset 위치. 처음부터 다운로드시 0 지정
  @param length 다운로드 받을 길이. 전체 다운로드시 0 지정
  @param completion 완료 핸들러. 성공시 data 반환. 실패시 error 반환.
- @return NSProgress 반환. 실패시 NULL 반환
+ @return NSProgress 반환. 경로를 변환할 수 없는 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
  */
 - (NSProgress * _Nullable)downloadFile:(NSString * _Nonnull)remotePath
                             toSavePath:(NSString * _Nonnull)savePath
@@ -750,17 +1244,9 @@
                                 length:(long long int)length
                             completion:(void (^ _Nonnull)(NSError * _Nullable error))completion {
     
-    NSError *connectionError = NULL;
-    netbuf *conn = [self connect:&connectionError];
-    if (conn == NULL) {
-        // 에러 반환 처리
-        completion(connectionError);
-        return NULL;
-    }
-        
-    const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
+    const char *remoteFilePath = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
     const char *saveFilePath = [savePath cStringUsingEncoding:_encoding];
-    if (path == NULL ||
+    if (remoteFilePath == NULL ||
         saveFilePath == NULL) {
         // 파일 열기 실패
         completion([NSError FTPKitErrorWithCode:FTP_FailedToOpenFile]);
@@ -772,14 +1258,32 @@
         type = FTPLIB_FILE_READ_OFFSET;
     }
     
-    NSProgress *progress = [self ftpXferReadDataFrom:path
-                                            toPath:saveFilePath
+    NSProgress *progress = [[NSProgress alloc] init];
+    // 접속 대여와 전송 모두 스케줄러의 작업자에서 실행
+    [self scheduleTransfer:progress priority:self.transferPriority block:^{
+        // 대기 중에 취소된 경우
+        if ([progress isCancelled] == true) {
+            completion([NSError FTPKitErrorWithCode:FTP_Aborted]);
+            return;
+        }
+        const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
+        NSError *connectionError = NULL;
+        netbuf *conn = [self checkoutConnectionForPath:path error:&connectionError];
+        if (conn == NULL) {
+            // 에러 반환 처리
+            completion(connectionError);
+            return;
+        }
+        
+        NSError *error = [self ftpXferReadDataFrom:[self path:path relativeToConnection:conn]
+                                            toPath:[savePath cStringUsingEncoding:self.encoding]
                                             offset:offset
                                             length:length
                                            control:conn
                                               type:type
                                               mode:FTPLIB_BINARY
-                                        completion:^(NSData * _Nullable data, NSError * _Nullable error) {
+                                          progress:progress
+                                              data:NULL];
         if (error != NULL) {
             // 에러 발생시
             // 이미 생성된 파일이 있는 경우 제거 처리
@@ -790,340 +1294,1974 @@
         }
         
         completion(error);
-        FtpQuit(conn);
+        // ABOR 응답을 읽지 못한 접속은 풀에서 재사용하지 않는다
+        [self checkinConnection:conn reusable:(error == NULL)];
     }];
-
-    if (progress == NULL) {
-        // 완료 핸들러 종료
-        completion([NSError FTPKitErrorWithCode:FTP_CannotConnectToServer]);
-        return NULL;
-    }
     return progress;
 }
 /**
- FTP 경로에서 데이터 다운로드.
+ FTP 경로의 파일을 여러 접속으로 나눠서 동시에 다운로드.
  
- - 전체 파일을 데이터로 다운로드
+ - 파일을 구간으로 나눠 구간마다 풀에서 대여한 접속으로 REST + RETR 전송
+ - 저장 파일을 미리 전체 크기로 만들고, 각 구간은 해당 위치에 직접 쓴다
+ - 두 개의 접속으로 시작해서 전송률이 오르는 동안 maximumSegments 까지 접속을 늘린다
+ - 먼저 끝난 접속은 남은 구간이 가장 긴 접속의 뒷부분을 나눠 받는다
  - 반환된 NSProgress를 이용해 작업 취소 가능
 
  @param remotePath Full path of remote file to download.
- @param completion 완료 핸들러. 성공시 data 반환. 실패시 error 반환.
+ @param savePath 다운로드 받은 파일을 저장할 경로.
+ @param maximumSegments 최대 동시 접속 수. 1 이하이거나 파일이 작은 경우 하나의 접속으로 다운로드
+ @param completion 완료 핸들러. 실패시 error 반환.
  @return NSProgress 반환. 실패시 NULL 반환
  */
 - (NSProgress * _Nullable)downloadFile:(NSString * _Nonnull)remotePath
-                            completion:(void (^ _Nonnull)(NSData * _Nullable data,
-                                                          NSError * _Nullable error))completion
-{
-    return [self downloadFile:remotePath
-                       offset:0
-                       length:0
-                   completion:completion];
+                            toSavePath:(NSString * _Nonnull)savePath
+                       maximumSegments:(NSInteger)maximumSegments
+                            completion:(void (^ _Nonnull)(NSError * _Nullable error))completion {
+    const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
+    const char *saveFilePath = [savePath cStringUsingEncoding:_encoding];
+    if (path == NULL ||
+        saveFilePath == NULL) {
+        // 파일 열기 실패
+        completion([NSError FTPKitErrorWithCode:FTP_FailedToOpenFile]);
+        return NULL;
+    }
+    
+    long long int fileSize = [self fileSizeAt:path];
+    // 크기를 알 수 없거나 나눌 만큼 크지 않은 경우 하나의 접속으로 다운로드
+    if (maximumSegments <= 1 ||
+        fileSize < kFTPKitMinimumSegmentSize * 2) {
+        return [self downloadFile:remotePath
+                       toSavePath:savePath
+                       completion:completion];
+    }
+    
+    return [self segmentedDownloadFile:path
+                                  size:fileSize
+                            toSavePath:savePath
+                       maximumSegments:maximumSegments
+                               journal:nil
+                            completion:completion];
 }
 /**
- FTP 경로에서 offset/length를 지정해 필요한 만큼의 데이터 다운로드.
+ FTP 경로의 파일을 재시작 후에도 이어받을 수 있도록 다운로드.
  
- - 반환된 NSProgress를 이용해 작업 취소 가능
+ - 저장 파일 옆에 저널(<저장 경로>.ftpjournal)을 두고, 디스크에 기록이 확인된 구간을 남긴다
+ - 같은 저장 경로로 다시 호출하면, 원격 파일 크기와 수정일(MDTM)이 같은 경우 남은 구간만 REST 로 이어받는다
+ - 실패하거나 취소된 경우 받은 파일과 저널을 지우지 않는다. 완료시 저널을 삭제한다
+ - 구간 분할과 접속 수 조정은 downloadFile:toSavePath:maximumSegments:completion: 과 같다
+ - 반환된 NSProgress를 이용해 작업 취소 가능. 진행 상태는 이미 받은 길이부터 시작한다
 
  @param remotePath Full path of remote file to download.
- @param offset 다운로드를 시작할 offset 위치. 처음부터 다운로드시 0 지정
- @param length 다운로드 받을 길이. 전체 다운로드시 0 지정
- @param completion 완료 핸들러. 성공시 data 반환. 실패시 error 반환.
+ @param savePath 다운로드 받은 파일을 저장할 경로.
+ @param maximumSegments 최대 동시 접속 수
+ @param completion 완료 핸들러. 실패시 error 반환.
  @return NSProgress 반환. 실패시 NULL 반환
  */
-- (NSProgress * _Nullable)downloadFile:(NSString * _Nonnull)remotePath
-                                offset:(long long int)offset
-                                length:(long long int)length
-                            completion:(void (^ _Nonnull)(NSData * _Nullable data,
-                                                          NSError * _Nullable error))completion
-{
+- (NSProgress * _Nullable)resumableDownloadFile:(NSString * _Nonnull)remotePath
+                                     toSavePath:(NSString * _Nonnull)savePath
+                                maximumSegments:(NSInteger)maximumSegments
+                                     completion:(void (^ _Nonnull)(NSError * _Nullable error))completion {
+    const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
+    const char *saveFilePath = [savePath cStringUsingEncoding:_encoding];
+    if (path == NULL ||
+        saveFilePath == NULL) {
+        // 파일 열기 실패
+        completion([NSError FTPKitErrorWithCode:FTP_FailedToOpenFile]);
+        return NULL;
+    }
+    
     NSError *connectionError = NULL;
-    netbuf *conn = [self connect:&connectionError];
+    netbuf *conn = [self checkoutConnectionForPath:path error:&connectionError];
     if (conn == NULL) {
         // 에러 반환 처리
-        completion(NULL, connectionError);
+        completion(connectionError);
         return NULL;
     }
-    
-    const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
-    if (path == NULL) {
-        // 파일 열기 실패
-        completion(NULL, [NSError FTPKitErrorWithCode:FTP_FailedToOpenFile]);
-        return NULL;
+    // 저널 확인용 원격 파일 크기와 수정일
+    long long int fileSize = [self sizeAt:path control:conn];
+    NSString *modificationDate = fileSize > 0 ? [self modificationDateAt:path control:conn] : @"";
+    [self checkinConnection:conn reusable:true];
+    if (fileSize <= 0) {
+        // 크기를 알 수 없는 경우 이어받을 수 없으므로 하나의 접속으로 다운로드
+        return [self downloadFile:remotePath
+                       toSavePath:savePath
+                       completion:completion];
     }
     
-    int type = FTPLIB_FILE_READ;
-    if (offset > 0) {
-        type = FTPLIB_FILE_READ_OFFSET;
+    FTPDownloadJournal *journal = [FTPDownloadJournal journalAtSavePath:savePath
+                                                              remotePath:remotePath
+                                                                fileSize:fileSize
+                                                        modificationDate:modificationDate];
+    // 저장 파일 크기가 다르면 저널 이후 파일이 바뀐 것이므로 처음부터 받는다
+    if (journal != nil &&
+        [savePath fileSize] != fileSize) {
+        journal = nil;
     }
-    NSProgress *progress = [self ftpXferReadDataFrom:path
-                                              toPath:NULL
-                                              offset:offset
-                                              length:length
-                                             control:conn
-                                                type:type
-                                                mode:FTPLIB_BINARY
-                                          completion:^(NSData * _Nullable data, NSError * _Nullable error) {
-        completion(data, error);
-        FtpQuit(conn);
-    }];
-    
-    if (progress == NULL) {
-        // 완료 핸들러 종료
-        completion(NULL, [NSError FTPKitErrorWithCode:FTP_CannotConnectToServer]);
-        return NULL;
+    if (journal == nil) {
+        journal = [[FTPDownloadJournal alloc] initWithSavePath:savePath
+                                                    remotePath:remotePath
+                                                      fileSize:fileSize
+                                              modificationDate:modificationDate];
     }
-    return progress;
+    
+    return [self segmentedDownloadFile:path
+                                  size:fileSize
+                            toSavePath:savePath
+                       maximumSegments:MAX(maximumSegments, 1)
+                               journal:journal
+                            completion:completion];
 }
-
 /**
- 로컬 파일을 지정된 FTP 디렉토리로 업로드.
+ 분할 다운로드 시작.
  
- - 반환된 NSProgress를 이용해 작업 취소 가능
-
- @param localPath 업로드할 로컬 파일 경로.
- @param remoteDirectory 업로드할 FTP 디렉토리 경로.
+ @param path 서버 인코딩으로 변환된 절대 경로
+ @param fileSize 원격 파일 크기
+ @param savePath 다운로드 받은 파일을 저장할 경로.
+ @param maximumSegments 최대 동시 접속 수
+ @param journal 이어받기 저널. 사용하지 않는 경우 nil
  @param completion 완료 핸들러. 실패시 error 반환.
  @return NSProgress 반환. 실패시 NULL 반환
  */
-- (NSProgress * _Nullable)uploadFileFrom:(NSString * _Nonnull)localPath
-                             toDirectory:(NSString * _Nonnull)remoteDirectory
-                              completion:(void (^ _Nonnull)(NSError * _Nullable error))completion {
-    NSString *targetPath = [remoteDirectory stringByAppendingPathComponent:[localPath lastPathComponent]];
-    return [self uploadFileFrom:localPath to:targetPath completion:completion];
+- (NSProgress * _Nullable)segmentedDownloadFile:(const char * _Nonnull)path
+                                           size:(long long int)fileSize
+                                     toSavePath:(NSString * _Nonnull)savePath
+                                maximumSegments:(NSInteger)maximumSegments
+                                        journal:(FTPDownloadJournal * _Nullable)journal
+                                     completion:(void (^ _Nonnull)(NSError * _Nullable error))completion {
+    const char *saveFilePath = [savePath cStringUsingEncoding:_encoding];
+    NSArray<NSArray<NSNumber *> *> *committedRanges = journal != nil ? journal.committedRanges : @[];
+    
+    // 각 구간을 위치 지정 쓰기(pwrite)로 저장할 수 있도록 전체 크기를 미리 확보
+    // 이어받는 경우는 기존 내용을 유지
+    int flags = O_RDWR | O_CREAT;
+    if ([committedRanges count] == 0) {
+        flags |= O_TRUNC;
+    }
+    int fd = open(saveFilePath, flags, 0644);
+    if (fd < 0) {
+        completion([NSError FTPKitErrorWithCode:FTP_FailedToSaveToLocal]);
+        return NULL;
+    }
+    if (ftruncate(fd, fileSize) != 0) {
+        close(fd);
+        unlink(saveFilePath);
+        completion([NSError FTPKitErrorWithCode:FTP_FailedToSaveToLocal]);
+        return NULL;
+    }
+    
+    FTPSegmentedDownload *download = [[FTPSegmentedDownload alloc] init];
+    download.path = strdup(path);
+    download.fd = fd;
+    download.fileSize = fileSize;
+    download.maximumSegments = maximumSegments;
+    download.retries = maximumSegments;
+    download.growing = true;
+    download.sampleTime = [NSDate timeIntervalSinceReferenceDate];
+    download.segments = [[NSMutableArray alloc] init];
+    download.progress = [[NSProgress alloc] init];
+    [download.progress setTotalUnitCount:fileSize];
+    download.group = dispatch_group_create();
+    download.journal = journal;
+    
+    // 저널에 기록된 구간 사이의 빈 구간만 받는다
+    long long int position = 0;
+    for (NSArray<NSNumber *> *range in committedRanges) {
+        [download addSegmentFrom:position to:[range[0] longLongValue]];
+        position = [range[1] longLongValue];
+    }
+    [download addSegmentFrom:position to:fileSize];
+    [download.progress setCompletedUnitCount:fileSize - [download remainingLength]];
+    download.sampleBytes = download.progress.completedUnitCount;
+    download.journalBytes = download.progress.completedUnitCount;
+    if (journal != nil) {
+        // 이전 파일의 저널이 남아 있지 않도록 새 원격 파일 정보를 먼저 기록
+        [journal commitRanges:@[] fileDescriptor:fd];
+    }
+    
+    @synchronized (download) {
+        for (NSInteger index = 0; index < MIN(2, maximumSegments); index++) {
+            [self startSegmentWorker:download];
+        }
+    }
+    
+    // 모든 작업자 종료시 완료 처리
+    dispatch_group_notify(download.group, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        NSError *error = NULL;
+        NSArray<NSArray<NSNumber *> *> *writtenRanges = nil;
+        @synchronized (download) {
+            error = download.error;
+            if (error == NULL &&
+                [download.progress isCancelled] == true) {
+                error = [NSError FTPKitErrorWithCode:FTP_Aborted];
+            }
+            if (error == NULL &&
+                [download remainingLength] > 0) {
+                error = [NSError FTPKitErrorWithCode:FTP_FailedToReadByIncomplete];
+            }
+            writtenRanges = [download writtenRanges];
+        }
+        if (download.journal != nil) {
+            if (error == NULL) {
+                [download.journal remove];
+            }
+            else {
+                // 다음 호출에서 이어받을 수 있도록 마지막까지 받은 구간을 기록
+                [download.journal commitRanges:writtenRanges fileDescriptor:download.fd];
+            }
+        }
+        close(download.fd);
+        if (error != NULL &&
+            download.journal == nil) {
+            // 이미 생성된 파일 제거 처리
+            [[NSFileManager defaultManager] removeItemAtPath:savePath error:NULL];
+        }
+        completion(error);
+    });
+    
+    return download.progress;
 }
 /**
- 로컬 파일을 지정된 FTP 경로로 업로드.
+ 전송 정체나 접속 끊김을 감시하면서 FTP 경로의 파일을 다운로드.
  
+ - 데이터 접속에서 stallTimeout 동안 받은 데이터가 없으면 정체로 보고 전송을 중지한다
+ - 정체되거나 접속이 끊긴 경우 새 접속으로 서버 파일 크기와 수정일이 같은지 확인한 뒤, 받은 위치부터 REST 로 이어받는다
+ - 재접속 전 대기 시간은 0.5초부터 두 배씩 늘어나며, 재시도는 maximumRetries 번까지 한다
  - 반환된 NSProgress를 이용해 작업 취소 가능
 
- @param localPath 업로드할 로컬 파일 경로.
- @param remotePath 업로드할 FTP 경로.
- @param completion 완료 핸들러. 실패시 error 반환.
+ @param remotePath Full path of remote file to download.
+ @param savePath 다운로드 받은 파일을 저장할 경로.
+ @param stallTimeout 정체로 판단하는 시간(초)
+ @param maximumRetries 최대 재시도 횟수
+ @param completion 완료 핸들러. 실제 재시도 횟수 반환. 실패시 error 반환.
  @return NSProgress 반환. 실패시 NULL 반환
  */
-- (NSProgress * _Nullable)uploadFileFrom:(NSString * _Nonnull)localPath
-                                      to:(NSString * _Nonnull)remotePath
-                              completion:(void (^ _Nonnull)(NSError * _Nullable error))completion {
-    if ([[NSFileManager defaultManager] fileExistsAtPath:localPath] == false) {
+- (NSProgress * _Nullable)supervisedDownloadFile:(NSString * _Nonnull)remotePath
+                                      toSavePath:(NSString * _Nonnull)savePath
+                                    stallTimeout:(NSTimeInterval)stallTimeout
+                                  maximumRetries:(NSInteger)maximumRetries
+                                      completion:(void (^ _Nonnull)(NSInteger retries,
+                                                                    NSError * _Nullable error))completion {
+    const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
+    const char *saveFilePath = [savePath cStringUsingEncoding:_encoding];
+    if (path == NULL ||
+        saveFilePath == NULL) {
         // 파일 열기 실패
-        completion([NSError FTPKitErrorWithCode:FTP_FailedToOpenFile]);
+        completion(0, [NSError FTPKitErrorWithCode:FTP_FailedToOpenFile]);
         return NULL;
     }
-
+    
     NSError *connectionError = NULL;
-    netbuf *conn = [self connect:&connectionError];
+    netbuf *conn = [self checkoutConnectionForPath:path error:&connectionError];
     if (conn == NULL) {
         // 에러 반환 처리
-        completion(connectionError);
+        completion(0, connectionError);
+        return NULL;
+    }
+    // 이어받기 전 서버 파일이 바뀌지 않았는지 확인하기 위한 크기와 수정일
+    long long int fileSize = [self sizeAt:path control:conn];
+    if (fileSize <= 0) {
+        NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
+        [self checkinConnection:conn reusable:true];
+        completion(0, fileSize == 0 ? [NSError FTPKitErrorWithCode:FTP_ZeroFileSize] : [NSError FTPKitErrorWithResponse:response]);
         return NULL;
     }
+    NSString *modificationDate = [self modificationDateAt:path control:conn];
     
-    long long int fileSize = [localPath fileSize];
-    if (fileSize == 0) {
-        completion([NSError FTPKitErrorWithCode:FTP_ZeroFileSize]);
+    int fd = open(saveFilePath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        [self checkinConnection:conn reusable:true];
+        completion(0, [NSError FTPKitErrorWithCode:FTP_FailedToSaveToLocal]);
         return NULL;
     }
     
-    const char *fromLocalPath = [[localPath urlEncodedString] cStringUsingEncoding:NSUTF8StringEncoding];
-    const char *toSavePath = [[remotePath urlEncodedString] cStringUsingEncoding:_encoding];
-    NSProgress *progress = [self ftpXferWriteFrom:fromLocalPath
-                                             size:fileSize
-                                           toPath:toSavePath
-                                          control:conn
-                                             mode:FTPLIB_BINARY
-                                       completion:^(NSError * _Nullable error) {
-        completion(error);
-        FtpQuit(conn);
-    }];
-    
-    if (progress == NULL) {
-        // 접속 실패로 완료 핸들러 종료
-        completion([NSError FTPKitErrorWithCode:FTP_CannotConnectToServer]);
-        return NULL;
+    char *remote = strdup(path);
+    int stallTime = (int)(stallTimeout * 1000);
+    NSProgress *progress = [[NSProgress alloc] init];
+    [progress setTotalUnitCount:fileSize];
+    
+    // 재시도 대기 중에도 다른 작업을 막지 않도록 별도 큐에서 실행
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        netbuf *control = conn;
+        // 파일에 저장된 길이
+        long long int received = 0;
+        // 재시도 횟수
+        NSInteger retries = 0;
+        NSError *error = NULL;
+        
+        while (true) {
+            if ([progress isCancelled] == true) {
+                error = [NSError FTPKitErrorWithCode:FTP_Aborted];
+                break;
+            }
+            if (control == NULL) {
+                NSTimeInterval delay = MIN(kFTPKitRetryInitialDelay * pow(2, retries - 1), kFTPKitRetryMaximumDelay);
+                [NSThread sleepForTimeInterval:delay];
+                control = [self checkoutConnectionForPath:remote error:&error];
+                if (control == NULL) {
+                    if (retries >= maximumRetries) {
+                        break;
+                    }
+                    retries++;
+                    continue;
+                }
+                error = NULL;
+                // 서버 파일이 바뀐 경우 이어받을 수 없다
+                if ([self sizeAt:remote control:control] != fileSize ||
+                    [[self modificationDateAt:remote control:control] isEqualToString:modificationDate] == false) {
+                    error = [NSError FTPKitErrorWithCode:FTP_RemoteFileChanged];
+                    break;
+                }
+            }
+            
+            FtpOptions(FTPLIB_STALLTIME, stallTime, control);
+            int type = received > 0 ? FTPLIB_FILE_READ_OFFSET : FTPLIB_FILE_READ;
+            netbuf *nData = NULL;
+            if (!FtpAccess([self path:remote relativeToConnection:control], type, FTPLIB_BINARY, received, control, &nData)) {
+                NSString *response = [NSString stringWithCString:FtpLastResponse(control) encoding:_encoding];
+                error = [NSError FTPKitErrorWithResponse:response];
+                // 5xx 응답은 재시도해도 같으므로 중지
+                if (FtpLastResponse(control)[0] == '5') {
+                    break;
+                }
+            }
+            else {
+                // 재시도하지 않는 실패 여부
+                bool wasFailed = false;
+                int input = 0;
+                while ((input = FtpReadFd(fd, received, kFTPKitReadChunkSize, nData)) != 0) {
+                    if (input < 0) {
+                        error = [NSError FTPKitErrorWithCode:FTP_FailedToSaveToLocal];
+                        wasFailed = true;
+                        break;
+                    }
+                    received += input;
+                    [progress setCompletedUnitCount:received];
+                    if ([progress isCancelled] == true) {
+                        error = [NSError FTPKitErrorWithCode:FTP_Aborted];
+                        wasFailed = true;
+                        break;
+                    }
+                }
+                bool stalled = nData->stalled != 0;
+                int closed = FtpClose(nData);
+                if (wasFailed == true) {
+                    break;
+                }
+                if (received == fileSize &&
+                    closed == 1) {
+                    // 완료
+                    error = NULL;
+                    break;
+                }
+                if (received > fileSize) {
+                    error = [NSError FTPKitErrorWithCode:FTP_RemoteFileChanged];
+                    break;
+                }
+                if (stalled == true) {
+                    NSString *response = [NSString stringWithCString:FtpLastResponse(control) encoding:_encoding];
+                    error = [NSError FTPKitErrorWithResponse:response];
+                }
+                else {
+                    error = [NSError FTPKitErrorWithCode:FTP_FailedToReadByIncomplete];
+                }
+            }
+            
+            // 응답 순서를 알 수 없으므로 QUIT 없이 종료하고 새 접속으로 이어받는다
+            [self.connectionPool discardConnection:control];
+            control = NULL;
+            if (retries >= maximumRetries) {
+                break;
+            }
+            retries++;
+            FKLogDebug(@"Transfer interrupted at %lld, retry %ld: %@", received, (long)retries, error);
+        }
+        
+        if (control != NULL) {
+            FtpOptions(FTPLIB_STALLTIME, 0, control);
+            [self checkinConnection:control reusable:(error == NULL)];
+        }
+        close(fd);
+        if (error != NULL) {
+            // 이미 생성된 파일 제거 처리
+            [[NSFileManager defaultManager] removeItemAtPath:savePath error:NULL];
+        }
+        free(remote);
+        completion(retries, error);
+    });
+    
+    return progress;
+}
+/**
+ FTP 경로에서 데이터 다운로드.
+ 
+ - 전체 파일을 데이터로 다운로드
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param remotePath Full path of remote file to download.
+ @param completion 완료 핸들러. 성공시 data 반환. 실패시 error 반환.
+ @return NSProgress 반환. 경로를 변환할 수 없는 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
+ */
+- (NSProgress * _Nullable)downloadFile:(NSString * _Nonnull)remotePath
+                            completion:(void (^ _Nonnull)(NSData * _Nullable data,
+                                                          NSError * _Nullable error))completion
+{
+    return [self downloadFile:remotePath
+                       offset:0
+                       length:0
+                   completion:completion];
+}
+/**
+ FTP 경로에서 offset/length를 지정해 필요한 만큼의 데이터 다운로드.
+ 
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param remotePath Full path of remote file to download.
+ @param offset 다운로드를 시작할 offset 위치. 처음부터 다운로드시 0 지정
+ @param length 다운로드 받을 길이. 전체 다운로드시 0 지정
+ @param completion 완료 핸들러. 성공시 data 반환. 실패시 error 반환.
+ @return NSProgress 반환. 경로를 변환할 수 없는 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
+ */
+- (NSProgress * _Nullable)downloadFile:(NSString * _Nonnull)remotePath
+                                offset:(long long int)offset
+                                length:(long long int)length
+                            completion:(void (^ _Nonnull)(NSData * _Nullable data,
+                                                          NSError * _Nullable error))completion
+{
+    if ([[remotePath urlEncodedString] cStringUsingEncoding:self.encoding] == NULL) {
+        // 파일 열기 실패
+        completion(NULL, [NSError FTPKitErrorWithCode:FTP_FailedToOpenFile]);
+        return NULL;
+    }
+    
+    int type = FTPLIB_FILE_READ;
+    if (offset > 0) {
+        type = FTPLIB_FILE_READ_OFFSET;
+    }
+    
+    NSProgress *progress = [[NSProgress alloc] init];
+    // 접속 대여와 전송 모두 스케줄러의 작업자에서 실행
+    [self scheduleTransfer:progress priority:self.transferPriority block:^{
+        // 대기 중에 취소된 경우
+        if ([progress isCancelled] == true) {
+            completion(NULL, [NSError FTPKitErrorWithCode:FTP_Aborted]);
+            return;
+        }
+        const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
+        NSError *connectionError = NULL;
+        netbuf *conn = [self checkoutConnectionForPath:path error:&connectionError];
+        if (conn == NULL) {
+            // 에러 반환 처리
+            completion(NULL, connectionError);
+            return;
+        }
+        
+        NSData *data = NULL;
+        NSError *error = [self ftpXferReadDataFrom:[self path:path relativeToConnection:conn]
+                                            toPath:NULL
+                                            offset:offset
+                                            length:length
+                                           control:conn
+                                              type:type
+                                              mode:FTPLIB_BINARY
+                                          progress:progress
+                                              data:&data];
+        completion(data, error);
+        // ABOR 응답을 읽지 못한 접속은 풀에서 재사용하지 않는다
+        [self checkinConnection:conn reusable:(error == NULL)];
+    }];
+    return progress;
+}
+/**
+ FTP 경로의 파일을 받는 대로 조각 단위로 전달.
+ 
+ - 파일 전체를 메모리에 모으지 않으므로, 파일 크기와 관계없이 사용하는 메모리가 일정하다
+ - chunkHandler 가 FTPStreamPause 를 반환하면, 반환된 NSProgress 의 resume 이 호출될 때까지 읽지 않는다.
+   그동안 서버는 TCP 수신 창이 차면 전송을 멈춘다. NSProgress 의 pause 로도 멈출 수 있다
+ - chunkHandler 와 completion 은 백그라운드 큐에서 순서대로 호출된다
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param remotePath Full path of remote file to download.
+ @param offset 다운로드를 시작할 offset 위치. 처음부터 다운로드시 0 지정
+ @param chunkHandler 데이터 조각 핸들러. 받은 데이터와 파일에서의 위치를 전달받고, 다음 동작을 반환한다.
+ @param completion 완료 핸들러. 실패 또는 중지시 error 반환.
+ @return NSProgress 반환. 실패시 NULL 반환
+ */
+- (NSProgress * _Nullable)streamFile:(NSString * _Nonnull)remotePath
+                              offset:(long long int)offset
+                        chunkHandler:(FTPStreamAction (^ _Nonnull)(NSData * _Nonnull chunk,
+                                                                   long long int chunkOffset))chunkHandler
+                          completion:(void (^ _Nonnull)(NSError * _Nullable error))completion
+{
+    const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
+    NSError *connectionError = NULL;
+    netbuf *conn = [self checkoutConnectionForPath:path error:&connectionError];
+    if (conn == NULL) {
+        // 에러 반환 처리
+        completion(connectionError);
+        return NULL;
+    }
+    
+    if (path == NULL) {
+        [self checkinConnection:conn reusable:true];
+        // 파일 열기 실패
+        completion([NSError FTPKitErrorWithCode:FTP_FailedToOpenFile]);
+        return NULL;
+    }
+    
+    // 진행률 표시용. 크기를 모르는 경우 -1
+    long long int fileSize = [self sizeAt:path control:conn];
+    int type = offset > 0 ? FTPLIB_FILE_READ_OFFSET : FTPLIB_FILE_READ;
+    netbuf *nData = NULL;
+    if (!FtpAccess([self path:path relativeToConnection:conn], type, FTPLIB_BINARY, offset, conn, &nData)) {
+        NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
+        [self checkinConnection:conn reusable:false];
+        completion([NSError FTPKitErrorWithResponse:response]);
+        return NULL;
+    }
+    
+    NSProgress *progress = [[NSProgress alloc] init];
+    [progress setTotalUnitCount:fileSize];
+    [progress setCompletedUnitCount:offset];
+    // 일시정지 중인 읽기 작업을 깨운다
+    dispatch_semaphore_t wakeup = dispatch_semaphore_create(0);
+    [progress setResumingHandler:^{
+        dispatch_semaphore_signal(wakeup);
+    }];
+    [progress setCancellationHandler:^{
+        dispatch_semaphore_signal(wakeup);
+    }];
+    
+    // 일시정지 중에도 다른 작업을 막지 않도록 별도 큐에서 실행
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        char *dbuf = malloc(kFTPKitStreamChunkSize);
+        // 다음 조각의 파일 위치
+        long long int position = offset;
+        // 작업 강제 중지 여부
+        bool wasAborted = false;
+        int input = 0;
+        
+        while ((input = FtpRead(dbuf, kFTPKitStreamChunkSize, nData)) > 0) {
+            // 핸들러가 보관할 수 있도록 조각마다 복사해서 전달
+            NSData *chunk = [[NSData alloc] initWithBytes:dbuf length:input];
+            FTPStreamAction action = chunkHandler(chunk, position);
+            position += input;
+            [progress setCompletedUnitCount:position];
+            
+            if (action == FTPStreamStop) {
+                [progress cancel];
+            }
+            else if (action == FTPStreamPause) {
+                [progress pause];
+            }
+            // 일시정지 동안은 읽지 않으므로, 수신 창이 차면 서버도 전송을 멈춘다
+            while ([progress isPaused] == true &&
+                   [progress isCancelled] == false) {
+                dispatch_time_t timeout = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kFTPKitStreamPauseInterval * NSEC_PER_SEC));
+                if (dispatch_semaphore_wait(wakeup, timeout) != 0) {
+                    // 긴 일시정지 중에도 제어 접속이 끊기지 않도록 keepAliveInterval 간격으로 NOOP 전송
+                    FtpKeepAlive(conn);
+                }
+            }
+            if ([progress isCancelled] == true) {
+                wasAborted = true;
+                break;
+            }
+        }
+        free(dbuf);
+        
+        // 전송 도중 닫은 경우는 응답 순서를 보장할 수 없으므로 재사용하지 않는다
+        bool closed = FtpClose(nData) == 1;
+        [self checkinConnection:conn reusable:(wasAborted == false && closed == true)];
+        if (wasAborted == true) {
+            completion([NSError FTPKitErrorWithCode:FTP_Aborted]);
+        }
+        else if (closed == false) {
+            completion([NSError FTPKitErrorWithCode:FTP_FailedToReadByIncomplete]);
+        }
+        else {
+            completion(NULL);
+        }
+    });
+    return progress;
+}
+
+/**
+ 여러 파일을 정해진 수의 접속으로 나눠서 다운로드.
+ 
+ - 파일 목록을 작업자(접속)마다 나눠 두고, 자기 몫을 먼저 끝낸 작업자는 다른 작업자의 남은 파일을 가져와서 받는다.
+   큰 파일이나 느린 파일이 한 작업자에 몰려도 다른 접속이 쉬지 않는다
+ - 각 작업자는 접속 하나로 여러 파일을 이어서 받고, 다음 파일의 데이터 접속을 미리 열어 둔다
+ - 파일 하나가 실패해도 나머지 파일은 계속 받는다. 실패한 파일의 저장 파일은 제거된다
+ - 반환된 NSProgress 는 처리한 파일 수를 나타내며, 이를 이용해 작업 취소 가능
+
+ @param files 원격 경로를 키로, 저장할 경로를 값으로 하는 사전
+ @param sessions 동시에 사용할 최대 접속 수
+ @param itemCompletion 파일마다 호출되는 완료 핸들러. 실패시 error 반환. 여러 작업자에서 동시에 호출될 수 있다
+ @param completion 모든 파일을 처리한 뒤 호출되는 완료 핸들러. 실패한 파일 수 반환. 취소시 FTP_Aborted 에러 반환
+ @return NSProgress 반환
+ */
+- (NSProgress * _Nonnull)downloadFiles:(NSDictionary<NSString *, NSString *> * _Nonnull)files
+                              sessions:(NSInteger)sessions
+                        itemCompletion:(void (^ _Nullable)(NSString * _Nonnull remotePath,
+                                                           NSError * _Nullable error))itemCompletion
+                            completion:(void (^ _Nonnull)(NSInteger failedCount,
+                                                          NSError * _Nullable error))completion {
+    NSProgress *progress = [[NSProgress alloc] init];
+    [progress setTotalUnitCount:[files count]];
+    if ([files count] == 0) {
+        completion(0, NULL);
+        return progress;
+    }
+    
+    // 파일을 작업자 목록에 번갈아 나눠 둔다
+    NSUInteger workers = (NSUInteger)MIN(MAX(sessions, 1), (NSInteger)[files count]);
+    NSMutableArray<NSMutableArray<NSArray<NSString *> *> *> *queues = [[NSMutableArray alloc] init];
+    for (NSUInteger i = 0; i < workers; i++) {
+        [queues addObject:[[NSMutableArray alloc] init]];
+    }
+    __block NSUInteger index = 0;
+    [files enumerateKeysAndObjectsUsingBlock:^(NSString *remotePath, NSString *savePath, BOOL *stop) {
+        [queues[index % workers] addObject:@[remotePath, savePath]];
+        index++;
+    }];
+    
+    FTPBatchDownload *batch = [[FTPBatchDownload alloc] init];
+    batch.queues = queues;
+    batch.progress = progress;
+    batch.group = dispatch_group_create();
+    for (NSUInteger i = 0; i < workers; i++) {
+        dispatch_group_enter(batch.group);
+        [self scheduleWithPriority:self.transferPriority block:^{
+            [self runBatchWorker:batch index:i itemCompletion:itemCompletion];
+            dispatch_group_leave(batch.group);
+        }];
+    }
+    dispatch_group_notify(batch.group, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        NSInteger failedCount = 0;
+        @synchronized (batch) {
+            failedCount = batch.failedCount;
+        }
+        completion(failedCount, [progress isCancelled] == true ? [NSError FTPKitErrorWithCode:FTP_Aborted] : NULL);
+    });
+    return progress;
+}
+
+/**
+ FTP 디렉토리 아래 전체를 여러 접속으로 동시에 탐색.
+ 
+ - 접속마다 작업자가 하나씩 디렉토리 목록을 가져오며, 각 디렉토리의 목록을 받는 대로 entryHandler 로 전달한다
+ - 하위 디렉토리는 깊이 우선으로 탐색하고, 공유 대기 목록의 크기를 제한해서 넓은 트리에서도 대기 목록이 크게 늘지 않는다
+ - 목록을 가져오지 못한 디렉토리는 error 와 함께 전달되며, 나머지 디렉토리는 계속 탐색한다
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param remotePath 탐색을 시작할 FTP 디렉토리 경로
+ @param sessions 동시에 사용할 최대 접속 수
+ @param maximumDepth 최대 탐색 깊이. 0 이면 시작 디렉토리만 가져온다. 0 보다 작으면 제한하지 않는다
+ @param showHiddenFiles 감춤 파일 포함 여부
+ @param filter 항목 선택 조건. 상위 디렉토리 경로, 항목, 항목의 깊이(시작 디렉토리의 항목이 1)를 전달받는다.
+        NO 를 반환한 항목은 전달하지 않고, 디렉토리인 경우 들어가지도 않는다. nil 이면 모든 항목을 선택한다
+ @param entryHandler 디렉토리 목록 핸들러. 디렉토리 경로와 선택된 항목을 전달받는다. 실패시 items 는 nil 이고 error 가 전달된다.
+        여러 작업자에서 동시에 호출될 수 있다
+ @param completion 완료 핸들러. 시작 디렉토리 목록을 가져오지 못했거나 취소된 경우 error 반환
+ @return NSProgress 반환
+ */
+- (NSProgress * _Nonnull)walkDirectoryAtPath:(NSString * _Nonnull)remotePath
+                                    sessions:(NSInteger)sessions
+                                maximumDepth:(NSInteger)maximumDepth
+                             showHiddenFiles:(BOOL)showHiddenFiles
+                                      filter:(BOOL (^ _Nullable)(NSString * _Nonnull parentPath,
+                                                                 FTPItem * _Nonnull item,
+                                                                 NSInteger depth))filter
+                                entryHandler:(void (^ _Nonnull)(NSString * _Nonnull path,
+                                                                NSArray<FTPItem *> * _Nullable items,
+                                                                NSError * _Nullable error))entryHandler
+                                  completion:(void (^ _Nonnull)(NSError * _Nullable error))completion {
+    NSInteger depthLimit = maximumDepth < 0 ? kFTPKitTraversalMaximumDepth : maximumDepth;
+    __block NSError *rootError = NULL;
+    return [self walkDirectoryAtPath:remotePath
+                            sessions:sessions
+                        maximumDepth:depthLimit
+                     showHiddenFiles:showHiddenFiles
+                    directoryHandler:^NSArray<FTPItem *> *(NSString *path, NSInteger depth, NSArray<FTPItem *> *items, NSError *error) {
+        if (error != NULL) {
+            if (depth == 0) {
+                rootError = error;
+            }
+            entryHandler(path, nil, error);
+            return nil;
+        }
+        NSMutableArray<FTPItem *> *selected = [[NSMutableArray alloc] init];
+        for (FTPItem *item in items) {
+            if (filter == nil ||
+                filter(path, item, depth + 1) == true) {
+                [selected addObject:item];
+            }
+        }
+        entryHandler(path, selected, NULL);
+        return selected;
+    } completion:^(BOOL cancelled) {
+        if (rootError != NULL) {
+            completion(rootError);
+        }
+        else if (cancelled == true) {
+            completion([NSError FTPKitErrorWithCode:FTP_Aborted]);
+        }
+        else {
+            completion(NULL);
+        }
+    }];
+}
+
+/**
+ FTP 디렉토리 아래 전체를 로컬 디렉토리로 미러링.
+ 
+ - 여러 접속으로 원격 디렉토리 목록을 동시에 가져오며 하위 디렉토리까지 모두 탐색한다
+ - 크기와 수정일이 같은 로컬 파일은 건너뛰고, 새로 생기거나 바뀐 파일만 downloadFiles:sessions:itemCompletion:completion: 으로 받는다
+ - 받은 파일은 같은 디렉토리의 임시 파일에 저장한 뒤 rename 으로 바꿔 넣고, 수정일을 원격 파일에 맞춘다.
+   중간에 실패하거나 취소되어도 기존 파일은 그대로 남는다
+ - deletesExtraneousFiles 가 YES 인 경우, 원격에 없는 로컬 파일/디렉토리를 제거한다.
+   목록을 가져오지 못한 디렉토리는 제거하지 않는다
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param remotePath 미러링할 FTP 디렉토리 경로
+ @param localPath 저장할 로컬 디렉토리 경로. 없는 경우 생성한다
+ @param sessions 동시에 사용할 최대 접속 수
+ @param deletesExtraneousFiles 원격에 없는 로컬 항목 제거 여부
+ @param completion 완료 핸들러. 처리 결과 요약 반환. 시작 디렉토리 목록을 가져오지 못했거나 취소된 경우 error 반환
+ @return NSProgress 반환
+ */
+- (NSProgress * _Nonnull)mirrorDirectory:(NSString * _Nonnull)remotePath
+                        toLocalDirectory:(NSString * _Nonnull)localPath
+                                sessions:(NSInteger)sessions
+                  deletesExtraneousFiles:(BOOL)deletesExtraneousFiles
+                              completion:(void (^ _Nonnull)(FTPMirrorSummary * _Nonnull summary,
+                                                            NSError * _Nullable error))completion {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    FTPMirror *mirror = [[FTPMirror alloc] init];
+    mirror.summary = [[FTPMirrorSummary alloc] init];
+    mirror.downloads = [[NSMutableDictionary alloc] init];
+    mirror.targets = [[NSMutableDictionary alloc] init];
+    mirror.listedDirectories = [[NSMutableDictionary alloc] init];
+    
+    // 탐색과 다운로드를 하나의 진행 상태로 묶는다. 취소하면 둘 다 취소된다
+    NSProgress *progress = [[NSProgress alloc] init];
+    [progress setTotalUnitCount:2];
+    if ([fileManager createDirectoryAtPath:localPath withIntermediateDirectories:YES attributes:nil error:NULL] == false) {
+        completion(mirror.summary, [NSError FTPKitErrorWithCode:FTP_FailedToSaveToLocal]);
+        return progress;
+    }
+    
+    NSProgress *walkProgress = [self walkDirectoryAtPath:remotePath
+                                                sessions:sessions
+                                            maximumDepth:kFTPKitTraversalMaximumDepth
+                                         showHiddenFiles:YES
+                                        directoryHandler:^NSArray<FTPItem *> *(NSString *path, NSInteger depth, NSArray<FTPItem *> *items, NSError *error) {
+        NSString *relativePath = [path length] > [remotePath length] ? [path substringFromIndex:[remotePath length]] : @"";
+        NSString *directory = [localPath stringByAppendingPathComponent:relativePath];
+        if (error != NULL) {
+            @synchronized (mirror) {
+                if (depth == 0) {
+                    mirror.error = error;
+                }
+                mirror.summary.failedCount++;
+            }
+            return nil;
+        }
+        return [self mirrorItems:items
+                     remotePath:path
+                 localDirectory:directory
+                         mirror:mirror
+         deletesExtraneousFiles:deletesExtraneousFiles];
+    } completion:^(BOOL cancelled) {
+        if (mirror.error != NULL ||
+            cancelled == true) {
+            completion(mirror.summary, mirror.error != NULL ? mirror.error : [NSError FTPKitErrorWithCode:FTP_Aborted]);
+            return;
+        }
+        NSDictionary<NSString *, NSString *> *downloads = nil;
+        @synchronized (mirror) {
+            downloads = [mirror.downloads copy];
+        }
+        NSProgress *downloadProgress = [self downloadFiles:downloads
+                                                  sessions:sessions
+                                            itemCompletion:^(NSString *remoteFile, NSError *error) {
+            [self finishMirrorDownload:remoteFile mirror:mirror error:error];
+        } completion:^(NSInteger failedCount, NSError *error) {
+            if (deletesExtraneousFiles == true &&
+                error == NULL) {
+                [self deleteExtraneousItemsForMirror:mirror];
+            }
+            completion(mirror.summary, error);
+        }];
+        [progress addChild:downloadProgress withPendingUnitCount:1];
+    }];
+    [progress addChild:walkProgress withPendingUnitCount:1];
+    return progress;
+}
+
+/**
+ 로컬 파일을 지정된 FTP 디렉토리로 업로드.
+ 
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param localPath 업로드할 로컬 파일 경로.
+ @param remoteDirectory 업로드할 FTP 디렉토리 경로.
+ @param completion 완료 핸들러. 실패시 error 반환.
+ @return NSProgress 반환. 로컬 파일이 없거나 크기가 0 인 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
+ */
+- (NSProgress * _Nullable)uploadFileFrom:(NSString * _Nonnull)localPath
+                             toDirectory:(NSString * _Nonnull)remoteDirectory
+                              completion:(void (^ _Nonnull)(NSError * _Nullable error))completion {
+    NSString *targetPath = [remoteDirectory stringByAppendingPathComponent:[localPath lastPathComponent]];
+    return [self uploadFileFrom:localPath to:targetPath completion:completion];
+}
+/**
+ 로컬 파일을 지정된 FTP 경로로 업로드.
+ 
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param localPath 업로드할 로컬 파일 경로.
+ @param remotePath 업로드할 FTP 경로.
+ @param completion 완료 핸들러. 실패시 error 반환.
+ @return NSProgress 반환. 로컬 파일이 없거나 크기가 0 인 경우 NULL 반환. 접속 및 전송 실패는 완료 핸들러로 반환
+ */
+- (NSProgress * _Nullable)uploadFileFrom:(NSString * _Nonnull)localPath
+                                      to:(NSString * _Nonnull)remotePath
+                              completion:(void (^ _Nonnull)(NSError * _Nullable error))completion {
+    if ([[NSFileManager defaultManager] fileExistsAtPath:localPath] == false) {
+        // 파일 열기 실패
+        completion([NSError FTPKitErrorWithCode:FTP_FailedToOpenFile]);
+        return NULL;
+    }
+    
+    long long int fileSize = [localPath fileSize];
+    if (fileSize == 0) {
+        completion([NSError FTPKitErrorWithCode:FTP_ZeroFileSize]);
+        return NULL;
+    }
+    
+    NSProgress *progress = [[NSProgress alloc] init];
+    [progress setTotalUnitCount:fileSize];
+    // 접속 대여와 전송 모두 스케줄러의 작업자에서 실행
+    [self scheduleTransfer:progress priority:self.transferPriority block:^{
+        // 대기 중에 취소된 경우
+        if ([progress isCancelled] == true) {
+            completion([NSError FTPKitErrorWithCode:FTP_Aborted]);
+            return;
+        }
+        const char *toSavePath = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
+        NSError *connectionError = NULL;
+        netbuf *conn = [self checkoutConnectionForPath:toSavePath error:&connectionError];
+        if (conn == NULL) {
+            // 에러 반환 처리
+            completion(connectionError);
+            return;
+        }
+        
+        const char *fromLocalPath = [[localPath urlEncodedString] cStringUsingEncoding:NSUTF8StringEncoding];
+        long long int sentLength = 0;
+        NSError *error = [self ftpXferWriteFrom:fromLocalPath
+                                           size:fileSize
+                                         offset:0
+                                         toPath:[self path:toSavePath relativeToConnection:conn]
+                                        control:conn
+                                           type:FTPLIB_FILE_WRITE
+                                           mode:FTPLIB_BINARY
+                                       progress:progress
+                                     sentLength:&sentLength];
+        completion(error);
+        [self checkinConnection:conn reusable:(error == NULL)];
+    }];
+    return progress;
+}
+
+/**
+ 로컬 파일을 지정된 FTP 경로로 이어서 업로드.
+ 
+ - 서버에 있는 파일 크기를 확인해서 그 위치부터 REST + STOR 로 이어 올린다
+ - 서버가 REST 를 거부하면 APPE 로 이어 올린다
+ - 서버에 파일이 없으면 처음부터, 서버 파일이 더 크면 다른 파일로 보고 처음부터 올린다
+ - 반환된 NSProgress를 이용해 작업 취소 가능. 진행 상태는 이미 올라간 길이부터 시작한다
+
+ @param localPath 업로드할 로컬 파일 경로.
+ @param remotePath 업로드할 FTP 경로. 정확한 디렉토리 + 파일명까지 기재한다
+ @param completion 완료 핸들러. 이번 업로드에서 실제로 보낸 길이 반환. 실패시 error 반환.
+ @return NSProgress 반환. 로컬 파일이 없거나 크기가 0 인 경우 NULL 반환. 이미 모두 올라가 있는 경우와 접속 및 전송 실패는 완료 핸들러로 반환
+ */
+- (NSProgress * _Nullable)resumeUploadFileFrom:(NSString * _Nonnull)localPath
+                                            to:(NSString * _Nonnull)remotePath
+                                    completion:(void (^ _Nonnull)(long long int sentLength,
+                                                                  NSError * _Nullable error))completion {
+    if ([[NSFileManager defaultManager] fileExistsAtPath:localPath] == false) {
+        // 파일 열기 실패
+        completion(0, [NSError FTPKitErrorWithCode:FTP_FailedToOpenFile]);
+        return NULL;
+    }
+    
+    long long int fileSize = [localPath fileSize];
+    if (fileSize == 0) {
+        completion(0, [NSError FTPKitErrorWithCode:FTP_ZeroFileSize]);
+        return NULL;
+    }
+    
+    NSProgress *progress = [[NSProgress alloc] init];
+    [progress setTotalUnitCount:fileSize];
+    // 접속 대여와 전송 모두 스케줄러의 작업자에서 실행
+    [self scheduleTransfer:progress priority:self.transferPriority block:^{
+        // 대기 중에 취소된 경우
+        if ([progress isCancelled] == true) {
+            completion(0, [NSError FTPKitErrorWithCode:FTP_Aborted]);
+            return;
+        }
+        const char *toSavePath = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
+        NSError *connectionError = NULL;
+        netbuf *conn = [self checkoutConnectionForPath:toSavePath error:&connectionError];
+        if (conn == NULL) {
+            // 에러 반환 처리
+            completion(0, connectionError);
+            return;
+        }
+        
+        // 서버에 이미 올라간 길이. 파일이 없으면 -1
+        long long int offset = [self sizeAt:toSavePath control:conn];
+        if (offset == fileSize) {
+            // 이미 모두 올라가 있는 경우
+            [progress setCompletedUnitCount:fileSize];
+            [self checkinConnection:conn reusable:true];
+            completion(0, NULL);
+            return;
+        }
+        if (offset < 0 ||
+            offset > fileSize) {
+            offset = 0;
+        }
+        
+        const char *fromLocalPath = [[localPath urlEncodedString] cStringUsingEncoding:NSUTF8StringEncoding];
+        const char *path = [self path:toSavePath relativeToConnection:conn];
+        int type = offset > 0 ? FTPLIB_FILE_WRITE_OFFSET : FTPLIB_FILE_WRITE;
+        long long int sentLength = 0;
+        NSError *error = [self ftpXferWriteFrom:fromLocalPath
+                                           size:fileSize
+                                         offset:offset
+                                         toPath:path
+                                        control:conn
+                                           type:type
+                                           mode:FTPLIB_BINARY
+                                       progress:progress
+                                     sentLength:&sentLength];
+        // REST 를 지원하지 않는 서버는 APPE 로 이어 올린다
+        if (sentLength < 0 &&
+            type == FTPLIB_FILE_WRITE_OFFSET &&
+            FtpLastResponse(conn)[0] == '5') {
+            FKLogDebug(@"REST STOR rejected, fallback to APPE: %s", FtpLastResponse(conn));
+            error = [self ftpXferWriteFrom:fromLocalPath
+                                      size:fileSize
+                                    offset:offset
+                                    toPath:path
+                                   control:conn
+                                      type:FTPLIB_FILE_APPEND
+                                      mode:FTPLIB_BINARY
+                                  progress:progress
+                                sentLength:&sentLength];
+        }
+        completion(MAX(sentLength, 0), error);
+        [self checkinConnection:conn reusable:(error == NULL)];
+    }];
+    return progress;
+}
+
+/**
+ 계속 늘어나기만 하는 로컬 파일(로그, 저널 등)의 늘어난 부분만 서버 파일 뒤에 덧붙여 업로드.
+ 
+ - 서버 파일 크기를 확인해서 그 이후 부분만 APPE 로 보낸다
+ - overlapLength 가 지정된 경우, 서버 파일 끝의 해당 길이를 받아서 로컬 파일의 같은 위치와 비교한다
+ - 서버 파일이 더 크거나 겹치는 부분이 다르면 로컬 파일이 잘렸거나 새로 쓰인 것으로 보고 처음부터 올린다
+ - 서버에 파일이 없으면 처음부터 올린다
+ - 반환된 NSProgress를 이용해 작업 취소 가능
+
+ @param localPath 업로드할 로컬 파일 경로.
+ @param remotePath 업로드할 FTP 경로. 정확한 디렉토리 + 파일명까지 기재한다
+ @param overlapLength 비교할 서버 파일 끝 부분 길이. 비교하지 않는 경우 0 지정
+ @param completion 완료 핸들러. 이번 업로드에서 실제로 보낸 길이 반환. 실패시 error 반환.
+ @return NSProgress 반환. 로컬 파일이 없는 경우 NULL 반환. 보낼 부분이 없는 경우와 접속 및 전송 실패는 완료 핸들러로 반환
+ */
+- (NSProgress * _Nullable)syncAppendFileFrom:(NSString * _Nonnull)localPath
+                                          to:(NSString * _Nonnull)remotePath
+                               overlapLength:(long long int)overlapLength
+                                  completion:(void (^ _Nonnull)(long long int sentLength,
+                                                                NSError * _Nullable error))completion {
+    if ([[NSFileManager defaultManager] fileExistsAtPath:localPath] == false) {
+        // 파일 열기 실패
+        completion(0, [NSError FTPKitErrorWithCode:FTP_FailedToOpenFile]);
+        return NULL;
+    }
+    
+    long long int fileSize = [localPath fileSize];
+    NSProgress *progress = [[NSProgress alloc] init];
+    [progress setTotalUnitCount:fileSize];
+    // 접속 대여와 전송 모두 스케줄러의 작업자에서 실행
+    [self scheduleTransfer:progress priority:self.transferPriority block:^{
+        // 대기 중에 취소된 경우
+        if ([progress isCancelled] == true) {
+            completion(0, [NSError FTPKitErrorWithCode:FTP_Aborted]);
+            return;
+        }
+        const char *toSavePath = [[remotePath urlEncodedString] cStringUsingEncoding:self.encoding];
+        NSError *connectionError = NULL;
+        netbuf *conn = [self checkoutConnectionForPath:toSavePath error:&connectionError];
+        if (conn == NULL) {
+            // 에러 반환 처리
+            completion(0, connectionError);
+            return;
+        }
+        
+        const char *fromLocalPath = [[localPath urlEncodedString] cStringUsingEncoding:NSUTF8StringEncoding];
+        // 서버에 이미 올라간 길이. 파일이 없으면 -1
+        long long int offset = [self sizeAt:toSavePath control:conn];
+        if (offset > fileSize) {
+            FKLogDebug(@"Remote file is larger than local, upload from start: %@", remotePath);
+            offset = 0;
+        }
+        else if (offset > 0 &&
+                 overlapLength > 0) {
+            int match = [self remoteTail:toSavePath
+                                    size:offset
+                                  length:MIN(overlapLength, offset)
+                          matchesLocalFile:fromLocalPath
+                                 control:conn];
+            if (match < 0) {
+                NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:self.encoding];
+                [self checkinConnection:conn reusable:false];
+                completion(0, [NSError FTPKitErrorWithResponse:response]);
+                return;
+            }
+            if (match == 0) {
+                FKLogDebug(@"Remote tail differs from local, upload from start: %@", remotePath);
+                offset = 0;
+            }
+        }
+        if (offset == fileSize) {
+            // 보낼 부분이 없는 경우
+            [progress setCompletedUnitCount:fileSize];
+            [self checkinConnection:conn reusable:true];
+            completion(0, NULL);
+            return;
+        }
+        if (offset < 0) {
+            offset = 0;
+        }
+        
+        long long int sentLength = 0;
+        NSError *error = [self ftpXferWriteFrom:fromLocalPath
+                                           size:fileSize
+                                         offset:offset
+                                         toPath:[self path:toSavePath relativeToConnection:conn]
+                                        control:conn
+                                           type:offset > 0 ? FTPLIB_FILE_APPEND : FTPLIB_FILE_WRITE
+                                           mode:FTPLIB_BINARY
+                                       progress:progress
+                                     sentLength:&sentLength];
+        completion(MAX(sentLength, 0), error);
+        [self checkinConnection:conn reusable:(error == NULL)];
+    }];
+    return progress;
+}
+
+/**
+ 서버의 remotePath 위치에 디렉토리 생성
+ 
+ @returns 성공시 NULL 반환. 실패시 에러 반환
+ */
+- (NSError * _Nullable)createDirectoryAtPath:(NSString * _Nonnull)remotePath {
+    NSError *error = NULL;
+    netbuf *conn = [self checkoutConnection:&error];
+    if (conn == NULL) {
+        // 에러 반환
+        return error;
+    }
+    const char *path = [remotePath cStringUsingEncoding:_encoding];
+    int stat = FtpMkdir(path, conn);
+    NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
+    [self checkinConnection:conn reusable:true];
+    if (stat == 0) {
+        return [NSError FTPKitErrorWithResponse:response];
+    }
+    return NULL;
+}
+/**
+ 백그라운드로 서버의 remotePath 위치에 디렉토리 생성
+ 
+ @param completion 완료 핸들러. 성공시 NULL 반환. 실패시 에러 반환
+ */
+- (void)createDirectoryAtPath:(NSString *)remotePath
+                   completion:(void (^)(NSError *))completion {
+    [self scheduleWithPriority:FTPPriorityInteractive block:^{
+        completion([self createDirectoryAtPath:remotePath]);
+    }];
+}
+
+- (NSError *)deleteDirectoryAtPath:(NSString *)remotePath {
+    return [self deleteItemAtPath:remotePath isFile:false];
+}
+
+- (void)deleteDirectoryAtPath:(NSString *)remotePath completion:(void (^)(NSError *))completion {
+    [self deleteItemAtPath:remotePath isFile:false completion:completion];
+}
+
+- (NSError *)deleteFileAtPath:(NSString *)remotePath {
+    return [self deleteItemAtPath:remotePath isFile:true];
+}
+
+- (void)deleteFileAtPath:(NSString *)remotePath completion:(void (^)(NSError *))completion {
+    [self deleteItemAtPath:remotePath isFile:true completion:completion];
+}
+
+/**
+ 실제 제거 작업 실행 메쏘드
+ 
+ @param remotePath 제거할 아이템 경로
+ @param isFile true 인 경우는 파일, false 는 디렉토리 제거로 판정
+ @returns 제거 성공시 NULL 반환. 실패시 에러 반환
+ */
+- (NSError * _Nullable)deleteItemAtPath:(NSString * _Nonnull)remotePath
+                                 isFile:(BOOL)isFile {
+    const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:_encoding];
+    NSError *error = NULL;
+    netbuf *conn = [self checkoutConnectionForPath:path error:&error];
+    if (conn == NULL) {
+        return error;
+    }
+    path = [self path:path relativeToConnection:conn];
+    int stat = 0;
+    // 파일인 경우
+    if (isFile) {
+        stat = FtpDelete(path, conn);
+    }
+    // 디렉토리인 경우
+    else {
+        stat = FtpRmdir(path, conn);
+    }
+    NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
+    [self checkinConnection:conn reusable:true];
+    if (stat == 0) {
+        return [NSError FTPKitErrorWithResponse:response];
+    }
+    return NULL;
+}
+/**
+ 실제 제거 작업 백그라운드 실행 메쏘드
+ 
+ @param remotePath 제거할 아이템 경로
+ @param isFile true 인 경우는 파일, false 는 디렉토리 제거로 판정
+ @param completion 완료 핸들러. 실패시 에러 반환
+ */
+- (void)deleteItemAtPath:(NSString * _Nonnull)remotePath
+                  isFile:(BOOL)isFile
+              completion:(void (^ _Nonnull)(NSError * _Nullable))completion {
+    [self scheduleWithPriority:FTPPriorityInteractive block:^{
+        completion([self deleteItemAtPath:remotePath isFile:isFile]);
+    }];
+}
+
+- (NSError *)chmodPath:(NSString *)remotePath toMode:(int)mode {
+    if (mode < 0 || mode > 777) {
+        NSDictionary *userInfo = [NSDictionary dictionaryWithObject:NSLocalizedString(@"File mode value must be between 0 and 0777.", @"")
+                                                             forKey:NSLocalizedDescriptionKey];
+        return [[NSError alloc] initWithDomain:FTPErrorDomain code:0 userInfo:userInfo];
+    }
+    
+    NSString *command = [NSString stringWithFormat:@"SITE CHMOD %i %@", mode, [remotePath urlEncodedString]];
+    NSError *error = NULL;
+    netbuf *conn = [self checkoutConnection:&error];
+    if (conn == NULL) {
+        // 연결 실패시 에러 반환
+        return error;
+    }
+    
+    error = [self sendCommand:command conn:conn];
+    [self checkinConnection:conn reusable:true];
+    if (error != NULL) {
+        return error;
+    }
+    return NULL;
+}
+
+- (void)chmodPath:(NSString *)remotePath toMode:(int)mode
+       completion:(void (^)(NSError *))completion {
+    [self scheduleWithPriority:FTPPriorityInteractive block:^{
+        completion([self chmodPath:remotePath toMode:mode]);
+    }];
+}
+
+- (NSError *)renamePath:(NSString *)sourcePath
+                     to:(NSString *)destPath {
+    NSError *error = NULL;
+    netbuf *conn = [self checkoutConnection:&error];
+    if (conn == NULL) {
+        // 에러 반환
+        return error;
+    }
+
+    const char *src = [[sourcePath urlEncodedString] cStringUsingEncoding:_encoding];
+    // @note The destination path does not need to be URL encoded. In fact, if
+    // it is, the filename will include the percent escaping!
+    const char *dst = [destPath cStringUsingEncoding:_encoding];
+    int stat = FtpRename(src, dst, conn);
+    NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
+    [self checkinConnection:conn reusable:true];
+    if (stat == 0) {
+        return [NSError FTPKitErrorWithResponse:response];
+    }
+    return NULL;
+}
+
+- (void)renamePath:(NSString *)sourcePath to:(NSString *)destPath
+        completion:(void (^)(NSError *))completion {
+    [self scheduleWithPriority:FTPPriorityInteractive block:^{
+        completion([self renamePath:sourcePath to:destPath]);
+    }];
+}
+
+/** Private Methods */
+
+/**
+ 분할 다운로드 작업자를 추가. @synchronized(download) 안에서 호출해야 한다
+ 
+ @return 할당할 구간이 없는 경우 false
+ */
+- (BOOL)startSegmentWorker:(FTPSegmentedDownload * _Nonnull)download {
+    FTPSegment *segment = [download nextSegment];
+    if (segment == nil) {
+        return false;
+    }
+    download.workers++;
+    dispatch_group_async(download.group, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [self runSegmentWorker:download segment:segment];
+    });
+    return true;
+}
+
+/**
+ 분할 다운로드 작업자. 구간을 받고, 남은 구간이 없을 때까지 다음 구간을 이어서 받는다
+ 
+ - 파일 끝까지 받은 구간은 226 응답으로 정상 종료되므로 같은 접속으로 다음 구간을 받는다
+ - 중간에서 끝나는 구간은 데이터 접속을 닫아 중지하므로 접속을 재사용하지 않는다
+ - 전송 실패시 남은 재접속 횟수 안에서 새 접속으로 같은 구간을 이어 받는다
+ 
+ @param download 분할 다운로드 공유 상태
+ @param segment 처음 받을 구간
+ */
+- (void)runSegmentWorker:(FTPSegmentedDownload * _Nonnull)download segment:(FTPSegment * _Nullable)segment {
+    char *dbuf = malloc(FTPLIB_BUFSIZ);
+    netbuf *conn = NULL;
+    
+    while (segment != nil &&
+           [download.progress isCancelled] == false) {
+        NSError *error = NULL;
+        // 구간을 모두 받았는지 여부
+        bool finished = false;
+        // 전송 후에도 응답 순서가 맞는 접속인지 여부
+        bool reusable = false;
+        
+        if (conn == NULL) {
+            conn = [self checkoutConnectionForPath:download.path error:&error];
+        }
+        if (conn != NULL) {
+            long long int start = 0;
+            @synchronized (download) {
+                start = segment.position;
+            }
+            int type = start > 0 ? FTPLIB_FILE_READ_OFFSET : FTPLIB_FILE_READ;
+            netbuf *nData = NULL;
+            if (!FtpAccess([self path:download.path relativeToConnection:conn], type, FTPLIB_BINARY, start, conn, &nData)) {
+                NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
+                error = [NSError FTPKitErrorWithResponse:response];
+            }
+            else {
+                int input = 0;
+                for (;;) {
+                    long long int offset = 0;
+                    long long int length = 0;
+                    // 읽기 전에 위치를 먼저 옮겨서, 다른 작업자가 쓰는 중인 범위를 나눠 가지 않게 한다
+                    @synchronized (download) {
+                        offset = segment.position;
+                        length = MIN((long long int)kFTPKitReadChunkSize, segment.end - segment.position);
+                        segment.position += length;
+                    }
+                    if (length > 0) {
+                        // 소켓에서 파일로 바로 저장한다
+                        input = FtpReadFd(download.fd, offset, (int)length, nData);
+                        @synchronized (download) {
+                            // 받지 못한 만큼 위치를 되돌린다
+                            segment.position = offset + MAX(input, 0);
+                        }
+                        length = MAX(input, 0);
+                    }
+                    else {
+                        // 파일 끝 구간을 모두 받은 뒤에는 서버가 데이터 접속을 닫을 때까지 읽고 버린다
+                        input = FtpRead(dbuf, FTPLIB_BUFSIZ, nData);
+                    }
+                    if (input == 0) {
+                        break;
+                    }
+                    if (input < 0) {
+                        @synchronized (download) {
+                            if (download.error == NULL) {
+                                download.error = [NSError FTPKitErrorWithCode:FTP_FailedToSaveToLocal];
+                            }
+                        }
+                        // 로컬 저장 실패는 재시도해도 같으므로 전체 작업을 중지
+                        [download.progress cancel];
+                        break;
+                    }
+                    bool tail = false;
+                    NSArray<NSArray<NSNumber *> *> *writtenRanges = nil;
+                    @synchronized (download) {
+                        segment.written = offset + length;
+                        download.progress.completedUnitCount += length;
+                        finished = segment.position >= segment.end;
+                        tail = segment.end >= download.fileSize;
+                        if ([download shouldAddWorker]) {
+                            [self startSegmentWorker:download];
+                        }
+                        // 일정 길이마다 저널 기록. 한 번에 하나의 작업자만 기록한다
+                        if (download.journal != nil &&
+                            download.journaling == false &&
+                            download.progress.completedUnitCount - download.journalBytes >= kFTPKitJournalInterval) {
+                            download.journaling = true;
+                            download.journalBytes = download.progress.completedUnitCount;
+                            writtenRanges = [download writtenRanges];
+                        }
+                    }
+                    if (writtenRanges != nil) {
+                        // fsync 는 오래 걸릴 수 있으므로 잠금 밖에서 실행
+                        [download.journal commitRanges:writtenRanges fileDescriptor:download.fd];
+                        @synchronized (download) {
+                            download.journaling = false;
+                        }
+                    }
+                    if ([download.progress isCancelled] == true) {
+                        break;
+                    }
+                    // 파일 끝 구간은 서버가 데이터 접속을 닫을 때까지 읽는다
+                    if (finished == true &&
+                        tail == false) {
+                        break;
+                    }
+                }
+                if (input == 0 &&
+                    finished == true) {
+                    reusable = FtpClose(nData) == 1;
+                }
+                else {
+                    FtpClose(nData);
+                    if (input < 0 ||
+                        (input == 0 && finished == false)) {
+                        error = [NSError FTPKitErrorWithCode:FTP_FailedToReadByIncomplete];
+                    }
+                }
+            }
+        }
+        
+        if (conn != NULL &&
+            reusable == false) {
+            [self checkinConnection:conn reusable:false];
+            conn = NULL;
+        }
+        
+        @synchronized (download) {
+            if (finished == true) {
+                segment = [download nextSegment];
+            }
+            else if (error != NULL &&
+                     download.retries > 0) {
+                // 새 접속으로 같은 구간을 이어 받는다
+                FKLogDebug(@"Retry segment at %lld: %@", segment.position, error);
+                download.retries--;
+            }
+            else {
+                // 다른 작업자가 이어 받을 수 있도록 구간을 놓는다
+                segment.active = false;
+                segment = nil;
+                if (error != NULL &&
+                    download.error == NULL &&
+                    download.workers <= 1) {
+                    download.error = error;
+                }
+            }
+        }
+    }
+    
+    if (conn != NULL) {
+        [self checkinConnection:conn reusable:true];
+    }
+    if (segment != nil) {
+        @synchronized (download) {
+            segment.active = false;
+        }
+    }
+    @synchronized (download) {
+        download.workers--;
+    }
+    free(dbuf);
+}
+
+/**
+ 일괄 다운로드 작업자. 남은 파일이 없을 때까지 접속 하나로 이어서 받는다
+ 
+ @param batch 일괄 다운로드 공유 상태
+ @param worker 작업자 번호
+ @param itemCompletion 파일마다 호출하는 완료 핸들러
+ */
+- (void)runBatchWorker:(FTPBatchDownload * _Nonnull)batch
+                 index:(NSUInteger)worker
+        itemCompletion:(void (^ _Nullable)(NSString * _Nonnull remotePath, NSError * _Nullable error))itemCompletion {
+    netbuf *conn = NULL;
+    NSArray<NSString *> *item = nil;
+    
+    while ([batch.progress isCancelled] == false &&
+           (item = [batch nextItemForWorker:worker]) != nil) {
+        NSError *error = NULL;
+        const char *path = [[item[0] urlEncodedString] cStringUsingEncoding:_encoding];
+        if (path == NULL) {
+            error = [NSError FTPKitErrorWithCode:FTP_FailedToOpenFile];
+        }
+        else {
+            if (conn == NULL) {
+                conn = [self checkoutConnection:&error];
+                // 파일마다 데이터 접속을 기다리지 않도록 다음 데이터 접속을 미리 연다
+                if (conn != NULL) {
+                    FtpOptions(FTPLIB_PREOPEN, 1, conn);
+                }
+            }
+            if (conn != NULL) {
+                BOOL reusable = true;
+                error = [self batchDownloadFile:path
+                                     toSavePath:item[1]
+                                        control:conn
+                                       progress:batch.progress
+                                       reusable:&reusable];
+                if (reusable == false) {
+                    [self checkinConnection:conn reusable:false];
+                    conn = NULL;
+                }
+            }
+        }
+        if (error != NULL) {
+            @synchronized (batch) {
+                batch.failedCount++;
+            }
+        }
+        if (itemCompletion != nil) {
+            itemCompletion(item[0], error);
+        }
+        @synchronized (batch) {
+            batch.progress.completedUnitCount++;
+        }
+    }
+    
+    if (conn != NULL) {
+        [self checkinConnection:conn reusable:true];
+    }
+}
+
+/**
+ 일괄 다운로드의 파일 하나를 받는다
+ 
+ @param path 서버 인코딩으로 변환된 원격 경로
+ @param savePath 저장 경로
+ @param conn 제어 접속
+ @param progress 일괄 다운로드 진행 상태. 취소 여부 확인용
+ @param reusable 전송 후 응답 순서가 맞지 않아 접속을 재사용할 수 없는 경우 false 로 지정한다
+ @return 실패시 에러 반환
+ */
+- (NSError * _Nullable)batchDownloadFile:(const char * _Nonnull)path
+                              toSavePath:(NSString * _Nonnull)savePath
+                                 control:(netbuf * _Nonnull)conn
+                                progress:(NSProgress * _Nonnull)progress
+                                reusable:(BOOL * _Nonnull)reusable {
+    // NSFileManager 로 결과를 다루는 호출자와 같은 경로가 되도록 파일 시스템 표현을 사용한다
+    const char *saveFilePath = [savePath fileSystemRepresentation];
+    int fd = open(saveFilePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return [NSError FTPKitErrorWithCode:FTP_FailedToSaveToLocal];
+    }
+    
+    netbuf *nData = NULL;
+    if (!FtpAccess([self path:path relativeToConnection:conn], FTPLIB_FILE_READ, FTPLIB_BINARY, 0, conn, &nData)) {
+        close(fd);
+        unlink(saveFilePath);
+        const char *response = FtpLastResponse(conn);
+        // 서버가 거부한 경우(4xx/5xx)는 응답을 읽었으므로 접속을 계속 사용한다
+        *reusable = response[0] == '4' || response[0] == '5';
+        return [NSError FTPKitErrorWithResponse:[NSString stringWithCString:response encoding:_encoding]];
+    }
+    
+    NSError *error = NULL;
+    long long int offset = 0;
+    int input = 0;
+    // 소켓에서 파일로 바로 저장한다
+    while ((input = FtpReadFd(fd, offset, kFTPKitReadChunkSize, nData)) > 0) {
+        offset += input;
+        if ([progress isCancelled] == true) {
+            break;
+        }
+    }
+    if (input != 0) {
+        error = [NSError FTPKitErrorWithCode:input < 0 ? FTP_FailedToSaveToLocal : FTP_Aborted];
+        *reusable = FtpAbort(nData) == 1;
+    }
+    else if (FtpClose(nData) != 1) {
+        error = [NSError FTPKitErrorWithCode:FTP_FailedToReadByIncomplete];
+        *reusable = conn->desync == 0;
+    }
+    close(fd);
+    if (error != NULL) {
+        unlink(saveFilePath);
+    }
+    return error;
+}
+
+/**
+ 여러 접속으로 디렉토리 아래 전체의 목록을 동시에 가져온다
+ 
+ @param remotePath 탐색을 시작할 디렉토리 경로
+ @param sessions 동시에 사용할 최대 접속 수
+ @param maximumDepth 최대 탐색 깊이. 시작 디렉토리가 0
+ @param showHiddenFiles 감춤 파일 포함 여부
+ @param directoryHandler 디렉토리 목록을 가져올 때마다 호출. 들어가서 탐색할 하위 디렉토리를 반환한다.
+        실패시 items 는 nil 이고 error 가 전달된다. 여러 작업자에서 동시에 호출될 수 있다
+ @param completion 탐색 완료 또는 취소 후 호출되는 완료 핸들러. 취소된 경우 cancelled 는 true
+ @return 목록을 가져온 디렉토리 수를 나타내는 NSProgress 반환
+ */
+- (NSProgress * _Nonnull)walkDirectoryAtPath:(NSString * _Nonnull)remotePath
+                                    sessions:(NSInteger)sessions
+                                maximumDepth:(NSInteger)maximumDepth
+                             showHiddenFiles:(BOOL)showHiddenFiles
+                            directoryHandler:(NSArray<FTPItem *> * _Nullable (^ _Nonnull)(NSString * _Nonnull path,
+                                                                                          NSInteger depth,
+                                                                                          NSArray<FTPItem *> * _Nullable items,
+                                                                                          NSError * _Nullable error))directoryHandler
+                                  completion:(void (^ _Nonnull)(BOOL cancelled))completion {
+    FTPTreeWalk *walk = [[FTPTreeWalk alloc] init];
+    walk.frontier = [[NSMutableArray alloc] initWithObjects:@[remotePath, @0], nil];
+    walk.condition = [[NSCondition alloc] init];
+    walk.maximumDepth = maximumDepth;
+    walk.showHiddenFiles = showHiddenFiles;
+    walk.progress = [[NSProgress alloc] init];
+    [walk.progress setTotalUnitCount:1];
+    walk.group = dispatch_group_create();
+    walk.directoryHandler = directoryHandler;
+    // 대기 중인 작업자를 깨워서 종료시킨다
+    NSCondition *condition = walk.condition;
+    [walk.progress setCancellationHandler:^{
+        [condition lock];
+        [condition broadcast];
+        [condition unlock];
+    }];
+    
+    for (NSInteger i = 0; i < MAX(sessions, 1); i++) {
+        dispatch_group_enter(walk.group);
+        [self scheduleWithPriority:self.transferPriority block:^{
+            [self runTreeWalker:walk];
+            dispatch_group_leave(walk.group);
+        }];
+    }
+    NSProgress *progress = walk.progress;
+    dispatch_group_notify(walk.group, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        completion([progress isCancelled]);
+    });
+    return walk.progress;
+}
+
+/**
+ 디렉토리 탐색 작업자. 대기 목록이 비고 목록을 가져오는 작업자가 없을 때까지 접속 하나로 목록을 가져온다
+ 
+ @param walk 병렬 디렉토리 탐색 공유 상태
+ */
+- (void)runTreeWalker:(FTPTreeWalk * _Nonnull)walk {
+    netbuf *conn = NULL;
+    NSCondition *condition = walk.condition;
+    // 공유 대기 목록이 가득 차서 직접 탐색할 디렉토리
+    NSMutableArray<NSArray *> *local = [[NSMutableArray alloc] init];
+    
+    while (true) {
+        NSArray *entry = nil;
+        if ([local count] > 0 &&
+            [walk.progress isCancelled] == false) {
+            entry = [local lastObject];
+            [local removeLastObject];
+        }
+        else {
+            [condition lock];
+            if ([local count] > 0) {
+                // 취소된 경우 직접 탐색할 디렉토리를 버린다
+                [local removeAllObjects];
+                walk.busy--;
+                [condition broadcast];
+            }
+            // 다른 작업자가 하위 디렉토리를 추가할 수 있으므로 모두 끝날 때까지 기다린다
+            while ([walk.frontier count] == 0 &&
+                   walk.busy > 0 &&
+                   [walk.progress isCancelled] == false) {
+                [condition wait];
+            }
+            if ([walk.frontier count] > 0 &&
+                [walk.progress isCancelled] == false) {
+                entry = [walk.frontier lastObject];
+                [walk.frontier removeLastObject];
+                walk.busy++;
+            }
+            [condition unlock];
+            if (entry == nil) {
+                break;
+            }
+        }
+        
+        NSString *path = entry[0];
+        NSInteger depth = [entry[1] integerValue];
+        NSError *error = NULL;
+        NSArray<FTPItem *> *items = nil;
+        if (conn == NULL) {
+            conn = [self checkoutConnection:&error];
+        }
+        if (conn != NULL) {
+            BOOL reusable = true;
+            items = [self listDirectory:path control:conn showHiddenFiles:walk.showHiddenFiles error:&error reusable:&reusable];
+            if (reusable == false) {
+                [self checkinConnection:conn reusable:false];
+                conn = NULL;
+            }
+        }
+        NSArray<FTPItem *> *children = walk.directoryHandler(path, depth, items, error);
+        
+        [condition lock];
+        if (depth < walk.maximumDepth) {
+            for (FTPItem *child in children) {
+                if (child.isDir == false) {
+                    continue;
+                }
+                NSArray *childEntry = @[[path stringByAppendingPathComponent:child.filename], @(depth + 1)];
+                if ([walk.frontier count] < kFTPKitTraversalFrontierLimit) {
+                    [walk.frontier addObject:childEntry];
+                }
+                else {
+                    [local addObject:childEntry];
+                }
+            }
+        }
+        // 직접 탐색할 디렉토리가 남은 동안은 다른 작업자가 종료하지 않도록 작업 중으로 둔다
+        if ([local count] == 0) {
+            walk.busy--;
+        }
+        walk.progress.totalUnitCount = walk.progress.completedUnitCount + 1 + [walk.frontier count] + [local count] + walk.busy;
+        walk.progress.completedUnitCount++;
+        [condition broadcast];
+        [condition unlock];
+    }
+    
+    if (conn != NULL) {
+        [self checkinConnection:conn reusable:true];
+    }
+}
+
+/**
+ 대여한 접속으로 디렉토리 목록을 가져온다. "." 과 ".." 은 제외한다
+ 
+ @param path 디렉토리 경로
+ @param conn 제어 접속
+ @param showHiddenFiles 감춤 파일 포함 여부
+ @param error 에러 발생시, 에러값을 반환하는 이중 포인터
+ @param reusable 응답 순서가 맞지 않아 접속을 재사용할 수 없는 경우 false 로 지정한다
+ @return 성공시 FTPItem 배열 반환. 실패시 nil 반환
+ */
+- (NSArray<FTPItem *> * _Nullable)listDirectory:(NSString * _Nonnull)path
+                                        control:(netbuf * _Nonnull)conn
+                                showHiddenFiles:(BOOL)showHiddenFiles
+                                          error:(NSError * _Nullable * _Nullable)error
+                                       reusable:(BOOL * _Nonnull)reusable {
+    const char *cPath = [[path urlEncodedString] cStringUsingEncoding:_encoding];
+    if (cPath == NULL) {
+        if (error != NULL) {
+            *error = [NSError FTPKitErrorWithCode:FTP_FailedToOpenFile];
+        }
+        return nil;
+    }
+    char *buffer = NULL;
+    const char *relativePath = [self path:cPath relativeToConnection:conn];
+    // 서버가 MLST 를 지원하면 형식이 정해진 MLSD 로 목록을 받는다
+    BOOL machineList = (FtpFeatures(conn) & FTPLIB_FEAT_MLST) != 0;
+    int stat = 0;
+    if (machineList) {
+        stat = FtpMlsdData(&buffer, NULL, relativePath, conn);
+    }
+    else {
+        stat = FtpDirData(&buffer, NULL, relativePath, conn);
+    }
+    if (!stat) {
+        free(buffer);
+        const char *response = FtpLastResponse(conn);
+        *reusable = conn->desync == 0 && (response[0] == '4' || response[0] == '5');
+        if (error != NULL) {
+            *error = [NSError FTPKitErrorWithResponse:[NSString stringWithCString:response encoding:_encoding]];
+        }
+        return nil;
+    }
+    // 빈 디렉토리는 빈 목록으로 본다
+    NSArray<FTPItem *> *parsed = machineList ? [self parseMachineListFromBuffer:buffer showHiddentFiles:showHiddenFiles] : [self parseListFromBuffer:buffer showHiddentFiles:showHiddenFiles];
+    free(buffer);
+    NSMutableArray<FTPItem *> *items = [[NSMutableArray alloc] init];
+    for (FTPItem *item in parsed) {
+        if ([item.filename isEqualToString:@"."] == false &&
+            [item.filename isEqualToString:@".."] == false) {
+            [items addObject:item];
+        }
+    }
+    return items;
+}
+
+/**
+ 미러링할 디렉토리 목록을 로컬 디렉토리와 비교
+ 
+ - 하위 디렉토리는 로컬에 만들고 탐색할 목록으로 반환한다
+ - 크기와 수정일이 같은 파일은 건너뛰고, 나머지는 받을 파일로 추가한다
+ 
+ @param items 원격 디렉토리 목록
+ @param remotePath 원격 디렉토리 경로
+ @param directory 대응하는 로컬 디렉토리 경로
+ @param mirror 미러링 공유 상태
+ @param deletesExtraneousFiles 종류가 바뀐 로컬 항목을 제거할지 여부
+ @return 탐색할 하위 디렉토리
+ */
+- (NSArray<FTPItem *> * _Nonnull)mirrorItems:(NSArray<FTPItem *> * _Nonnull)items
+                                  remotePath:(NSString * _Nonnull)remotePath
+                              localDirectory:(NSString * _Nonnull)directory
+                                      mirror:(FTPMirror * _Nonnull)mirror
+                      deletesExtraneousFiles:(BOOL)deletesExtraneousFiles {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSMutableArray<FTPItem *> *children = [[NSMutableArray alloc] init];
+    NSMutableSet<NSString *> *names = [[NSMutableSet alloc] init];
+    NSInteger failedCount = 0;
+    
+    for (FTPItem *item in items) {
+        [names addObject:item.filename];
+        NSString *localFile = [directory stringByAppendingPathComponent:item.filename];
+        BOOL isDirectory = false;
+        BOOL exists = [fileManager fileExistsAtPath:localFile isDirectory:&isDirectory];
+        // 파일과 디렉토리가 바뀐 경우
+        if (exists == true &&
+            isDirectory != (BOOL)item.isDir) {
+            if (deletesExtraneousFiles == false ||
+                [fileManager removeItemAtPath:localFile error:NULL] == false) {
+                failedCount++;
+                continue;
+            }
+            exists = false;
+        }
+        
+        if (item.isDir == true) {
+            if (exists == false &&
+                [fileManager createDirectoryAtPath:localFile withIntermediateDirectories:YES attributes:nil error:NULL] == false) {
+                failedCount++;
+                continue;
+            }
+            [children addObject:item];
+            continue;
+        }
+        
+        if (exists == true) {
+            NSDictionary *attributes = [fileManager attributesOfItemAtPath:localFile error:NULL];
+            NSDate *localDate = attributes[NSFileModificationDate];
+            if ([attributes[NSFileSize] longLongValue] == item.size &&
+                (item.modificationDate == nil ||
+                 fabs([localDate timeIntervalSinceDate:item.modificationDate]) < kFTPKitMirrorTimeTolerance)) {
+                @synchronized (mirror) {
+                    mirror.summary.filesSkipped++;
+                    mirror.summary.bytesSkipped += item.size;
+                }
+                continue;
+            }
+        }
+        
+        // 같은 디렉토리의 임시 파일에 받은 뒤 rename 으로 바꿔 넣는다
+        NSString *remoteFile = [remotePath stringByAppendingPathComponent:item.filename];
+        NSString *temporaryName = [NSString stringWithFormat:@".%@.%@", item.filename, kFTPKitMirrorTemporaryExtension];
+        @synchronized (mirror) {
+            mirror.downloads[remoteFile] = [directory stringByAppendingPathComponent:temporaryName];
+            mirror.targets[remoteFile] = @[localFile, item.modificationDate != nil ? item.modificationDate : [NSNull null]];
+        }
+    }
+    
+    @synchronized (mirror) {
+        mirror.summary.failedCount += failedCount;
+        mirror.listedDirectories[directory] = names;
     }
-    return progress;
+    return children;
 }
 
 /**
- 서버의 remotePath 위치에 디렉토리 생성
+ 미러링 파일 하나를 받은 뒤 임시 파일을 저장 경로로 바꿔 넣는다
  
- @returns 성공시 NULL 반환. 실패시 에러 반환
+ @param remoteFile 원격 경로
+ @param mirror 미러링 공유 상태
+ @param error 다운로드 에러
  */
-- (NSError * _Nullable)createDirectoryAtPath:(NSString * _Nonnull)remotePath {
-    NSError *error = NULL;
-    netbuf *conn = [self connect:&error];
-    if (conn == NULL) {
-        // 에러 반환
-        return error;
+- (void)finishMirrorDownload:(NSString * _Nonnull)remoteFile
+                      mirror:(FTPMirror * _Nonnull)mirror
+                       error:(NSError * _Nullable)error {
+    NSString *temporaryPath = nil;
+    NSArray *target = nil;
+    @synchronized (mirror) {
+        temporaryPath = mirror.downloads[remoteFile];
+        target = mirror.targets[remoteFile];
     }
-    const char *path = [remotePath cStringUsingEncoding:_encoding];
-    int stat = FtpMkdir(path, conn);
-    NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
-    FtpQuit(conn);
-    if (stat == 0) {
-        return [NSError FTPKitErrorWithResponse:response];
+    long long int length = [temporaryPath fileSize];
+    if (error == NULL &&
+        target[1] != [NSNull null]) {
+        // 다음 미러링에서 바뀌지 않은 파일로 판단할 수 있도록 수정일을 원격 파일에 맞춘다
+        [[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate: target[1]}
+                                         ofItemAtPath:temporaryPath
+                                                error:NULL];
+    }
+    if (error == NULL &&
+        rename([temporaryPath fileSystemRepresentation], [target[0] fileSystemRepresentation]) != 0) {
+        unlink([temporaryPath fileSystemRepresentation]);
+        error = [NSError FTPKitErrorWithCode:FTP_FailedToSaveToLocal];
+    }
+    @synchronized (mirror) {
+        if (error != NULL) {
+            mirror.summary.failedCount++;
+        }
+        else {
+            mirror.summary.filesTransferred++;
+            mirror.summary.bytesTransferred += length;
+        }
     }
-    return NULL;
 }
+
 /**
- 백그라운드로 서버의 remotePath 위치에 디렉토리 생성
+ 목록을 가져온 디렉토리에서 원격에 없는 로컬 항목 제거
  
- @param completion 완료 핸들러. 성공시 NULL 반환. 실패시 에러 반환
+ @param mirror 미러링 공유 상태
  */
-- (void)createDirectoryAtPath:(NSString *)remotePath
-                   completion:(void (^)(NSError *))completion {
-    dispatch_async(_queue, ^{
-        completion([self createDirectoryAtPath:remotePath]);
-    });
-}
-
-- (NSError *)deleteDirectoryAtPath:(NSString *)remotePath {
-    return [self deleteItemAtPath:remotePath isFile:false];
+- (void)deleteExtraneousItemsForMirror:(FTPMirror * _Nonnull)mirror {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSDictionary<NSString *, NSSet<NSString *> *> *listedDirectories = nil;
+    @synchronized (mirror) {
+        listedDirectories = [mirror.listedDirectories copy];
+    }
+    NSInteger deleted = 0;
+    for (NSString *directory in listedDirectories) {
+        NSSet<NSString *> *names = listedDirectories[directory];
+        for (NSString *name in [fileManager contentsOfDirectoryAtPath:directory error:NULL]) {
+            if ([names containsObject:name] == false &&
+                [fileManager removeItemAtPath:[directory stringByAppendingPathComponent:name] error:NULL] == true) {
+                deleted++;
+            }
+        }
+    }
+    @synchronized (mirror) {
+        mirror.summary.itemsDeleted += deleted;
+    }
 }
 
-- (void)deleteDirectoryAtPath:(NSString *)remotePath completion:(void (^)(NSError *))completion {
-    [self deleteItemAtPath:remotePath isFile:false completion:completion];
+- (void)setPriority:(FTPPriority)priority ofProgress:(NSProgress *)progress {
+    FTPScheduledJob *job = progress.userInfo[kFTPKitScheduledJobKey];
+    job.priority = priority;
 }
 
-- (NSError *)deleteFileAtPath:(NSString *)remotePath {
-    return [self deleteItemAtPath:remotePath isFile:true];
-}
+/**
+ 스케줄러에 작업 추가
 
-- (void)deleteFileAtPath:(NSString *)remotePath completion:(void (^)(NSError *))completion {
-    [self deleteItemAtPath:remotePath isFile:true completion:completion];
+ @param priority 작업 우선순위
+ @param block 작업 블록
+ @return 추가된 작업
+ */
+- (FTPScheduledJob *)scheduleWithPriority:(FTPPriority)priority block:(void (^)(void))block {
+    return [self.scheduler scheduleJobForHost:self.credentials.host
+                                     priority:priority
+                                        block:^(FTPScheduledJob *job) {
+        block();
+    }];
 }
 
 /**
- 실제 제거 작업 실행 메쏘드
- 
- @param remotePath 제거할 아이템 경로
- @param isFile true 인 경우는 파일, false 는 디렉토리 제거로 판정
- @returns 제거 성공시 NULL 반환. 실패시 에러 반환
+ 스케줄러에 전송 작업 추가. progress 로 우선순위를 바꾸거나 취소할 수 있다
+
+ @param progress 전송의 NSProgress
+ @param priority 작업 우선순위
+ @param block 작업 블록
  */
-- (NSError * _Nullable)deleteItemAtPath:(NSString * _Nonnull)remotePath
-                                 isFile:(BOOL)isFile {
-    NSError *error = NULL;
-    netbuf *conn = [self connect:&error];
-    if (conn == NULL) {
-        return error;
-    }
-    const char *path = [[remotePath urlEncodedString] cStringUsingEncoding:_encoding];
-    int stat = 0;
-    // 파일인 경우
-    if (isFile) {
-        stat = FtpDelete(path, conn);
-    }
-    // 디렉토리인 경우
-    else {
-        stat = FtpRmdir(path, conn);
-    }
-    NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
-    FtpQuit(conn);
-    if (stat == 0) {
-        return [NSError FTPKitErrorWithResponse:response];
-    }
-    return NULL;
+- (void)scheduleTransfer:(NSProgress *)progress priority:(FTPPriority)priority block:(void (^)(void))block {
+    FTPScheduledJob *job = [self scheduleWithPriority:priority block:block];
+    [progress setUserInfoObject:job forKey:kFTPKitScheduledJobKey];
+    // 대기 중에 취소된 전송은 바로 실행되어, 접속을 대여하지 않고 완료 핸들러로 취소를 알린다
+    void (^cancellationHandler)(void) = progress.cancellationHandler;
+    [progress setCancellationHandler:^{
+        [job cancel];
+        if (cancellationHandler != nil) {
+            cancellationHandler();
+        }
+    }];
 }
-/**
- 실제 제거 작업 백그라운드 실행 메쏘드
- 
- @param remotePath 제거할 아이템 경로
- @param isFile true 인 경우는 파일, false 는 디렉토리 제거로 판정
- @param completion 완료 핸들러. 실패시 에러 반환
- */
-- (void)deleteItemAtPath:(NSString * _Nonnull)remotePath
-                  isFile:(BOOL)isFile
-              completion:(void (^ _Nonnull)(NSError * _Nullable))completion {
-    dispatch_async(_queue, ^{
-        completion([self deleteItemAtPath:remotePath isFile:isFile]);
-    });
+
+- (netbuf *)checkoutConnection:(NSError **)error {
+    return [self prepareTransferOptions:[_connectionPool checkoutConnection:error]];
 }
 
-- (NSError *)chmodPath:(NSString *)remotePath toMode:(int)mode {
-    if (mode < 0 || mode > 777) {
-        NSDictionary *userInfo = [NSDictionary dictionaryWithObject:NSLocalizedString(@"File mode value must be between 0 and 0777.", @"")
-                                                             forKey:NSLocalizedDescriptionKey];
-        return [[NSError alloc] initWithDomain:FTPErrorDomain code:0 userInfo:userInfo];
-    }
-    
-    NSString *command = [NSString stringWithFormat:@"SITE CHMOD %i %@", mode, [remotePath urlEncodedString]];
-    NSError *error = NULL;
-    netbuf *conn = [self connect:&error];
-    if (conn == NULL) {
-        // 연결 실패시 에러 반환
-        return error;
-    }
-    
-    error = [self sendCommand:command conn:conn];
-    FtpQuit(conn);
-    if (error != NULL) {
-        return error;
+/**
+ 대여한 접속에 이 클라이언트의 전송률 제한과 가중치 지정
+
+ @param conn 대여한 접속. NULL 인 경우 무시한다
+ @return conn 반환
+ */
+- (netbuf *)prepareTransferOptions:(netbuf *)conn {
+    if (conn != NULL) {
+        FtpOptions(FTPLIB_RATELIMIT, (long)self.maximumBytesPerTransfer, conn);
+        FtpOptions(FTPLIB_WEIGHT, (long)MAX(self.transferWeight, 1), conn);
     }
-    return NULL;
+    return conn;
 }
 
-- (void)chmodPath:(NSString *)remotePath toMode:(int)mode
-       completion:(void (^)(NSError *))completion {
-    dispatch_async(_queue, ^{
-        completion([self chmodPath:remotePath toMode:mode]);
-    });
+- (void)checkinConnection:(netbuf *)conn reusable:(BOOL)reusable {
+    [_connectionPool checkinConnection:conn reusable:reusable];
 }
 
-- (NSError *)renamePath:(NSString *)sourcePath
-                     to:(NSString *)destPath {
-    NSError *error = NULL;
-    netbuf *conn = [self connect:&error];
-    if (conn == NULL) {
-        // 에러 반환
-        return error;
+- (netbuf *)checkoutConnectionForPath:(const char *)path error:(NSError **)error {
+    if (path == NULL ||
+        path[0] != '/') {
+        return [self checkoutConnection:error];
     }
-
-    const char *src = [[sourcePath urlEncodedString] cStringUsingEncoding:_encoding];
-    // @note The destination path does not need to be URL encoded. In fact, if
-    // it is, the filename will include the percent escaping!
-    const char *dst = [destPath cStringUsingEncoding:_encoding];
-    int stat = FtpRename(src, dst, conn);
-    NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
-    FtpQuit(conn);
-    if (stat == 0) {
-        return [NSError FTPKitErrorWithResponse:response];
+    // 상위 디렉토리 경로. 루트 바로 아래 경로인 경우는 "/"
+    const char *slash = strrchr(path, '/');
+    size_t length = slash == path ? 1 : (size_t)(slash - path);
+    char directory[kFTPKitTempBufferSize];
+    if (length >= kFTPKitTempBufferSize) {
+        return [self checkoutConnection:error];
     }
-    return NULL;
+    memcpy(directory, path, length);
+    directory[length] = '\0';
+    return [self prepareTransferOptions:[_connectionPool checkoutConnectionInDirectory:directory error:error]];
 }
 
-- (void)renamePath:(NSString *)sourcePath to:(NSString *)destPath
-        completion:(void (^)(NSError *))completion {
-    dispatch_async(_queue, ^{
-        completion([self renamePath:sourcePath to:destPath]);
-    });
-}
-
-/** Private Methods */
-
-- (netbuf *)connect:(NSError **)error {
-    const char *host = [_credentials.host cStringUsingEncoding:_encoding];
-    const char *user = [_credentials.username cStringUsingEncoding:_encoding];
-    const char *pass = [_credentials.password cStringUsingEncoding:_encoding];
-    netbuf *conn;
-    int stat = FtpConnect(host, &conn);
-    if (stat == 0) {
-        // @fixme We don't get the exact error code from the lib. Use a generic
-        // connection error.
-        if (error != NULL) {
-            *error = [NSError FTPKitErrorWithCode:10060];
-        }
-        return NULL;
+- (const char *)path:(const char *)path relativeToConnection:(netbuf *)conn {
+    if (path == NULL ||
+        path[0] != '/' ||
+        conn->cwd[0] == '\0') {
+        return path;
     }
-    stat = FtpLogin(user, pass, conn);
-    if (stat == 0) {
-        NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
-        if (error != NULL) {
-            *error = [NSError FTPKitErrorWithResponse:response];
-        }
-        FtpQuit(conn);
-        return NULL;
+    const char *slash = strrchr(path, '/');
+    // 디렉토리 경로인 경우는 그대로 사용
+    if (slash[1] == '\0') {
+        return path;
     }
-    return conn;
+    size_t length = slash == path ? 1 : (size_t)(slash - path);
+    if (strlen(conn->cwd) != length ||
+        strncmp(conn->cwd, path, length) != 0) {
+        return path;
+    }
+    return slash + 1;
 }
 
 /**
@@ -1249,9 +3387,167 @@
     return parsedLists;
 }
 
+/**
+ MLSD 결과를 `char` 포인터 기반으로 파싱 실행
+ @param bufferData 파싱할 char 포인터
+ @param showHiddenFiles 감춤 파일 표시 여부
+ @returns `FTPItem` 배열로 반환
+ */
+- (NSArray<FTPItem *> *_Nullable)parseMachineListFromBuffer:(char * _Nullable)bufferData showHiddentFiles:(BOOL)showHiddenFiles {
+    if (bufferData == NULL ||
+        strlen(bufferData) == 0) {
+        return nil;
+    }
+
+    NSString *listString = [[NSString alloc] initWithCString:bufferData encoding:_encoding];
+    return [self parseMachineListFromLists:listString showHiddentFiles:showHiddenFiles];
+}
+/**
+ MLSD 결과를 `NSData` 기반으로 파싱 실행
+ @param data 파싱할 NSData
+ @param showHiddenFiles 감춤 파일 표시 여부
+ @returns `FTPItem` 배열로 반환
+ */
+- (NSArray<FTPItem *> *_Nullable)parseMachineListFromData:(NSData * _Nullable)data showHiddentFiles:(BOOL)showHiddenFiles {
+    if (data == NULL ||
+        [data length] == 0) {
+        return nil;
+    }
+
+    NSString *listString = [[NSString alloc] initWithData:data encoding:_encoding];
+    return [self parseMachineListFromLists:listString showHiddentFiles:showHiddenFiles];
+}
+
+/**
+ MLSD 결과를 `NSString` 기반으로 파싱 실행
+ 
+ - 현재/상위 디렉토리 항목 (type=cdir, type=pdir) 은 제외한다
+ 
+ @param listString 파싱할 리스트 목록이 격납된 NSString
+ @param showHiddenFiles 감춤 파일 표시 여부
+ @returns `FTPItem` 배열로 반환
+ */
+- (NSArray<FTPItem *> * _Nullable)parseMachineListFromLists:(NSString * _Nullable)listString showHiddentFiles:(BOOL)showHiddenFiles {
+    if ([listString length] == 0) {
+        return nil;
+    }
+
+    NSMutableArray<FTPItem *> *parsedLists = [[NSMutableArray alloc] init];
+    for (NSString *line in [listString componentsSeparatedByString:@"\n"]) {
+        NSString *pathname = nil;
+        NSDictionary<NSString *, NSString *> *facts = [self factsFromLine:line pathname:&pathname];
+        if (facts == nil) {
+            continue;
+        }
+        NSString *type = [facts[@"type"] lowercaseString];
+        if ([type isEqualToString:@"cdir"] == true ||
+            [type isEqualToString:@"pdir"] == true) {
+            continue;
+        }
+        FTPItem *item = [self itemWithFacts:facts filename:pathname];
+        // showHiddenFiles == false 인데 감춤 파일인 경우 건너뛴다
+        if (showHiddenFiles == false && item.isHidden == true) {
+            continue;
+        }
+        [parsedLists addObject:item];
+    }
+    return parsedLists;
+}
+
+/**
+ MLSD/MLST 의 한 줄을 사실 (facts) 과 경로로 나눈다
+ 
+ - "type=file;size=10;modify=20240101000000; name" 형식. 경로는 첫 공백 뒤의 나머지 전체
+ - 사실 이름은 대소문자를 구분하지 않으므로 소문자로 바꿔서 반환한다
+ 
+ @param line 파싱할 줄
+ @param pathname 경로를 반환하는 이중 포인터
+ @returns 사실 사전 반환. 형식이 맞지 않으면 nil 반환
+ */
+- (NSDictionary<NSString *, NSString *> * _Nullable)factsFromLine:(NSString * _Nonnull)line
+                                                          pathname:(NSString * _Nullable * _Nonnull)pathname {
+    line = [line stringByTrimmingCharactersInSet:[NSCharacterSet newlineCharacterSet]];
+    NSRange space = [line rangeOfString:@" "];
+    if (space.location == NSNotFound ||
+        NSMaxRange(space) >= [line length]) {
+        return nil;
+    }
+    NSMutableDictionary<NSString *, NSString *> *facts = [[NSMutableDictionary alloc] init];
+    for (NSString *fact in [[line substringToIndex:space.location] componentsSeparatedByString:@";"]) {
+        NSRange equal = [fact rangeOfString:@"="];
+        if (equal.location == NSNotFound ||
+            equal.location == 0) {
+            continue;
+        }
+        // os.unix=slink:... 처럼 값에 = 이 들어갈 수 있으므로 첫 = 에서 나눈다
+        facts[[[fact substringToIndex:equal.location] lowercaseString]] = [fact substringFromIndex:NSMaxRange(equal)];
+    }
+    *pathname = [line substringFromIndex:NSMaxRange(space)];
+    return facts;
+}
+
+/**
+ MLSD/MLST 사실로 FTPItem 생성
+ 
+ - 심볼릭 링크는 LIST 파싱과 같이 디렉토리로 간주한다
+ - 디렉토리 크기는 size 가 없으면 sizd 를 사용한다
+ 
+ @param facts factsFromLine:pathname: 이 반환한 사실 사전
+ @param filename 파일명
+ @returns FTPItem 반환
+ */
+- (FTPItem * _Nonnull)itemWithFacts:(NSDictionary<NSString *, NSString *> * _Nonnull)facts
+                           filename:(NSString * _Nonnull)filename {
+    NSString *type = [facts[@"type"] lowercaseString];
+    bool isDir = [type isEqualToString:@"dir"] == true ||
+                 [type isEqualToString:@"cdir"] == true ||
+                 [type isEqualToString:@"pdir"] == true ||
+                 [type hasPrefix:@"os.unix=slink"] == true ||
+                 [type hasPrefix:@"os.unix=symlink"] == true;
+    // 파일명이 . 으로 시작하는 경우 hidden file로 간주
+    bool isHidden = [filename hasPrefix:@"."];
+    NSString *size = facts[@"size"] ?: facts[@"sizd"];
+    FTPItem *item = [[FTPItem alloc] initWithFilename:filename
+                                                isDir:isDir
+                                             isHidden:isHidden
+                                                 size:(long int)[size longLongValue]
+                                     modificationDate:[self dateFromTimeValue:facts[@"modify"]]];
+    item.uniqueIdentifier = facts[@"unique"];
+    return item;
+}
+
+/**
+ MLSD/MLST/MDTM 시각 값을 NSDate 로 변환
+ 
+ @param value "YYYYMMDDHHMMSS[.sss]" 형식의 UTC 시각
+ @returns 변환된 NSDate. 형식이 맞지 않으면 nil 반환
+ */
+- (NSDate * _Nullable)dateFromTimeValue:(NSString * _Nullable)value {
+    const char *timeValue = [[value stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]] UTF8String];
+    if (timeValue == NULL ||
+        strlen(timeValue) < 14) {
+        return nil;
+    }
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(timeValue, "%4d%2d%2d%2d%2d%2d",
+               &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6) {
+        return nil;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    NSTimeInterval interval = (NSTimeInterval)timegm(&tm);
+    // 밀리초 이하 부분
+    if (timeValue[14] == '.') {
+        interval += atof(&timeValue[14]);
+    }
+    return [NSDate dateWithTimeIntervalSince1970:interval];
+}
+
 - (NSDate * _Nullable)lastModifiedAtPath:(NSString * _Nonnull)remotePath
                                    error:(NSError ** _Nullable)error {
-    netbuf *conn = [self connect:error];
+    netbuf *conn = [self checkoutConnection:error];
     if (conn == NULL) {
         return NULL;
     }
@@ -1262,7 +3558,7 @@
     // of files that can be downloaded using the RETR command.
     int stat = FtpModDate(cPath, dt, kFTPKitRequestBufferSize, conn);
     NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
-    FtpQuit(conn);
+    [self checkinConnection:conn reusable:true];
     if (stat == 0) {
         if (error != NULL) {
             *error = [NSError FTPKitErrorWithResponse:response];
@@ -1280,10 +3576,65 @@
 
 - (void)lastModifiedAtPath:(NSString *)remotePath
                 completion:(void (^ _Nonnull)(NSDate * _Nullable modifiedDate, NSError * _Nullable error))completion {
-    dispatch_async(_queue, ^{
+    [self scheduleWithPriority:FTPPriorityInteractive block:^{
         NSError *error = NULL;
         completion([self lastModifiedAtPath:remotePath error:&error], error);
-    });
+    }];
+}
+
+- (FTPItem * _Nullable)itemAtPath:(NSString * _Nonnull)remotePath
+                            error:(NSError * _Nullable * _Nullable)error {
+    const char *cPath = [[remotePath urlEncodedString] cStringUsingEncoding:_encoding];
+    if (cPath == NULL) {
+        if (error != NULL) {
+            *error = [NSError FTPKitErrorWithCode:FTP_FailedToOpenFile];
+        }
+        return nil;
+    }
+    netbuf *conn = [self checkoutConnectionForPath:cPath error:error];
+    if (conn == NULL) {
+        return nil;
+    }
+    NSString *filename = [remotePath lastPathComponent];
+    FTPItem *item = nil;
+    if ((FtpFeatures(conn) & FTPLIB_FEAT_MLST) != 0) {
+        char facts[kFTPKitTempBufferSize];
+        if (FtpMlst([self path:cPath relativeToConnection:conn], facts, sizeof(facts), conn)) {
+            NSString *pathname = nil;
+            NSDictionary<NSString *, NSString *> *parsed = [self factsFromLine:[NSString stringWithCString:facts encoding:_encoding] ?: @""
+                                                                       pathname:&pathname];
+            if (parsed != nil) {
+                item = [self itemWithFacts:parsed filename:filename];
+            }
+        }
+    }
+    else {
+        // MLST 를 지원하지 않는 서버는 파일에 한해 SIZE/MDTM 으로 대체
+        long long int size = [self sizeAt:cPath control:conn];
+        if (size >= 0) {
+            NSDate *modificationDate = [self dateFromTimeValue:[self modificationDateAt:cPath control:conn]];
+            item = [[FTPItem alloc] initWithFilename:filename
+                                               isDir:false
+                                            isHidden:[filename hasPrefix:@"."]
+                                                size:(long int)size
+                                    modificationDate:modificationDate];
+        }
+    }
+    NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
+    [self checkinConnection:conn reusable:true];
+    if (item == nil &&
+        error != NULL) {
+        *error = [NSError FTPKitErrorWithResponse:response];
+    }
+    return item;
+}
+
+- (void)itemAtPath:(NSString * _Nonnull)remotePath
+        completion:(void (^ _Nonnull)(FTPItem * _Nullable item, NSError * _Nullable error))completion {
+    [self scheduleWithPriority:FTPPriorityInteractive block:^{
+        NSError *error = NULL;
+        completion([self itemAtPath:remotePath error:&error], error);
+    }];
 }
 
 - (BOOL)directoryExistsAtPath:(NSString * _Nonnull)remotePath
@@ -1317,17 +3668,19 @@
      */
     
     /**
-     Currently the lib creates a new connection for every command issued.
-     Therefore, it is unnecessary to change back to the original cwd.
+     The connection tracks its cwd, so it is returned to the pool positioned in
+     remotePath. The pool moves it back to the login directory before handing
+     it out for relative paths.
      */
-    netbuf *conn = [self connect:error];
+    netbuf *conn = [self checkoutConnection:error];
     if (conn == NULL) {
         return NO;
     }
     const char *cPath = [remotePath cStringUsingEncoding:_encoding];
     int stat = FtpChdir(cPath, conn);
     NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
-    FtpQuit(conn);
+    // 바뀐 작업 디렉토리는 접속에 기록되므로 그대로 풀에 반납한다. 상대 경로 작업에 대여될 때 로그인 디렉토리로 되돌아간다
+    [self checkinConnection:conn reusable:true];
     if (stat == 0) {
         if (error != NULL) {
             *error = [NSError FTPKitErrorWithResponse:response];
@@ -1338,15 +3691,15 @@
 }
 
 - (void)directoryExistsAtPath:(NSString *)remotePath completion:(void (^ _Nonnull)(BOOL exists, NSError * _Nullable error))completion {
-    dispatch_async(_queue, ^{
+    [self scheduleWithPriority:FTPPriorityInteractive block:^{
         NSError *error = NULL;
         completion([self directoryExistsAtPath:remotePath error:&error], error);
-    });
+    }];
 }
 
 - (NSError *)changeDirectoryToPath:(NSString *)remotePath {
     NSError *error = NULL;
-    netbuf *conn = [self connect:&error];
+    netbuf *conn = [self checkoutConnection:&error];
     if (conn == NULL) {
         // 에러 발생시 그대로 반환 처리
         return error;
@@ -1354,7 +3707,8 @@
     const char *cPath = [remotePath cStringUsingEncoding:_encoding];
     int stat = FtpChdir(cPath, conn);
     NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
-    FtpQuit(conn);
+    // 바뀐 작업 디렉토리는 접속에 기록되므로 그대로 풀에 반납한다. 상대 경로 작업에 대여될 때 로그인 디렉토리로 되돌아간다
+    [self checkinConnection:conn reusable:true];
     if (stat == 0) {
         return [NSError FTPKitErrorWithResponse:response];
     }
@@ -1362,14 +3716,14 @@
 }
 
 - (NSString *)printWorkingDirectory:(NSError *_Nullable * _Nullable)error {
-    netbuf *conn = [self connect:error];
+    netbuf *conn = [self checkoutConnection:error];
     if (conn == NULL) {
         return nil;
     }
     char cPath[kFTPKitTempBufferSize];
     int stat = FtpPwd(cPath, kFTPKitTempBufferSize, conn);
     NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
-    FtpQuit(conn);
+    [self checkinConnection:conn reusable:true];
     if (stat == 0) {
         if (error != NULL) {
             *error = [NSError FTPKitErrorWithResponse:response];
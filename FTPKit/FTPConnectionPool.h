@@ -0,0 +1,182 @@
+/**
+ 로그인이 완료된 FTP 제어 접속(netbuf)을 보관, 재사용하는 접속 풀.
+
+ 접속 정보(호스트/사용자/암호/인코딩)마다 하나의 풀이 공유되며, FTPClient의 모든
+ 작업은 이 풀에서 접속을 대여(checkout)하고 작업 종료 후 반납(checkin)한다.
+ 따라서 반복 작업에서는 TCP 접속, 서버 인사말, USER/PASS 왕복 시간이 생략된다.
+ */
+
+#import "ftplib.h"
+#import "FTPCredentials.h"
+
+@interface FTPConnectionPool : NSObject
+
+/** 풀의 접속 정보 */
+@property (nonatomic, readonly) FTPCredentials * _Nonnull credentials;
+
+/** 사용자명/암호를 C 문자열로 변환할 때 사용하는 인코딩 */
+@property (nonatomic, readonly) int encoding;
+
+/**
+ 풀에 보관할 최대 유휴 접속 수. 기본값은 4.
+
+ 이 값을 초과해서 반납된 접속은 바로 종료된다. 0으로 지정하면 풀링을 사용하지 않는다.
+ */
+@property (atomic) NSUInteger maximumIdleConnections;
+
+/**
+ 유휴 접속 최대 유지 시간(초). 기본값은 60초.
+
+ 이 시간 이상 사용되지 않은 접속은 대여되지 않고 종료된다.
+ */
+@property (atomic) NSTimeInterval idleTimeout;
+
+/**
+ 접속 상태 확인 간격(초). 기본값은 15초.
+
+ 이 시간 이상 유휴 상태였던 접속은 대여 전 NOOP으로 상태를 확인하고, 응답이 없으면 폐기한다.
+ */
+@property (atomic) NSTimeInterval healthCheckInterval;
+
+/**
+ 접속 유지(NOOP) 간격(초). 기본값은 0 으로, 사용하지 않는다.
+
+ 0보다 큰 경우
+ - 백그라운드 타이머가 이 간격으로 유휴 접속에 NOOP을 보내고, 실패한 접속은 폐기한다
+ - 대여된 접속에서 긴 RETR/STOR 전송이 진행 중일 때도 제어 접속으로 NOOP을 보낸다
+
+ 서버의 유휴 시간 제한(421)보다 짧게 지정하고, idleTimeout 도 함께 늘려야 효과가 있다.
+ */
+@property (nonatomic) NSTimeInterval keepAliveInterval;
+
+/**
+ 새 접속 생성시 로그인 명령을 파이프라이닝할지 여부. 기본값은 NO.
+
+ YES 인 경우 USER, PASS, TYPE I (UTF-8 인코딩이면 OPTS UTF8 ON 포함) 명령을 한번에 보내서
+ 접속 준비에 필요한 왕복 시간을 줄인다. 서버가 파이프라이닝을 거부하면 재접속 후 일반 로그인을 사용한다.
+ */
+@property (atomic) BOOL pipelinedLogin;
+
+/**
+ 새 접속 생성시 명시적 FTPS(AUTH TLS)를 사용할지 여부. 기본값은 NO.
+
+ YES 인 경우 로그인 전에 제어 접속을 TLS로 전환하고 PROT P 로 데이터 접속도 암호화한다.
+ 데이터 접속은 제어 접속의 TLS 세션을 재사용하므로 전송마다 전체 핸드셰이크를 하지 않는다.
+ ftplib 를 FTPLIB_USE_OPENSSL 로 빌드해야 하며, 아닌 경우 접속이 실패한다.
+ */
+@property (atomic) BOOL useTLS;
+
+/**
+ TLS 사용시 서버 인증서 확인을 생략할지 여부. 기본값은 NO.
+
+ 자체 서명 인증서를 사용하는 테스트 서버에서만 사용한다.
+ */
+@property (atomic) BOOL allowsInvalidCertificates;
+
+/**
+ 패시브 모드에서 PASV 응답의 주소를 무시하고 제어 접속 주소를 사용할지 여부. 기본값은 NO.
+
+ NAT 뒤의 서버가 사설 주소를 응답하는 경우에 사용한다. EPSV 를 지원하는 서버는 처음부터 제어 접속 주소를 사용한다.
+ */
+@property (atomic) BOOL ignoresPassiveHost;
+
+/**
+ 전송 완료시 다음 전송의 패시브 데이터 접속을 미리 열지 여부. 기본값은 NO.
+
+ YES 인 경우 전송 결과 응답을 기다리는 동안 EPSV/PASV 를 보내고 데이터 접속을 시작해 두므로,
+ 같은 접속의 다음 전송은 RETR/STOR 왕복 시간만 필요하다. 작은 파일을 연속해서 받을 때 효과가 있다.
+ 사용하지 않은 데이터 접속은 다음 전송에서 버려진다.
+ */
+@property (atomic) BOOL preopensDataConnections;
+
+/**
+ 접속 상태에 맞춰 소켓 옵션을 조정할지 여부. 기본값은 NO.
+
+ YES 인 경우
+ - 제어 접속에 TCP_NODELAY 를 지정해서 파이프라이닝한 명령이 지연 없이 전송된다
+ - 데이터 소켓 버퍼를 제어 접속에서 측정한 RTT 와 이전 전송의 전송률에 맞춰 늘린다
+
+ 지연 시간이 긴 원거리 서버에서 큰 파일을 전송할 때 효과가 있다.
+ */
+@property (atomic) BOOL tunesSocketBuffers;
+
+/**
+ 같은 서버(host:port)의 모든 전송이 함께 사용할 최대 전송률(bytes/초). 기본값은 0 으로, 제한하지 않는다.
+
+ 사용자가 다른 풀도 같은 서버이면 이 제한을 공유하므로, 한 풀에서 변경하면 같은 서버의 모든 풀에 적용된다.
+ 진행 중인 전송들이 각 FTPClient 의 transferWeight 에 비례해서 나눠 가지며, 진행 중인 전송에도 바로 적용된다.
+ 전송별 제한이나 서버 속도 때문에 몫을 다 쓰지 못하는 전송의 나머지는 다른 전송들이 나눠 가진다.
+ */
+@property (atomic) long long int maximumBytesPerSecond;
+
+/** 현재 풀에 보관 중인 유휴 접속 수 */
+@property (nonatomic, readonly) NSUInteger idleConnectionCount;
+
+/**
+ 접속 정보에 해당하는 공유 풀을 반환. 없는 경우 생성한다.
+
+ @param credentials 접속 정보
+ @param encoding 사용자명/암호 인코딩
+ @return FTPConnectionPool
+ */
++ (instancetype _Nonnull)poolForCredentials:(FTPCredentials * _Nonnull)credentials
+                                   encoding:(int)encoding;
+
+/**
+ 모든 풀의 전송이 함께 사용할 최대 전송률(bytes/초) 지정.
+
+ 서버별 제한(maximumBytesPerSecond)과 함께 적용되며, 진행 중인 전송들이 가중치에 비례해서 나눠 가진다.
+
+ @param rate 최대 전송률. 0 이면 제한하지 않는다
+ */
++ (void)setGlobalMaximumBytesPerSecond:(long long int)rate;
+
+/**
+ 로그인된 접속을 대여.
+
+ - 작업 디렉토리가 로그인 디렉토리인 접속을 반환하므로, 상대 경로는 항상 로그인 디렉토리 기준이다
+ - 유휴 접속이 있는 경우 로그인 디렉토리에 위치한 접속 중 가장 최근에 사용된 접속을 반환.
+   없으면 가장 최근에 사용된 접속을 로그인 디렉토리로 이동(CWD)시켜서 반환
+ - 유휴 접속이 없거나 모두 만료된 경우 새 접속을 생성해서 반환
+
+ @param error 에러 발생시, 에러값을 반환하는 이중 포인터
+ @return 성공시 netbuf 반환. 실패시 NULL 반환
+ */
+- (netbuf * _Nullable)checkoutConnection:(NSError * _Nullable * _Nullable)error;
+
+/**
+ 작업 디렉토리가 directory 인 접속을 우선해서 대여.
+
+ - 해당 디렉토리에 위치한 유휴 접속이 있는 경우 그 접속을 반환. 상대 경로를 사용할 수 있다
+ - 없는 경우 checkoutConnection: 과 같다
+
+ @param directory 서버 인코딩으로 변환된 절대 경로. NULL 인 경우 checkoutConnection: 과 같다
+ @param error 에러 발생시, 에러값을 반환하는 이중 포인터
+ @return 성공시 netbuf 반환. 실패시 NULL 반환
+ */
+- (netbuf * _Nullable)checkoutConnectionInDirectory:(const char * _Nullable)directory
+                                              error:(NSError * _Nullable * _Nullable)error;
+
+/**
+ 대여한 접속을 반납.
+
+ @param conn 반납할 접속
+ @param reusable 응답 순서가 보장되는 깨끗한 상태인 경우 true. false 인 경우 discardConnection: 처럼 QUIT 없이 종료한다.
+ */
+- (void)checkinConnection:(netbuf * _Nonnull)conn reusable:(BOOL)reusable;
+
+/**
+ 응답 순서를 알 수 없는 접속을 QUIT 없이 종료.
+
+ 정체된 서버는 QUIT 에도 응답하지 않을 수 있으므로, checkinConnection:reusable: 대신 사용한다.
+
+ @param conn 종료할 접속
+ */
+- (void)discardConnection:(netbuf * _Nonnull)conn;
+
+/**
+ 보관 중인 모든 유휴 접속을 종료.
+ */
+- (void)drain;
+
+@end
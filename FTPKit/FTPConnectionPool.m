@@ -0,0 +1,521 @@
+#import "FTPConnectionPool.h"
+#import "FTPKit+Protected.h"
+#import "NSError+Additions.h"
+
+// MARK: - FTPPooledConnection Class -
+/**
+ 풀에 보관되는 유휴 접속 정보
+ */
+@interface FTPPooledConnection : NSObject
+/// 로그인된 제어 접속
+@property (nonatomic) netbuf *conn;
+/// 마지막으로 반납된 시각
+@property (nonatomic) NSTimeInterval lastUsed;
+/// 마지막으로 서버 응답을 확인한 시각
+@property (nonatomic) NSTimeInterval lastActivity;
+@end
+
+@implementation FTPPooledConnection
+@end
+
+// MARK: - FTPHostShaper Class -
+/**
+ 같은 서버(host:port)의 풀들이 함께 적용받는 전송률 제한 그룹
+ */
+@interface FTPHostShaper : NSObject
+/// ftplib 전송률 제한 그룹
+@property (nonatomic) FtpShaper *shaper;
+/// 최대 전송률(bytes/초). 0 이면 제한하지 않는다
+@property (atomic) long long int rate;
+@end
+
+@implementation FTPHostShaper
+@end
+
+// MARK: - FTPConnectionPool Class -
+@interface FTPConnectionPool ()
+
+@property (nonatomic, strong) FTPCredentials *credentials;
+@property (nonatomic) int encoding;
+
+/** 유휴 접속 목록. 마지막 항목이 가장 최근에 반납된 접속 */
+@property (nonatomic, strong) NSMutableArray<FTPPooledConnection *> *idleConnections;
+
+/** idleConnections 접근을 직렬화하는 큐 */
+@property (nonatomic, strong) dispatch_queue_t lockQueue;
+
+/** 유휴 접속 NOOP 전송을 실행하는 큐 */
+@property (nonatomic, strong) dispatch_queue_t keepAliveQueue;
+
+/** 유휴 접속 NOOP 전송 타이머 */
+@property (nonatomic, strong) dispatch_source_t keepAliveTimer;
+
+/** 같은 서버의 풀들과 함께 적용받는 전송률 제한 그룹 */
+@property (nonatomic, strong) FTPHostShaper *hostShaper;
+
+@end
+
+@implementation FTPConnectionPool {
+    /** 로그인 직후의 작업 디렉토리 (서버 인코딩). 확인 전이면 빈 문자열. @synchronized(self) 안에서 접근한다 */
+    char _loginDirectory[TMP_BUFSIZ];
+}
+
+// MARK: - Initialization
++ (instancetype)poolForCredentials:(FTPCredentials *)credentials encoding:(int)encoding {
+    static NSMutableDictionary<NSString *, FTPConnectionPool *> *pools = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pools = [[NSMutableDictionary alloc] init];
+    });
+
+    NSString *key = [NSString stringWithFormat:@"%@:%@@%@:%d#%d",
+                     credentials.username,
+                     credentials.password,
+                     credentials.host,
+                     credentials.port,
+                     encoding];
+    @synchronized (pools) {
+        FTPConnectionPool *pool = pools[key];
+        if (pool == nil) {
+            pool = [[self alloc] initWithCredentials:credentials encoding:encoding];
+            pools[key] = pool;
+        }
+        return pool;
+    }
+}
+
+/**
+ 서버(host:port)의 전송률 제한 그룹을 반환. 없는 경우 생성한다.
+
+ 사용자/인코딩이 다른 풀도 같은 서버의 대역폭을 쓰므로 하나의 그룹을 공유한다.
+ */
++ (FTPHostShaper *)hostShaperForCredentials:(FTPCredentials *)credentials {
+    static NSMutableDictionary<NSString *, FTPHostShaper *> *shapers = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        shapers = [[NSMutableDictionary alloc] init];
+    });
+
+    NSString *key = [NSString stringWithFormat:@"%@:%d", credentials.host, credentials.port];
+    @synchronized (shapers) {
+        FTPHostShaper *hostShaper = shapers[key];
+        if (hostShaper == nil) {
+            hostShaper = [[FTPHostShaper alloc] init];
+            hostShaper.shaper = FtpShaperNew(0);
+            shapers[key] = hostShaper;
+        }
+        return hostShaper;
+    }
+}
+
+- (instancetype)initWithCredentials:(FTPCredentials *)credentials encoding:(int)encoding {
+    self = [super init];
+    if (self) {
+        _credentials = credentials;
+        _encoding = encoding;
+        _maximumIdleConnections = 4;
+        _idleTimeout = 60;
+        _healthCheckInterval = 15;
+        _idleConnections = [[NSMutableArray alloc] init];
+        _lockQueue = dispatch_queue_create("com.upstart-illustration-llc.FTPKitPoolQueue", DISPATCH_QUEUE_SERIAL);
+        _keepAliveQueue = dispatch_queue_create("com.upstart-illustration-llc.FTPKitKeepAliveQueue", DISPATCH_QUEUE_SERIAL);
+        _hostShaper = [[self class] hostShaperForCredentials:credentials];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_keepAliveTimer != nil) {
+        dispatch_source_cancel(_keepAliveTimer);
+    }
+    [self drain];
+}
+
++ (void)setGlobalMaximumBytesPerSecond:(long long int)rate {
+    FtpShaperRate(NULL, rate);
+}
+
+- (void)setMaximumBytesPerSecond:(long long int)maximumBytesPerSecond {
+    @synchronized (_hostShaper) {
+        _hostShaper.rate = maximumBytesPerSecond;
+        FtpShaperRate(_hostShaper.shaper, maximumBytesPerSecond);
+    }
+}
+
+- (long long int)maximumBytesPerSecond {
+    return _hostShaper.rate;
+}
+
+- (NSTimeInterval)keepAliveInterval {
+    __block NSTimeInterval interval = 0;
+    dispatch_sync(_lockQueue, ^{
+        interval = self->_keepAliveInterval;
+    });
+    return interval;
+}
+
+- (void)setKeepAliveInterval:(NSTimeInterval)keepAliveInterval {
+    dispatch_sync(_lockQueue, ^{
+        self->_keepAliveInterval = keepAliveInterval;
+        if (self.keepAliveTimer != nil) {
+            dispatch_source_cancel(self.keepAliveTimer);
+            self.keepAliveTimer = nil;
+        }
+        if (keepAliveInterval <= 0) {
+            return;
+        }
+        // 순환 참조 방지
+        __weak FTPConnectionPool *weakSelf = self;
+        dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.keepAliveQueue);
+        uint64_t interval = (uint64_t)(keepAliveInterval * NSEC_PER_SEC);
+        dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, interval), interval, interval / 10);
+        dispatch_source_set_event_handler(timer, ^{
+            [weakSelf sendKeepAlives];
+        });
+        dispatch_resume(timer);
+        self.keepAliveTimer = timer;
+    });
+}
+
+- (NSUInteger)idleConnectionCount {
+    __block NSUInteger count = 0;
+    dispatch_sync(_lockQueue, ^{
+        count = [self.idleConnections count];
+    });
+    return count;
+}
+
+// MARK: - Checkout / Checkin
+- (netbuf *)checkoutConnection:(NSError **)error {
+    return [self checkoutConnectionInDirectory:NULL error:error];
+}
+
+- (netbuf *)checkoutConnectionInDirectory:(const char *)directory error:(NSError **)error {
+    // 위치를 지정하지 않은 대여는 상대 경로를 쓸 수 있도록 로그인 디렉토리의 접속을 반환한다
+    char loginDirectory[TMP_BUFSIZ];
+    @synchronized (self) {
+        strcpy(loginDirectory, _loginDirectory);
+    }
+    const char *target = directory;
+    if (target == NULL &&
+        loginDirectory[0] != '\0') {
+        target = loginDirectory;
+    }
+    while (true) {
+        __block FTPPooledConnection *entry = nil;
+        dispatch_sync(_lockQueue, ^{
+            // 같은 디렉토리에 위치한 접속 중 가장 최근 접속을 우선
+            if (target != NULL) {
+                for (FTPPooledConnection *idleEntry in [self.idleConnections reverseObjectEnumerator]) {
+                    if (strcmp(idleEntry.conn->cwd, target) == 0) {
+                        entry = idleEntry;
+                        break;
+                    }
+                }
+            }
+            if (entry == nil) {
+                entry = [self.idleConnections lastObject];
+            }
+            if (entry != nil) {
+                [self.idleConnections removeObject:entry];
+            }
+        });
+        if (entry == nil) {
+            break;
+        }
+
+        NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+        // 유지 시간 초과시 종료 후 다음 접속 확인. 서버가 이미 끊었을 수 있으므로 QUIT 응답을 기다리지 않고 닫는다
+        if (now - entry.lastUsed > self.idleTimeout) {
+            [self discardConnection:entry.conn];
+            continue;
+        }
+        // 오래 응답이 없었던 접속은 NOOP으로 상태 확인. 응답이 늦거나 실패시 QUIT 없이 폐기
+        if (now - entry.lastActivity > self.healthCheckInterval &&
+            !FtpPing(FTPLIB_PING_TIMEOUT, entry.conn)) {
+            FKLogDebug(@"Discard stale pooled connection: %s", FtpLastResponse(entry.conn));
+            FtpClose(entry.conn);
+            continue;
+        }
+        // 다른 디렉토리로 이동한 접속은 로그인 디렉토리로 되돌린다. 실패시 QUIT 없이 폐기
+        if (directory == NULL &&
+            loginDirectory[0] != '\0' &&
+            strcmp(entry.conn->cwd, loginDirectory) != 0 &&
+            !FtpChdir(loginDirectory, entry.conn)) {
+            FKLogDebug(@"Discard pooled connection that cannot return to login directory: %s", FtpLastResponse(entry.conn));
+            FtpClose(entry.conn);
+            continue;
+        }
+        [self prepareConnection:entry.conn];
+        return entry.conn;
+    }
+    netbuf *conn = [self openConnection:error];
+    if (conn != NULL) {
+        [self recordLoginDirectory:conn];
+        [self prepareConnection:conn];
+    }
+    return conn;
+}
+
+- (void)checkinConnection:(netbuf *)conn reusable:(BOOL)reusable {
+    if (conn == NULL) {
+        return;
+    }
+    // 데이터 접속이 열려 있거나 응답 순서가 어긋난 경우는 재사용하지 않는다
+    // QUIT 응답을 기다리면 응답하지 않는 접속에서 멈추므로, 보내지 않고 바로 닫는다
+    if (reusable == false ||
+        conn->data != NULL ||
+        conn->desync != 0) {
+        [self discardConnection:conn];
+        return;
+    }
+
+    FTPPooledConnection *entry = [[FTPPooledConnection alloc] init];
+    entry.conn = conn;
+    entry.lastUsed = [NSDate timeIntervalSinceReferenceDate];
+    entry.lastActivity = entry.lastUsed;
+
+    NSMutableArray<FTPPooledConnection *> *evicted = [[NSMutableArray alloc] init];
+    dispatch_sync(_lockQueue, ^{
+        // 만료된 유휴 접속 정리
+        for (FTPPooledConnection *idleEntry in self.idleConnections) {
+            if (entry.lastUsed - idleEntry.lastUsed > self.idleTimeout) {
+                [evicted addObject:idleEntry];
+            }
+        }
+        [self.idleConnections removeObjectsInArray:evicted];
+
+        if ([self.idleConnections count] < self.maximumIdleConnections) {
+            [self.idleConnections addObject:entry];
+        }
+        else {
+            [evicted addObject:entry];
+        }
+    });
+
+    // 정리한 접속은 lockQueue 밖에서 QUIT 없이 닫는다
+    for (FTPPooledConnection *evictedEntry in evicted) {
+        [self discardConnection:evictedEntry.conn];
+    }
+}
+
+- (void)discardConnection:(netbuf *)conn {
+    if (conn == NULL) {
+        return;
+    }
+    FtpClose(conn);
+}
+
+- (void)drain {
+    __block NSArray<FTPPooledConnection *> *entries = nil;
+    dispatch_sync(_lockQueue, ^{
+        entries = [self.idleConnections copy];
+        [self.idleConnections removeAllObjects];
+    });
+    // 응답하지 않는 접속에서 멈추지 않도록 QUIT 없이 닫는다
+    for (FTPPooledConnection *entry in entries) {
+        [self discardConnection:entry.conn];
+    }
+}
+
+// MARK: - Keep Alive
+/**
+ 유휴 접속에 NOOP 전송. keepAliveTimer 에서 호출된다.
+
+ - 유지 시간을 초과한 접속은 QUIT 없이 종료
+ - NOOP 응답이 없거나 FTPLIB_PING_TIMEOUT 안에 오지 않는 접속은 폐기
+ */
+- (void)sendKeepAlives {
+    NSTimeInterval interval = self.keepAliveInterval;
+    NSTimeInterval idleTimeout = self.idleTimeout;
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+
+    // 확인 대상 접속은 NOOP 전송 중 대여되지 않도록 풀에서 잠시 꺼낸다
+    NSMutableArray<FTPPooledConnection *> *expired = [[NSMutableArray alloc] init];
+    NSMutableArray<FTPPooledConnection *> *targets = [[NSMutableArray alloc] init];
+    dispatch_sync(_lockQueue, ^{
+        for (FTPPooledConnection *entry in self.idleConnections) {
+            if (now - entry.lastUsed > idleTimeout) {
+                [expired addObject:entry];
+            }
+            else if (now - entry.lastActivity >= interval) {
+                [targets addObject:entry];
+            }
+        }
+        [self.idleConnections removeObjectsInArray:expired];
+        [self.idleConnections removeObjectsInArray:targets];
+    });
+
+    for (FTPPooledConnection *entry in expired) {
+        [self discardConnection:entry.conn];
+    }
+
+    NSMutableArray<FTPPooledConnection *> *alive = [[NSMutableArray alloc] init];
+    for (FTPPooledConnection *entry in targets) {
+        if (FtpKeepAlive(entry.conn)) {
+            entry.lastActivity = [NSDate timeIntervalSinceReferenceDate];
+            [alive addObject:entry];
+        }
+        else {
+            FKLogDebug(@"Evict pooled connection after failed NOOP: %s", FtpLastResponse(entry.conn));
+            [self discardConnection:entry.conn];
+        }
+    }
+    if ([alive count] == 0) {
+        return;
+    }
+
+    NSMutableArray<FTPPooledConnection *> *overflow = [[NSMutableArray alloc] init];
+    dispatch_sync(_lockQueue, ^{
+        [self.idleConnections addObjectsFromArray:alive];
+        // 최근 반납 순서 유지
+        [self.idleConnections sortUsingComparator:^NSComparisonResult(FTPPooledConnection *lhs, FTPPooledConnection *rhs) {
+            if (lhs.lastUsed < rhs.lastUsed) return NSOrderedAscending;
+            if (lhs.lastUsed > rhs.lastUsed) return NSOrderedDescending;
+            return NSOrderedSame;
+        }];
+        // NOOP 전송 중 반납된 접속으로 최대 수를 넘은 경우, 오래된 접속부터 정리
+        while ([self.idleConnections count] > self.maximumIdleConnections) {
+            [overflow addObject:[self.idleConnections firstObject]];
+            [self.idleConnections removeObjectAtIndex:0];
+        }
+    });
+    for (FTPPooledConnection *entry in overflow) {
+        [self discardConnection:entry.conn];
+    }
+}
+
+// MARK: - Private Methods
+/**
+ 새 접속의 작업 디렉토리를 로그인 디렉토리로 기록
+
+ - 처음 연 접속에서 PWD 로 확인하고, 같은 계정의 이후 접속에는 확인한 값을 그대로 기록한다
+ - PWD 를 지원하지 않는 서버는 확인하지 않으며, 위치를 지정하지 않은 대여는 이전처럼 아무 접속이나 반환한다
+
+ @param conn 로그인 직후의 접속
+ */
+- (void)recordLoginDirectory:(netbuf * _Nonnull)conn {
+    @synchronized (self) {
+        if (_loginDirectory[0] != '\0') {
+            strcpy(conn->cwd, _loginDirectory);
+            return;
+        }
+    }
+    char directory[TMP_BUFSIZ];
+    // FtpPwd 는 잘리지 않은 절대 경로인 경우에만 conn->cwd 에 기록한다
+    if (FtpPwd(directory, sizeof(directory), conn) &&
+        conn->cwd[0] != '\0') {
+        @synchronized (self) {
+            strcpy(_loginDirectory, conn->cwd);
+        }
+    }
+}
+
+/**
+ 대여 직전 접속 설정을 현재 풀 설정에 맞춘다
+
+ @param conn 대여할 접속
+ */
+- (void)prepareConnection:(netbuf * _Nonnull)conn {
+    // 긴 전송 중에도 제어 접속이 끊기지 않도록 NOOP 간격 지정
+    FtpOptions(FTPLIB_KEEPALIVE, (long)(self.keepAliveInterval * 1000), conn);
+    FtpOptions(FTPLIB_PASVPEER, self.ignoresPassiveHost, conn);
+    FtpOptions(FTPLIB_PREOPEN, self.preopensDataConnections, conn);
+    // 측정값은 접속에 보관되므로, 재사용되는 접속일수록 정확해진다
+    FtpOptions(FTPLIB_NODELAY, self.tunesSocketBuffers, conn);
+    FtpOptions(FTPLIB_SOCKBUF, self.tunesSocketBuffers ? -1 : 0, conn);
+    // 전송별 제한과 가중치는 대여한 FTPClient 가 지정한다
+    FtpOptions(FTPLIB_SHAPER, (long)self.hostShaper.shaper, conn);
+    FtpOptions(FTPLIB_RATELIMIT, 0, conn);
+    FtpOptions(FTPLIB_WEIGHT, 1, conn);
+}
+
+/**
+ 서버에 접속. useTLS 인 경우 AUTH TLS 까지 진행
+
+ @param host 서버 주소
+ @param error 에러 발생시, 에러값을 반환하는 이중 포인터
+ @return 성공시 netbuf 반환. 실패시 NULL 반환
+ */
+- (netbuf * _Nullable)connectToHost:(const char * _Nonnull)host error:(NSError * _Nullable * _Nullable)error {
+    netbuf *conn;
+    int stat = FtpConnect(host, &conn);
+    if (stat == 0) {
+        // @fixme We don't get the exact error code from the lib. Use a generic
+        // connection error.
+        if (error != NULL) {
+            *error = [NSError FTPKitErrorWithCode:10060];
+        }
+        return NULL;
+    }
+    if (self.useTLS) {
+        int flags = self.allowsInvalidCertificates ? FTPLIB_TLS_NOVERIFY : 0;
+        if (FtpAuthTLS(host, flags, conn) == 0) {
+            NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
+            if (error != NULL) {
+                *error = [NSError FTPKitErrorWithResponse:response];
+            }
+            // TLS 상태를 알 수 없으므로 QUIT 없이 종료
+            FtpClose(conn);
+            return NULL;
+        }
+    }
+    return conn;
+}
+
+/**
+ 새 접속을 생성하고 로그인까지 진행
+
+ @param error 에러 발생시, 에러값을 반환하는 이중 포인터
+ @return 성공시 netbuf 반환. 실패시 NULL 반환
+ */
+- (netbuf * _Nullable)openConnection:(NSError * _Nullable * _Nullable)error {
+    const char *host = [_credentials.host cStringUsingEncoding:_encoding];
+    const char *user = [_credentials.username cStringUsingEncoding:_encoding];
+    const char *pass = [_credentials.password cStringUsingEncoding:_encoding];
+    netbuf *conn = [self connectToHost:host error:error];
+    if (conn == NULL) {
+        return NULL;
+    }
+    int stat;
+    if (self.pipelinedLogin) {
+        stat = FtpLoginPipelined(user, pass, FTPLIB_IMAGE, _encoding == NSUTF8StringEncoding, conn);
+        if (stat != 0) {
+            return conn;
+        }
+        // 암호 오류(530)는 재시도해도 같으므로 바로 에러 처리
+        if (strncmp(FtpLastResponse(conn), "530", 3) == 0) {
+            NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
+            if (error != NULL) {
+                *error = [NSError FTPKitErrorWithResponse:response];
+            }
+            // 남은 응답을 읽지 못한 접속은 QUIT 없이 종료
+            if (conn->desync != 0) {
+                FtpClose(conn);
+            }
+            else {
+                FtpQuit(conn);
+            }
+            return NULL;
+        }
+        // 파이프라이닝을 거부하거나 응답하지 않는 서버로 간주하고 재접속 후 일반 로그인
+        FKLogDebug(@"Pipelined login failed, fallback: %s", FtpLastResponse(conn));
+        FtpClose(conn);
+        conn = [self connectToHost:host error:error];
+        if (conn == NULL) {
+            return NULL;
+        }
+    }
+    stat = FtpLogin(user, pass, conn);
+    if (stat == 0) {
+        NSString *response = [NSString stringWithCString:FtpLastResponse(conn) encoding:_encoding];
+        if (error != NULL) {
+            *error = [NSError FTPKitErrorWithResponse:response];
+        }
+        FtpQuit(conn);
+        return NULL;
+    }
+    return conn;
+}
+
+@end
@@ -0,0 +1,85 @@
+/**
+ 이어받기용 다운로드 저널.
+
+ 저장 파일 옆(<저장 경로>.ftpjournal)에 원격 경로, 원격 파일 크기/수정일과 디스크에 기록이 확인된
+ 구간 목록을 보관한다. 프로세스가 재시작된 뒤에도 원격 파일이 바뀌지 않았다면 기록된 구간을 건너뛰고
+ 남은 구간만 REST 로 이어받을 수 있다.
+ */
+
+#import <Foundation/Foundation.h>
+
+@interface FTPDownloadJournal : NSObject
+
+/** 저널 파일 경로 */
+@property (nonatomic, readonly) NSString * _Nonnull journalPath;
+
+/** 원격 파일 경로 */
+@property (nonatomic, readonly) NSString * _Nonnull remotePath;
+
+/** 원격 파일 크기 */
+@property (nonatomic, readonly) long long int fileSize;
+
+/** 원격 파일 수정일 (MDTM 응답). 서버가 MDTM 을 지원하지 않으면 빈 문자열 */
+@property (nonatomic, readonly) NSString * _Nonnull modificationDate;
+
+/** 디스크에 기록이 확인된 구간. [시작, 끝) 쌍의 배열이며 시작 위치 순으로 병합되어 있다 */
+@property (nonatomic, readonly) NSArray<NSArray<NSNumber *> *> * _Nonnull committedRanges;
+
+/**
+ 저장 경로에 해당하는 저널 파일 경로 반환
+
+ @param savePath 다운로드 파일 저장 경로
+ @return 저널 파일 경로
+ */
++ (NSString * _Nonnull)journalPathForSavePath:(NSString * _Nonnull)savePath;
+
+/**
+ 저장 경로의 저널을 읽는다.
+
+ - 저널이 없거나 읽을 수 없는 경우 nil 반환
+ - 원격 경로, 크기, 수정일 중 하나라도 다르면 원격 파일이 바뀐 것이므로 nil 반환
+
+ @param savePath 다운로드 파일 저장 경로
+ @param remotePath 원격 파일 경로
+ @param fileSize 현재 원격 파일 크기
+ @param modificationDate 현재 원격 파일 수정일
+ @return FTPDownloadJournal. 이어받을 수 없는 경우 nil
+ */
++ (instancetype _Nullable)journalAtSavePath:(NSString * _Nonnull)savePath
+                                 remotePath:(NSString * _Nonnull)remotePath
+                                   fileSize:(long long int)fileSize
+                           modificationDate:(NSString * _Nonnull)modificationDate;
+
+/**
+ 기록된 구간이 없는 새 저널 생성. commitRanges:fileDescriptor: 호출 전까지는 저장되지 않는다.
+
+ @param savePath 다운로드 파일 저장 경로
+ @param remotePath 원격 파일 경로
+ @param fileSize 원격 파일 크기
+ @param modificationDate 원격 파일 수정일
+ @return FTPDownloadJournal
+ */
+- (instancetype _Nonnull)initWithSavePath:(NSString * _Nonnull)savePath
+                               remotePath:(NSString * _Nonnull)remotePath
+                                 fileSize:(long long int)fileSize
+                         modificationDate:(NSString * _Nonnull)modificationDate;
+
+/** 기록이 확인된 전체 길이 */
+- (long long int)committedLength;
+
+/**
+ 저장 파일을 디스크에 동기화(fsync)한 뒤 구간 목록을 저널에 기록.
+
+ - 동기화에 성공한 경우만 저널을 갱신하므로, 저널에 있는 구간은 항상 디스크에 있다
+ - 저널 파일은 임시 파일에 쓴 뒤 교체하므로, 도중에 중단되어도 이전 저널이 유지된다
+
+ @param ranges 파일에 쓴 구간. 기존 구간과 병합된다
+ @param fd 저장 파일 디스크립터
+ @return 성공시 true
+ */
+- (BOOL)commitRanges:(NSArray<NSArray<NSNumber *> *> * _Nonnull)ranges fileDescriptor:(int)fd;
+
+/** 저널 파일 삭제. 다운로드 완료시 호출한다 */
+- (void)remove;
+
+@end
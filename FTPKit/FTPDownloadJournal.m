@@ -0,0 +1,162 @@
+#import "FTPDownloadJournal.h"
+#import "FTPKit+Protected.h"
+
+static NSString * const kJournalRemotePathKey = @"remotePath";
+static NSString * const kJournalFileSizeKey = @"fileSize";
+static NSString * const kJournalModificationDateKey = @"modificationDate";
+static NSString * const kJournalRangesKey = @"ranges";
+
+@interface FTPDownloadJournal ()
+
+@property (nonatomic, strong) NSString *journalPath;
+@property (nonatomic, strong) NSString *remotePath;
+@property (nonatomic) long long int fileSize;
+@property (nonatomic, strong) NSString *modificationDate;
+@property (nonatomic, strong) NSArray<NSArray<NSNumber *> *> *committedRanges;
+
+@end
+
+@implementation FTPDownloadJournal
+
+// MARK: - Initialization
++ (NSString *)journalPathForSavePath:(NSString *)savePath {
+    return [savePath stringByAppendingPathExtension:@"ftpjournal"];
+}
+
++ (instancetype)journalAtSavePath:(NSString *)savePath
+                       remotePath:(NSString *)remotePath
+                         fileSize:(long long int)fileSize
+                 modificationDate:(NSString *)modificationDate {
+    NSData *data = [NSData dataWithContentsOfFile:[self journalPathForSavePath:savePath]];
+    if (data == nil) {
+        return nil;
+    }
+    NSDictionary *dictionary = [NSPropertyListSerialization propertyListWithData:data
+                                                                          options:NSPropertyListImmutable
+                                                                           format:NULL
+                                                                            error:NULL];
+    if ([dictionary isKindOfClass:[NSDictionary class]] == false) {
+        // 기록 도중 중단된 저널은 사용하지 않는다
+        return nil;
+    }
+    // 원격 파일이 바뀐 경우 이어받을 수 없다
+    if ([dictionary[kJournalRemotePathKey] isEqual:remotePath] == false ||
+        [dictionary[kJournalFileSizeKey] longLongValue] != fileSize ||
+        [dictionary[kJournalModificationDateKey] isEqual:modificationDate] == false) {
+        return nil;
+    }
+
+    NSMutableArray<NSArray<NSNumber *> *> *ranges = [[NSMutableArray alloc] init];
+    for (NSArray<NSNumber *> *range in dictionary[kJournalRangesKey]) {
+        if ([range isKindOfClass:[NSArray class]] == false ||
+            [range count] != 2) {
+            return nil;
+        }
+        long long int start = [range[0] longLongValue];
+        long long int end = [range[1] longLongValue];
+        if (start < 0 ||
+            end > fileSize ||
+            start >= end) {
+            return nil;
+        }
+        [ranges addObject:@[@(start), @(end)]];
+    }
+
+    FTPDownloadJournal *journal = [[self alloc] initWithSavePath:savePath
+                                                      remotePath:remotePath
+                                                        fileSize:fileSize
+                                                modificationDate:modificationDate];
+    journal.committedRanges = [self mergeRanges:ranges];
+    return journal;
+}
+
+- (instancetype)initWithSavePath:(NSString *)savePath
+                      remotePath:(NSString *)remotePath
+                        fileSize:(long long int)fileSize
+                modificationDate:(NSString *)modificationDate {
+    self = [super init];
+    if (self) {
+        _journalPath = [[self class] journalPathForSavePath:savePath];
+        _remotePath = remotePath;
+        _fileSize = fileSize;
+        _modificationDate = modificationDate;
+        _committedRanges = @[];
+    }
+    return self;
+}
+
+// MARK: - Methods
+- (long long int)committedLength {
+    long long int length = 0;
+    for (NSArray<NSNumber *> *range in self.committedRanges) {
+        length += [range[1] longLongValue] - [range[0] longLongValue];
+    }
+    return length;
+}
+
+- (BOOL)commitRanges:(NSArray<NSArray<NSNumber *> *> *)ranges fileDescriptor:(int)fd {
+    // 저널보다 데이터가 먼저 디스크에 있어야 한다
+    if (fsync(fd) != 0) {
+        FKLogError(@"Failed to sync download file: %s", strerror(errno));
+        return false;
+    }
+    NSArray<NSArray<NSNumber *> *> *merged = [[self class] mergeRanges:[self.committedRanges arrayByAddingObjectsFromArray:ranges]];
+    NSDictionary *dictionary = @{kJournalRemotePathKey: self.remotePath,
+                                 kJournalFileSizeKey: @(self.fileSize),
+                                 kJournalModificationDateKey: self.modificationDate,
+                                 kJournalRangesKey: merged};
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:dictionary
+                                                              format:NSPropertyListBinaryFormat_v1_0
+                                                             options:0
+                                                               error:NULL];
+    if (data == nil ||
+        [data writeToFile:self.journalPath options:NSDataWritingAtomic error:NULL] == false) {
+        FKLogError(@"Failed to write download journal: %@", self.journalPath);
+        return false;
+    }
+    self.committedRanges = merged;
+    return true;
+}
+
+- (void)remove {
+    [[NSFileManager defaultManager] removeItemAtPath:self.journalPath error:NULL];
+}
+
+// MARK: - Private Methods
+/**
+ 구간을 시작 위치 순으로 정렬하고, 겹치거나 이어지는 구간을 합친다
+
+ @param ranges [시작, 끝) 쌍의 배열
+ @return 병합된 구간 배열
+ */
++ (NSArray<NSArray<NSNumber *> *> *)mergeRanges:(NSArray<NSArray<NSNumber *> *> *)ranges {
+    NSArray<NSArray<NSNumber *> *> *sorted = [ranges sortedArrayUsingComparator:^NSComparisonResult(NSArray<NSNumber *> *lhs, NSArray<NSNumber *> *rhs) {
+        return [lhs[0] compare:rhs[0]];
+    }];
+    NSMutableArray<NSArray<NSNumber *> *> *merged = [[NSMutableArray alloc] init];
+    long long int start = -1;
+    long long int end = -1;
+    for (NSArray<NSNumber *> *range in sorted) {
+        long long int rangeStart = [range[0] longLongValue];
+        long long int rangeEnd = [range[1] longLongValue];
+        if (rangeStart >= rangeEnd) {
+            continue;
+        }
+        if (start >= 0 &&
+            rangeStart <= end) {
+            end = MAX(end, rangeEnd);
+            continue;
+        }
+        if (start >= 0) {
+            [merged addObject:@[@(start), @(end)]];
+        }
+        start = rangeStart;
+        end = rangeEnd;
+    }
+    if (start >= 0) {
+        [merged addObject:@[@(start), @(end)]];
+    }
+    return merged;
+}
+
+@end
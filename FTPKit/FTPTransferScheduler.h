@@ -0,0 +1,97 @@
+/**
+ 우선순위별로 FTPClient 의 비동기 작업을 실행하는 스케줄러.
+
+ 작업은 제한된 수의 작업자에서 동시에 실행되며, 대기 중인 작업 중 우선순위가 높은 작업부터 시작한다.
+ 같은 우선순위에서는 먼저 추가된 작업이 먼저 시작된다. 호스트별 동시 실행 수를 제한해서
+ 서버의 접속 수 제한을 넘지 않도록 한다.
+ */
+
+#import <Foundation/Foundation.h>
+
+/// 작업 우선순위
+typedef enum {
+    // 사용자가 결과를 기다리는 작업 (목록, 디렉토리 생성/삭제 등)
+    FTPPriorityInteractive          = 0,
+    // 일반 파일 전송
+    FTPPriorityDefault              = 1,
+    // 미리 받기 등 결과를 바로 기다리지 않는 작업
+    FTPPriorityBackground           = 2,
+} FTPPriority;
+
+// MARK: - FTPScheduledJob Class -
+/**
+ 스케줄러에 추가된 작업
+ */
+@interface FTPScheduledJob : NSObject
+
+/** 작업 대상 호스트 */
+@property (nonatomic, readonly) NSString * _Nonnull host;
+
+/**
+ 작업 우선순위.
+
+ 대기 중인 작업의 우선순위를 바꾸면 다음 작업을 고를 때 바로 반영된다. 이미 시작된 작업에는 영향이 없다.
+ */
+@property (atomic) FTPPriority priority;
+
+/** 취소 여부 */
+@property (atomic, readonly, getter=isCancelled) BOOL cancelled;
+
+/** 실행 중이거나 완료된 경우 true */
+@property (atomic, readonly, getter=isStarted) BOOL started;
+
+/**
+ 작업 취소.
+
+ 작업 블록은 취소된 경우에도 한 번 실행되므로, 블록 안에서 isCancelled 를 확인해서 자원을 정리하고 완료 핸들러를 호출해야 한다.
+ 대기 중인 작업은 가장 높은 우선순위로 바로 실행된다.
+ */
+- (void)cancel;
+
+@end
+
+// MARK: - FTPTransferScheduler Class -
+@interface FTPTransferScheduler : NSObject
+
+/** 동시에 실행할 최대 작업 수. 기본값은 8. */
+@property (atomic) NSUInteger maximumConcurrentJobs;
+
+/**
+ 호스트별 동시에 실행할 최대 작업 수. 기본값은 4.
+
+ 1 로 지정하면 같은 호스트의 작업이 추가된 순서대로 하나씩 실행된다.
+ */
+@property (atomic) NSUInteger maximumJobsPerHost;
+
+/**
+ FTPPriorityInteractive 작업을 위해 비워 두는 작업자 수. 기본값은 1.
+
+ 다른 우선순위의 작업은 전체 및 호스트별 최대 작업 수에서 이 값을 뺀 만큼만 동시에 실행되므로,
+ 큰 파일 전송이 작업자를 모두 차지하고 있어도 목록 요청은 기다리지 않고 시작된다.
+ */
+@property (atomic) NSUInteger reservedInteractiveJobs;
+
+/** 대기 중인 작업 수 */
+@property (nonatomic, readonly) NSUInteger pendingJobCount;
+
+/** 실행 중인 작업 수 */
+@property (nonatomic, readonly) NSUInteger runningJobCount;
+
+/**
+ FTPClient 가 기본으로 사용하는 공유 스케줄러 반환
+ */
++ (instancetype _Nonnull)sharedScheduler;
+
+/**
+ 작업 추가.
+
+ @param host 작업 대상 호스트. 호스트별 최대 작업 수 제한에 사용한다
+ @param priority 작업 우선순위
+ @param block 작업 블록. 백그라운드 큐에서 한 번 실행된다
+ @return 추가된 작업
+ */
+- (FTPScheduledJob * _Nonnull)scheduleJobForHost:(NSString * _Nonnull)host
+                                        priority:(FTPPriority)priority
+                                           block:(void (^ _Nonnull)(FTPScheduledJob * _Nonnull job))block;
+
+@end
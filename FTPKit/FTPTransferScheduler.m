@@ -0,0 +1,199 @@
+#import "FTPTransferScheduler.h"
+
+// MARK: - FTPScheduledJob Class -
+@interface FTPScheduledJob ()
+
+@property (nonatomic, strong) NSString *host;
+@property (nonatomic, copy) void (^block)(FTPScheduledJob *job);
+@property (atomic, readwrite, getter=isCancelled) BOOL cancelled;
+@property (atomic, readwrite, getter=isStarted) BOOL started;
+/** 우선순위 변경/취소를 알릴 스케줄러 */
+@property (nonatomic, weak) FTPTransferScheduler *scheduler;
+
+@end
+
+@interface FTPTransferScheduler ()
+
+/** 대기 중인 작업. 추가된 순서로 보관한다 */
+@property (nonatomic, strong) NSMutableArray<FTPScheduledJob *> *pendingJobs;
+
+/** 호스트별 실행 중인 작업 수 */
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *runningJobsPerHost;
+
+/** 실행 중인 작업 수 */
+@property (nonatomic) NSUInteger running;
+
+/** pendingJobs, runningJobsPerHost, running 접근을 직렬화하는 큐 */
+@property (nonatomic, strong) dispatch_queue_t lockQueue;
+
+- (void)jobDidChange;
+
+@end
+
+@implementation FTPScheduledJob {
+    FTPPriority _priority;
+}
+
+- (FTPPriority)priority {
+    @synchronized (self) {
+        return _priority;
+    }
+}
+
+- (void)setPriority:(FTPPriority)priority {
+    @synchronized (self) {
+        _priority = priority;
+    }
+    [self.scheduler jobDidChange];
+}
+
+- (void)cancel {
+    self.cancelled = true;
+    [self.scheduler jobDidChange];
+}
+
+@end
+
+// MARK: - FTPTransferScheduler Class -
+@implementation FTPTransferScheduler
+
+// MARK: - Initialization
++ (instancetype)sharedScheduler {
+    static FTPTransferScheduler *scheduler = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        scheduler = [[self alloc] init];
+    });
+    return scheduler;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _maximumConcurrentJobs = 8;
+        _maximumJobsPerHost = 4;
+        _reservedInteractiveJobs = 1;
+        _pendingJobs = [[NSMutableArray alloc] init];
+        _runningJobsPerHost = [[NSMutableDictionary alloc] init];
+        _lockQueue = dispatch_queue_create("com.upstart-illustration-llc.FTPKitSchedulerQueue", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+// MARK: - Methods
+- (NSUInteger)pendingJobCount {
+    __block NSUInteger count = 0;
+    dispatch_sync(_lockQueue, ^{
+        count = [self.pendingJobs count];
+    });
+    return count;
+}
+
+- (NSUInteger)runningJobCount {
+    __block NSUInteger count = 0;
+    dispatch_sync(_lockQueue, ^{
+        count = self.running;
+    });
+    return count;
+}
+
+- (FTPScheduledJob *)scheduleJobForHost:(NSString *)host
+                               priority:(FTPPriority)priority
+                                  block:(void (^)(FTPScheduledJob *))block {
+    FTPScheduledJob *job = [[FTPScheduledJob alloc] init];
+    job.host = host;
+    job.priority = priority;
+    job.block = block;
+    job.scheduler = self;
+    dispatch_async(_lockQueue, ^{
+        [self.pendingJobs addObject:job];
+        [self startPendingJobs];
+    });
+    return job;
+}
+
+// MARK: - Private Methods
+- (void)jobDidChange {
+    dispatch_async(_lockQueue, ^{
+        [self startPendingJobs];
+    });
+}
+
+/**
+ 시작할 수 있는 대기 작업을 우선순위 순으로 시작. lockQueue 에서 호출해야 한다
+ */
+- (void)startPendingJobs {
+    while (true) {
+        FTPScheduledJob *job = [self nextPendingJob];
+        if (job == nil) {
+            return;
+        }
+        [self.pendingJobs removeObjectIdenticalTo:job];
+        self.running++;
+        self.runningJobsPerHost[job.host] = @([self.runningJobsPerHost[job.host] unsignedIntegerValue] + 1);
+        job.started = true;
+
+        dispatch_qos_class_t qos = QOS_CLASS_UTILITY;
+        if (job.isCancelled == true ||
+            job.priority == FTPPriorityInteractive) {
+            qos = QOS_CLASS_USER_INITIATED;
+        } else if (job.priority == FTPPriorityBackground) {
+            qos = QOS_CLASS_BACKGROUND;
+        }
+        dispatch_async(dispatch_get_global_queue(qos, 0), ^{
+            job.block(job);
+            job.block = nil;
+            dispatch_async(self.lockQueue, ^{
+                self.running--;
+                NSUInteger count = [self.runningJobsPerHost[job.host] unsignedIntegerValue] - 1;
+                if (count == 0) {
+                    [self.runningJobsPerHost removeObjectForKey:job.host];
+                } else {
+                    self.runningJobsPerHost[job.host] = @(count);
+                }
+                [self startPendingJobs];
+            });
+        });
+    }
+}
+
+/**
+ 다음에 시작할 대기 작업 반환. lockQueue 에서 호출해야 한다
+
+ - 취소된 작업은 자원을 정리하기만 하므로 제한 없이 가장 먼저 시작한다
+ - FTPPriorityInteractive 가 아닌 작업은 reservedInteractiveJobs 만큼 작업자를 남겨 둔다
+
+ @return 시작할 수 있는 작업이 없으면 nil
+ */
+- (FTPScheduledJob *)nextPendingJob {
+    NSUInteger maximum = MAX(self.maximumConcurrentJobs, 1);
+    NSUInteger perHost = MAX(self.maximumJobsPerHost, 1);
+    NSUInteger reserved = self.reservedInteractiveJobs;
+    FTPScheduledJob *next = nil;
+    FTPPriority nextPriority = FTPPriorityBackground;
+    for (FTPScheduledJob *job in self.pendingJobs) {
+        if (job.isCancelled == true) {
+            return job;
+        }
+        FTPPriority priority = job.priority;
+        if (next != nil &&
+            priority >= nextPriority) {
+            continue;
+        }
+        NSUInteger limit = maximum;
+        NSUInteger hostLimit = perHost;
+        if (priority != FTPPriorityInteractive) {
+            limit = maximum > reserved ? maximum - reserved : 1;
+            hostLimit = perHost > reserved ? perHost - reserved : perHost;
+        }
+        if (self.running >= limit ||
+            [self.runningJobsPerHost[job.host] unsignedIntegerValue] >= hostLimit) {
+            continue;
+        }
+        next = job;
+        nextPriority = priority;
+    }
+    return next;
+}
+
+@end
@@ -4,6 +4,34 @@
 #define kFTPKitRequestBufferSize 32768
 #define kFTPKitTempBufferSize 1024
 
+// 분할 다운로드 구간의 최소 크기. 이보다 작은 구간은 다시 나누지 않는다
+#define kFTPKitMinimumSegmentSize 1048576
+// 분할 다운로드 접속 수를 조정하기 위한 전송률 측정 간격(초)
+#define kFTPKitSegmentSampleInterval 1.0
+// 이어받기 저널을 기록하는 간격(bytes)
+#define kFTPKitJournalInterval 8388608
+// 전송 재시도 대기 시간(초). 재시도마다 두 배씩 늘어난다
+#define kFTPKitRetryInitialDelay 0.5
+#define kFTPKitRetryMaximumDelay 8.0
+// 소켓에서 파일로 바로 저장할 때 한 번에 읽는 최대 길이(bytes)
+#define kFTPKitReadChunkSize 262144
+// 파일에서 소켓으로 바로 보낼 때 한 번에 보내는 최대 길이(bytes). 진행률 갱신 간격이 된다
+#define kFTPKitWriteChunkSize 262144
+// 스트리밍 다운로드에서 한 번에 전달하는 최대 길이(bytes)
+#define kFTPKitStreamChunkSize 65536
+// 스트리밍 다운로드 일시정지 중 접속 유지(NOOP)를 확인하는 간격(초)
+#define kFTPKitStreamPauseInterval 1.0
+// 디렉토리 탐색 최대 깊이. 디렉토리 심볼릭 링크의 순환을 끊는다
+#define kFTPKitTraversalMaximumDepth 64
+// 디렉토리 탐색 작업자가 공유하는 대기 목록의 최대 크기. 넘치는 하위 디렉토리는 찾은 작업자가 직접 탐색한다
+#define kFTPKitTraversalFrontierLimit 4096
+// 미러링에서 같은 수정일로 보는 차이(초)
+#define kFTPKitMirrorTimeTolerance 1.0
+// 미러링에서 받는 중인 임시 파일 확장자
+#define kFTPKitMirrorTemporaryExtension @"ftpmirror"
+// 전송 NSProgress 의 userInfo 에 스케줄러 작업을 보관하는 키
+#define kFTPKitScheduledJobKey @"FTPKitScheduledJob"
+
 //#define FKLog(level, msg) NSLog(@"FTPKit: (%@) %@", level, msg)
 #define FKLogDebug(frmt, ...) NSLog(@"FTPKit: (Debug) %@", [NSString stringWithFormat:frmt, ##__VA_ARGS__])
 #define FKLogInfo(frmt, ...) NSLog(@"FTPKit: (Info) %@", [NSString stringWithFormat:frmt, ##__VA_ARGS__])
@@ -17,6 +17,10 @@
 /*                                                                         */
 /***************************************************************************/
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// splice(), sendfile() 사용
+#define _GNU_SOURCE
+#endif
 #if defined(__unix__) || defined(__VMS) || defined(__APPLE__)
 #include <unistd.h>
 #endif
@@ -33,8 +37,20 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <pthread.h>
+#define FTPLIB_USE_PTHREAD
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#define FTPLIB_USE_SPLICE
+#define FTPLIB_USE_SENDFILE
+#elif defined(__APPLE__)
+#include <sys/uio.h>
+#define FTPLIB_USE_SENDFILE
+#endif
 #elif defined(VMS)
 #include <types.h>
 #include <socket.h>
@@ -42,16 +58,22 @@
 #include <netdb.h>
 #include <inet.h>
 #elif defined(_WIN32)
-#include <winsock.h>
-#endif
-#if defined(__APPLE__)
-// Apple does not have some *_r (reentran) functions in lib.
-#undef _REENTRANT
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #endif
 
 #define BUILDING_LIBRARY
 #include "ftplib.h"
 
+#if defined(FTPLIB_USE_OPENSSL)
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+// 커널 TLS 가 적용된 데이터 접속은 splice/SSL_sendfile 로 사용자 영역을 거치지 않고 전송한다
+#if defined(__linux__) && !defined(OPENSSL_NO_KTLS) && (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+#define FTPLIB_USE_KTLS
+#endif
+#endif
+
 #if defined(__UINT64_MAX) && !defined(PRIu64)
 #if ULONG_MAX == __UINT32_MAX
 #define PRIu64 "llu"
@@ -82,6 +104,11 @@
 #define FTPLIB_DEFMODE FTPLIB_PASSIVE
 #endif
 
+// FtpConnect 에서 해석할 주소 체계. 기본값은 IPv4/IPv6 모두 사용
+#if !defined FTPLIB_ADDRESS_FAMILY
+#define FTPLIB_ADDRESS_FAMILY AF_UNSPEC
+#endif
+
 // FTP Parse 도입
 #import "ftpparse.h"
 
@@ -106,144 +133,6 @@ char *strdup(const char *src)
 }
 #endif
 
-/* Start: Apple lu_utils.c */
-#define LU_COPY_STRING(x) strdup(((x) == NULL) ? "" : x)
-
-static void
-free_service_data(struct servent *s)
-{
-    char **aliases;
-    
-    if (s == NULL) return;
-    
-    if (s->s_name != NULL) free(s->s_name);
-    if (s->s_proto != NULL) free(s->s_proto);
-    
-    aliases = s->s_aliases;
-    if (aliases != NULL)
-    {
-        while (*aliases != NULL) free(*aliases++);
-        free(s->s_aliases);
-    }
-}
-
-static void
-free_service(struct servent *s)
-{
-    if (s == NULL) return;
-    free_service_data(s);
-    free(s);
-}
-
-static struct servent *
-copy_service(struct servent *in)
-{
-    int i, len;
-    struct servent *s;
-    
-    if (in == NULL) return NULL;
-    if (in == NULL) return NULL;
-    
-    s = (struct servent *)calloc(1, sizeof(struct servent));
-    
-    s->s_name = LU_COPY_STRING(in->s_name);
-    
-    len = 0;
-    if (in->s_aliases != NULL)
-    {
-        for (len = 0; in->s_aliases[len] != NULL; len++);
-    }
-    
-    s->s_aliases = (char **)calloc(len + 1, sizeof(char *));
-    for (i = 0; i < len; i++)
-    {
-        s->s_aliases[i] = strdup(in->s_aliases[i]);
-    }
-    
-    s->s_proto = LU_COPY_STRING(in->s_proto);
-    s->s_port = in->s_port;
-    
-    return s;
-}
-/* End: Apple lu_utils.c */
-
-/* Start: Apple lu_host.c */
-__private_extern__ void
-free_host_data(struct hostent *h)
-{
-    char **aliases;
-    int i;
-    
-    if (h == NULL) return;
-    
-    if (h->h_name != NULL) free(h->h_name);
-    
-    aliases = h->h_aliases;
-    if (aliases != NULL)
-    {
-        while (*aliases != NULL) free(*aliases++);
-        free(h->h_aliases);
-    }
-    
-    if (h->h_addr_list != NULL)
-    {
-        for (i = 0; h->h_addr_list[i] != NULL; i++) free(h->h_addr_list[i]);
-        free(h->h_addr_list);
-    }
-}
-
-void
-free_hostent(struct hostent *h)
-{
-    if (h == NULL) return;
-    free_host_data(h);
-    free(h);
-}
-
-static struct hostent *
-copy_hostent(struct hostent *in)
-{
-    int i, len, addr_len;
-    struct hostent *h;
-    
-    if (in == NULL) return NULL;
-    
-    h = (struct hostent *)calloc(1, sizeof(struct hostent));
-    
-    h->h_name = LU_COPY_STRING(in->h_name);
-    
-    len = 0;
-    if (in->h_aliases != NULL)
-    {
-        for (len = 0; in->h_aliases[len] != NULL; len++);
-    }
-    
-    h->h_aliases = (char **)calloc(len + 1, sizeof(char *));
-    for (i = 0; i < len; i++)
-    {
-        h->h_aliases[i] = strdup(in->h_aliases[i]);
-    }
-    
-    h->h_addrtype = in->h_addrtype;
-    h->h_length = in->h_length;
-    
-    len = 0;
-    if (in->h_addr_list != NULL)
-    {
-        for (len = 0; in->h_addr_list[len] != NULL; len++);
-    }
-    
-    addr_len = sizeof(u_long *);
-    h->h_addr_list = (char **)calloc(len + 1, addr_len);
-    for (i = 0; i < len; i++)
-    {
-        h->h_addr_list[i] = (char *)malloc(h->h_length);
-        memmove(h->h_addr_list[i], in->h_addr_list[i], h->h_length);
-    }
-    
-    return h;
-}
-/* End: Apple lu_host.c */
 
 #if defined(__unix__) || defined(VMS) || defined(__APPLE__)
 int net_read(int fd, char *buf, size_t len)
@@ -295,6 +184,190 @@ int net_write(int fd, const char *buf, size_t len)
 #define net_close closesocket
 #endif
 
+/*
+ * 소켓 non-blocking 설정
+ */
+static int set_nonblock(int fd, int on)
+{
+#if defined(_WIN32)
+    u_long mode = on;
+    return ioctlsocket(fd, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1)
+        return 0;
+    flags = on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(fd, F_SETFL, flags) != -1;
+#endif
+}
+
+#if defined(FTPLIB_USE_OPENSSL)
+/*
+ * OpenSSL 에러를 response 에 기록
+ */
+static void tls_error(const char *what, netbuf *nControl)
+{
+    unsigned long e = ERR_get_error();
+    
+    snprintf(nControl->response, sizeof(nControl->response), "%s: %s\n",
+             what, e ? ERR_reason_error_string(e) : "TLS error");
+    ERR_clear_error();
+    if (ftplib_debug)
+        fprintf(stderr, "%s", nControl->response);
+}
+
+/*
+ * TLS 종료. close_notify 를 보내고 SSL 객체를 해제한다
+ *
+ * 데이터 접속인 경우, TLS 1.3 에서 새로 받은 세션 티켓을 다음 데이터 접속에서 재사용하도록
+ * 제어 접속에 보관한다
+ */
+static void tls_close(netbuf *nb)
+{
+    SSL_SESSION *session;
+    
+    if (nb->tls == NULL)
+        return;
+    if ((nb->dir != FTPLIB_CONTROL) && (nb->ctrl != NULL))
+    {
+        // 업로드 접속은 읽지 않으므로 서버가 보낸 세션 티켓이 수신 버퍼에 남아 있다.
+        // 읽지 않은 데이터가 남은 채로 닫으면 RST 가 전송되어 서버가 받지 못한 데이터를 버릴 수 있으므로,
+        // 블로킹 없이 처리해서 티켓도 받고 버퍼도 비운다
+        if (nb->dir == FTPLIB_WRITE && set_nonblock(nb->handle, 1))
+        {
+            char drain[256];
+            while (SSL_read((SSL *)nb->tls, drain, sizeof(drain)) > 0)
+                ;
+            ERR_clear_error();
+        }
+        session = SSL_get1_session((SSL *)nb->tls);
+        if ((session != NULL) && SSL_SESSION_is_resumable(session))
+        {
+            if (nb->ctrl->tlssession != NULL)
+                SSL_SESSION_free((SSL_SESSION *)nb->ctrl->tlssession);
+            nb->ctrl->tlssession = session;
+        }
+        else if (session != NULL)
+            SSL_SESSION_free(session);
+    }
+    SSL_shutdown((SSL *)nb->tls);
+    SSL_free((SSL *)nb->tls);
+    nb->tls = NULL;
+    if (nb->tlssession != NULL)
+    {
+        SSL_SESSION_free((SSL_SESSION *)nb->tlssession);
+        nb->tlssession = NULL;
+    }
+}
+
+/*
+ * 데이터 접속 TLS 핸드셰이크
+ *
+ * 제어 접속의 세션을 재사용해서 전체 핸드셰이크를 생략한다.
+ * 세션 재사용을 요구하는 서버(vsftpd require_ssl_reuse 등)도 이 방식이어야 접속할 수 있다.
+ *
+ * return 1 if successful, 0 otherwise
+ */
+static int tls_connect_data(netbuf *nData, netbuf *nControl)
+{
+    SSL *ctrl = (SSL *)nControl->tls;
+    SSL *ssl;
+    SSL_SESSION *session;
+    
+    ssl = SSL_new(SSL_get_SSL_CTX(ctrl));
+    if (ssl == NULL)
+    {
+        tls_error("SSL_new", nControl);
+        return 0;
+    }
+    // 제어 접속과 같은 서버 이름으로 확인
+    X509_VERIFY_PARAM_set1(SSL_get0_param(ssl), SSL_get0_param(ctrl));
+    if (SSL_get_servername(ctrl, TLSEXT_NAMETYPE_host_name) != NULL)
+        SSL_set_tlsext_host_name(ssl, SSL_get_servername(ctrl, TLSEXT_NAMETYPE_host_name));
+    // 이전 데이터 접속에서 받은 세션을 우선 사용
+    if (nControl->tlssession != NULL)
+        SSL_set_session(ssl, (SSL_SESSION *)nControl->tlssession);
+    else
+    {
+        session = SSL_get1_session(ctrl);
+        if (session != NULL)
+        {
+            SSL_set_session(ssl, session);
+            SSL_SESSION_free(session);
+        }
+    }
+    SSL_set_fd(ssl, nData->handle);
+    if (SSL_connect(ssl) != 1)
+    {
+        tls_error("Data connection TLS handshake failed", nControl);
+        SSL_free(ssl);
+        return 0;
+    }
+    if (ftplib_debug > 1)
+        fprintf(stderr, "Data connection TLS session %s\n",
+                SSL_session_reused(ssl) ? "reused" : "negotiated");
+    nData->tls = ssl;
+    return 1;
+}
+#endif
+
+/*
+ * netbuf 읽기. TLS 가 설정된 경우 SSL_read 를 사용한다
+ *
+ * return -1 on error, 0 on EOF or bytecount
+ */
+static int nb_read(netbuf *nb, char *buf, size_t len)
+{
+#if defined(FTPLIB_USE_OPENSSL)
+    if (nb->tls != NULL)
+    {
+        int c;
+        errno = 0;
+        c = SSL_read((SSL *)nb->tls, buf, (int)len);
+        if (c > 0)
+            return c;
+        switch (SSL_get_error((SSL *)nb->tls, c))
+        {
+            case SSL_ERROR_ZERO_RETURN:
+                return 0;
+            case SSL_ERROR_SYSCALL:
+                // close_notify 없이 종료하는 서버
+                if (ERR_peek_error() == 0 && errno == 0)
+                    return 0;
+            default:
+                ERR_clear_error();
+                return -1;
+        }
+    }
+#endif
+    return net_read(nb->handle, buf, len);
+}
+
+/*
+ * netbuf 쓰기. TLS 가 설정된 경우 SSL_write 를 사용한다
+ *
+ * return -1 on error or bytecount
+ */
+static int nb_write(netbuf *nb, const char *buf, size_t len)
+{
+#if defined(FTPLIB_USE_OPENSSL)
+    if (nb->tls != NULL)
+    {
+        int c;
+        if (len == 0)
+            return 0;
+        c = SSL_write((SSL *)nb->tls, buf, (int)len);
+        if (c <= 0)
+        {
+            ERR_clear_error();
+            return -1;
+        }
+        return c;
+    }
+#endif
+    return net_write(nb->handle, buf, len);
+}
+
 #if defined(NEED_MEMCCPY)
 /*
  * VAX C does not supply a memccpy routine so I provide my own
@@ -317,28 +390,56 @@ void *memccpy(void *dest, const void *src, int c, size_t n)
 }
 #endif
 
+/*
+ * ftp_now - 현재 시각을 밀리초로 반환
+ */
+static long long int ftp_now(void)
+{
+#if defined(_WIN32)
+    return (long long int)GetTickCount();
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (long long int)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#endif
+}
+
 /*
  * socket_wait - wait for socket to receive or flush data
  *
  * return 1 if no user callback, otherwise, return value returned by
- * user callback
+ * user callback. return 0 if stalltime elapsed without progress
  */
 static int socket_wait(netbuf *ctl)
 {
     fd_set fd,*rfd = NULL,*wfd = NULL;
     struct timeval tv;
     int rv = 0;
-    if ((ctl->dir == FTPLIB_CONTROL) || (ctl->idlecb == NULL))
+    long long int start;
+    if ((ctl->dir == FTPLIB_CONTROL) ||
+        ((ctl->idlecb == NULL) && (ctl->stalltime == 0)))
         return 1;
     if (ctl->dir == FTPLIB_WRITE)
         wfd = &fd;
     else
         rfd = &fd;
+#if defined(FTPLIB_USE_OPENSSL)
+    // TLS 레코드가 이미 복호화되어 남아 있는 경우 소켓은 읽을 데이터가 없어도 바로 읽을 수 있다
+    if ((rfd != NULL) && (ctl->tls != NULL) && SSL_pending((SSL *)ctl->tls))
+        return 1;
+#endif
     FD_ZERO(&fd);
-    do
+    start = ftp_now();
+    for (;;)
     {
         FD_SET(ctl->handle,&fd);
-        tv = ctl->idletime;
+        if (ctl->idlecb != NULL)
+            tv = ctl->idletime;
+        else
+        {
+            tv.tv_sec = ctl->stalltime / 1000;
+            tv.tv_usec = (ctl->stalltime % 1000) * 1000;
+        }
         rv = select(ctl->handle+1, rfd, wfd, NULL, &tv);
         if (rv == -1)
         {
@@ -352,8 +453,19 @@ static int socket_wait(netbuf *ctl)
             rv = 1;
             break;
         }
+        // 정체 판단 시간 동안 데이터가 오가지 않은 경우 중지
+        if ((ctl->stalltime > 0) && (ftp_now() - start >= ctl->stalltime))
+        {
+            ctl->stalled = 1;
+            sprintf(ctl->ctrl->response, "Data connection stalled for %d ms\n",
+                    ctl->stalltime);
+            rv = 0;
+            break;
+        }
+        if ((ctl->idlecb != NULL) &&
+            !(rv = ctl->idlecb(ctl, (fsz_t)ctl->xfered, ctl->idlearg)))
+            break;
     }
-    while ((rv = ctl->idlecb(ctl, (fsz_t)ctl->xfered, ctl->idlearg)));
     return rv;
 }
 
@@ -417,7 +529,7 @@ static int readline(char *buf, int max, netbuf *ctl)
         }
         if (!socket_wait(ctl))
             return retval;
-        if ((x = net_read(ctl->handle,ctl->cput,ctl->cleft)) == -1)
+        if ((x = nb_read(ctl,ctl->cput,ctl->cleft)) == -1)
         {
             if (ftplib_debug)
                 perror("read");
@@ -457,7 +569,7 @@ static int writeline(const char *buf, int len, netbuf *nData)
             {
                 if (!socket_wait(nData))
                     return x;
-                w = net_write(nData->handle, nbp, FTPLIB_BUFSIZ);
+                w = nb_write(nData, nbp, FTPLIB_BUFSIZ);
                 if (w != FTPLIB_BUFSIZ)
                 {
                     if (ftplib_debug)
@@ -472,7 +584,7 @@ static int writeline(const char *buf, int len, netbuf *nData)
         {
             if (!socket_wait(nData))
                 return x;
-            w = net_write(nData->handle, nbp, FTPLIB_BUFSIZ);
+            w = nb_write(nData, nbp, FTPLIB_BUFSIZ);
             if (w != FTPLIB_BUFSIZ)
             {
                 if (ftplib_debug)
@@ -487,7 +599,7 @@ static int writeline(const char *buf, int len, netbuf *nData)
     {
         if (!socket_wait(nData))
             return x;
-        w = net_write(nData->handle, nbp, nb);
+        w = nb_write(nData, nbp, nb);
         if (w != nb)
         {
             if (ftplib_debug)
@@ -501,12 +613,18 @@ static int writeline(const char *buf, int len, netbuf *nData)
 /*
  * read a response from the server
  *
+ * 여러 줄 응답의 중간 줄 (FEAT 목록, MLST 사실 등) 은 body 가 NULL 이 아니면
+ * 받은 그대로 (줄 끝 포함) body 에 모은다
+ *
  * return 0 if first char doesn't match
  * return 1 if first char matches
  */
-static int readresp(char c, netbuf *nControl)
+static int readresp_body(char c, netbuf *nControl, char *body, int max)
 {
     char match[5];
+    int len = 0;
+    if (body != NULL && max > 0)
+        body[0] = '\0';
     if (readline(nControl->response,RESPONSE_BUFSIZ,nControl) == -1)
     {
         if (ftplib_debug)
@@ -520,7 +638,7 @@ static int readresp(char c, netbuf *nControl)
         strncpy(match,nControl->response,3);
         match[3] = ' ';
         match[4] = '\0';
-        do
+        while (1)
         {
             if (readline(nControl->response,RESPONSE_BUFSIZ,nControl) == -1)
             {
@@ -530,8 +648,19 @@ static int readresp(char c, netbuf *nControl)
             }
             if (ftplib_debug > 1)
                 fprintf(stderr,"%s",nControl->response);
+            if (!strncmp(nControl->response,match,4))
+                break;
+            // 중간 줄은 body 에 이어 붙인다. 넘치는 줄은 버린다
+            if (body != NULL)
+            {
+                int l = strlen(nControl->response);
+                if (len + l < max)
+                {
+                    memcpy(body + len, nControl->response, l + 1);
+                    len += l;
+                }
+            }
         }
-        while (strncmp(nControl->response,match,4));
     }
     if (nControl->response[0] == c)
         return 1;
@@ -539,377 +668,1718 @@ static int readresp(char c, netbuf *nControl)
 }
 
 /*
- * FtpInit for stupid operating systems that require it (Windows NT)
+ * read a response from the server
+ *
+ * return 0 if first char doesn't match
+ * return 1 if first char matches
  */
-GLOBALDEF void FtpInit(void)
+static int readresp(char c, netbuf *nControl)
 {
-#if defined(_WIN32)
-    WORD wVersionRequested;
-    WSADATA wsadata;
-    int err;
-    wVersionRequested = MAKEWORD(1,1);
-    if ((err = WSAStartup(wVersionRequested,&wsadata)) != 0)
-        fprintf(stderr,"Network failed to start: %d\n",err);
-#endif
+    return readresp_body(c, nControl, NULL, 0);
 }
 
 /*
- * FtpLastResponse - return a pointer to the last response received
+ * 제어 접속에 응답이 도착할 때까지 대기
+ *
+ * return 1 if a response can be read, 0 on timeout or error
  */
-GLOBALDEF char *FtpLastResponse(netbuf *nControl)
+static int reply_wait(netbuf *nControl, int ms)
 {
-    if ((nControl) && (nControl->dir == FTPLIB_CONTROL))
-        return nControl->response;
-    return NULL;
+    fd_set fd;
+    struct timeval tv;
+    if (nControl->cavail > 0)
+        return 1;
+#if defined(FTPLIB_USE_OPENSSL)
+    if ((nControl->tls != NULL) && SSL_pending((SSL *)nControl->tls))
+        return 1;
+#endif
+    FD_ZERO(&fd);
+    FD_SET(nControl->handle, &fd);
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    return select(nControl->handle + 1, &fd, NULL, NULL, &tv) > 0;
 }
 
 /*
- * FtpConnect - connect to remote server
+ * 전송 중 보낸 NOOP 응답을 모두 읽는다
  *
- * return 1 if connected, 0 if not
+ * NOOP 응답(200)과 전송 결과 응답은 서버에 따라 순서가 다르므로,
+ * NOOP 응답이 아닌 마지막 응답을 response 에 남긴다
+ *
+ * return rv if every response is positive, 0 otherwise
  */
-GLOBALDEF int FtpConnect(const char *host, netbuf **nControl)
+static int readresp_noops(int rv, netbuf *nControl)
 {
-    int sControl;
-    struct sockaddr_in sin;
-    int on = 1;
-    /** Timeout after 20 seconds.
-     
-     The link below provides instruction on using select() to monitor
-     connections after a given timeout.
-     http://stackoverflow.com/questions/4181784/how-to-set-socket-timeout-in-c-when-making-multiple-connections
-     
-     struct timeval timeout;
-     timeout.tv_sec = 20;
-     timeout.tv_usec = 0; */
-    netbuf *ctrl;
-    char *lhost;
-    char *pnum;
+    char result[RESPONSE_BUFSIZ];
     
-    memset(&sin,0,sizeof(sin));
-    sin.sin_family = AF_INET;
-    lhost = strdup(host);
-    pnum = strchr(lhost,':');
-    if (pnum == NULL)
-        pnum = "ftp";
-    else
-        *pnum++ = '\0';
-    if (isdigit(*pnum))
-        sin.sin_port = htons(atoi(pnum));
-    else
+    if (nControl->noops == 0)
+        return rv;
+    strncpy(result, nControl->response, sizeof(result));
+    while (nControl->noops > 0)
     {
-        
-#if _REENTRANT
-        struct servent *pse;
-        struct servent se;
-        char tmpbuf[TMP_BUFSIZ];
-        int i;
-        if ( ( i = getservbyname_r(pnum,"tcp",&se,tmpbuf,TMP_BUFSIZ,&tpse) ) != 0 )
-        {
-            errno = i;
-            if ( ftplib_debug )
-                perror("getservbyname_r");
-            free(lhost);
-            return 0;
-        }
-#else
-        struct servent *tpse, *pse;
-        if ((tpse = getservbyname(pnum,"tcp") ) == NULL )
-        {
-            if ( ftplib_debug )
-                perror("getservbyname");
-            free(lhost);
-            return 0;
-        }
-        /*
-         * Copy struct to allow the call to be used in future callbacks. This
-         * also makes it thread-safe.
-         *
-         * From man page:
-         * These functions use a thread-specific data storage; if the data is
-         * needed for future use, it should be copied before any subsequent calls
-         * overwrite it.  Expecting port numbers to fit in a 32 bit quantity is
-         * probably naive.
-         *
-         * Also, it is not necessary to release tpse as it is part of a static
-         * struct held by getservbyname().
-         */
-        pse = copy_service(tpse);
-#endif
-        sin.sin_port = pse->s_port;
-#ifndef _REENTRANT
-        free_service(pse);
-#endif
-        
+        nControl->noops--;
+        if (!readresp('2', nControl))
+            rv = 0;
+        if (strncmp(nControl->response, "200", 3) != 0)
+            strncpy(result, nControl->response, sizeof(result));
     }
-    if ((sin.sin_addr.s_addr = inet_addr(lhost)) == INADDR_NONE)
-    {
-#ifdef _REENTRANT
-        struct hostent *phe;
-        struct hostent he;
-        char tmpbuf[TMP_BUFSIZ];
-        int i, herr;
-        if ( ( i = gethostbyname_r( lhost, &he, tmpbuf, TMP_BUFSIZ, &phe, &herr ) ) != 0 )
-        {
-            if ( ftplib_debug )
-                fprintf(stderr, "gethostbyname: %s\n", hstrerror(herr));
-            free(lhost);
-            return 0;
-        }
-#else
-        struct hostent *tphe, *phe;
-        if ((tphe = gethostbyname(lhost)) == NULL)
-        {
-            if (ftplib_debug)
-                fprintf(stderr, "gethostbyname: %s\n", hstrerror(h_errno));
-            free(lhost);
+    strncpy(nControl->response, result, sizeof(nControl->response));
+    return rv;
+}
+
+/*
+ * 미리 열어 둔 데이터 접속 종료
+ */
+static void preopen_discard(netbuf *nControl)
+{
+    if (!nControl->hasspare)
+        return;
+    net_close(nControl->spare);
+    nControl->hasspare = 0;
+}
+
+/*
+ * 세션 상태를 바꾸는 명령을 보내기 전에 기억하고 있던 상태를 무효화한다
+ *
+ * 상태를 확인할 수 있는 명령은 응답 확인 후 호출한 쪽에서 다시 기록한다
+ */
+static int is_cmd(const char *cmd, const char *name)
+{
+    while (*name)
+        if (toupper((unsigned char)*cmd++) != *name++)
             return 0;
-        }
-        phe = copy_hostent(tphe);
-#endif
-        memcpy((char *)&sin.sin_addr, phe->h_addr_list[0], phe->h_length);
-#ifndef _REENTRANT
-        free_hostent(phe);
-#endif
-    }
-    free(lhost);
-    sControl = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+    return (*cmd == '\0') || (*cmd == ' ');
+}
+
+static void invalidate_state(const char *cmd, netbuf *nControl)
+{
+    if (is_cmd(cmd, "TYPE") || is_cmd(cmd, "USER") || is_cmd(cmd, "REIN"))
+    {
+        nControl->type = 0;
+        nControl->cwd[0] = '\0';
+    }
+    else if (is_cmd(cmd, "CWD") || is_cmd(cmd, "XCWD") ||
+             is_cmd(cmd, "CDUP") || is_cmd(cmd, "XCUP"))
+        nControl->cwd[0] = '\0';
+    // 로그인 전후로 FEAT 응답이 달라지는 서버가 있다
+    if (is_cmd(cmd, "USER") || is_cmd(cmd, "REIN"))
+        nControl->features = 0;
+    // 새 데이터 접속 명령은 미리 열어 둔 접속을 무효화한다
+    if (is_cmd(cmd, "PASV") || is_cmd(cmd, "EPSV") ||
+        is_cmd(cmd, "PORT") || is_cmd(cmd, "EPRT") ||
+        is_cmd(cmd, "USER") || is_cmd(cmd, "REIN"))
+        preopen_discard(nControl);
+}
+
+/*
+ * FtpType - TYPE 전송. 이미 같은 모드인 경우 생략한다
+ *
+ * return 1 if successful, 0 otherwise
+ */
+static int FtpType(char mode, netbuf *nControl)
+{
+    char buf[8];
+    
+    if (nControl->type == mode)
+        return 1;
+    sprintf(buf, "TYPE %c", mode);
+    if (!FtpSendCmd(buf, '2', nControl))
+        return 0;
+    nControl->type = mode;
+    return 1;
+}
+
+/*
+ * 확인된 작업 디렉토리 기록. 절대 경로만 기록하고, 끝의 '/'는 제거한다
+ */
+static void set_cwd(const char *path, netbuf *nControl)
+{
+    size_t l = strlen(path);
+    
+    if ((path[0] != '/') || (l >= sizeof(nControl->cwd)))
+    {
+        nControl->cwd[0] = '\0';
+        return;
+    }
+    strcpy(nControl->cwd, path);
+    while ((l > 1) && (nControl->cwd[l - 1] == '/'))
+        nControl->cwd[--l] = '\0';
+}
+
+/*
+ * 데이터 전송 중 NOOP 전송 시간이 지났으면 응답을 기다리지 않고 NOOP 전송
+ */
+static void data_keepalive(netbuf *nData)
+{
+    netbuf *ctrl = nData->ctrl;
+    if ((ctrl == NULL) || (ctrl->keepalive <= 0))
+        return;
+    if (ftp_now() - ctrl->lastcmd < ctrl->keepalive)
+        return;
+    if (ftplib_debug > 2)
+        fprintf(stderr,"NOOP\n");
+    if (nb_write(ctrl, "NOOP\r\n", 6) == 6)
+        ctrl->noops++;
+    ctrl->lastcmd = ftp_now();
+}
+
+/*
+ * 전송률 제한 그룹
+ *
+ * 그룹의 전송률을 사용 중인 전송들이 가중치에 비례해서 나눠 가진다 (가중치 공정 큐잉).
+ * 몫보다 적게 쓰는 전송의 남는 몫은 나머지 전송들이 나눠 가지며, 전송이 끝나면 남은 전송들의 몫이 바로 늘어난다.
+ */
+struct FtpShaper {
+    long long int rate;
+};
+
+static FtpShaper shaper_global = { 0 };
+// 전송률 제한에 등록된 데이터 접속 목록 (netbuf.shapelist 로 연결)
+static netbuf *shaper_list = NULL;
+#if defined(FTPLIB_USE_PTHREAD)
+static pthread_mutex_t shaper_lock = PTHREAD_MUTEX_INITIALIZER;
+#define SHAPER_LOCK() pthread_mutex_lock(&shaper_lock)
+#define SHAPER_UNLOCK() pthread_mutex_unlock(&shaper_lock)
+#else
+#define SHAPER_LOCK()
+#define SHAPER_UNLOCK()
+#endif
+
+/*
+ * FtpShaperNew - create a bandwidth group
+ */
+GLOBALDEF FtpShaper *FtpShaperNew(long long int rate)
+{
+    FtpShaper *shaper = calloc(1, sizeof(FtpShaper));
+    if (shaper == NULL)
+    {
+        if (ftplib_debug)
+            perror("calloc");
+        return NULL;
+    }
+    shaper->rate = rate > 0 ? rate : 0;
+    return shaper;
+}
+
+/*
+ * FtpShaperRate - change the rate of a bandwidth group
+ *
+ * NULL 인 경우 전역 제한을 변경한다
+ */
+GLOBALDEF void FtpShaperRate(FtpShaper *shaper, long long int rate)
+{
+    SHAPER_LOCK();
+    (shaper ? shaper : &shaper_global)->rate = rate > 0 ? rate : 0;
+    SHAPER_UNLOCK();
+}
+
+/*
+ * FtpShaperFree - release a bandwidth group
+ */
+GLOBALDEF void FtpShaperFree(FtpShaper *shaper)
+{
+    free(shaper);
+}
+
+/*
+ * 데이터 접속을 전송률 제한에 등록
+ */
+static void shape_start(netbuf *nData)
+{
+    nData->shapenext = 0;
+    nData->shapewindow = 0;
+    nData->shapebytes = 0;
+    nData->shapedemand = 0;
+    SHAPER_LOCK();
+    nData->shapelist = shaper_list;
+    shaper_list = nData;
+    SHAPER_UNLOCK();
+    nData->shaping = 1;
+}
+
+/*
+ * 데이터 접속을 전송률 제한에서 제외
+ */
+static void shape_stop(netbuf *nData)
+{
+    netbuf **link;
+    if (!nData->shaping)
+        return;
+    SHAPER_LOCK();
+    for (link = &shaper_list; *link != NULL; link = &(*link)->shapelist)
+    {
+        if (*link == nData)
+        {
+            *link = nData->shapelist;
+            break;
+        }
+    }
+    SHAPER_UNLOCK();
+    nData->shapelist = NULL;
+    nData->shaping = 0;
+}
+
+/*
+ * 두 전송률 중 작은 값. 0 은 제한 없음
+ */
+static long long int shape_min(long long int a, long long int b)
+{
+    if (a <= 0)
+        return b;
+    return (b <= 0 || a < b) ? a : b;
+}
+
+static long long int shape_share(const FtpShaper *shaper, netbuf *nData);
+
+/*
+ * 그룹 안에서 이 전송이 실제로 쓸 수 있는 최대 전송률. SHAPER_LOCK 상태에서 호출한다
+ *
+ * 전송별 제한, 측정한 사용량 (서버나 디스크가 느린 경우), 전역 제한 계산시에는 접속 그룹의 몫 중 작은 값.
+ * 0 이면 제한 없음
+ */
+static long long int shape_cap(const FtpShaper *shaper, netbuf *nData)
+{
+    long long int cap = shape_min(nData->ratelimit, nData->shapedemand);
+    if ((shaper == &shaper_global) && (nData->shaper != NULL))
+        cap = shape_min(cap, shape_share(nData->shaper, nData));
+    return cap;
+}
+
+/*
+ * 그룹의 전송률 중 이 전송의 몫. SHAPER_LOCK 상태에서 호출한다
+ *
+ * 최대 전송률이 가중치 몫보다 작은 전송은 최대 전송률만 받고, 남은 전송률을 나머지 전송들이
+ * 가중치에 비례해서 다시 나눈다 (water-filling). 0 이면 제한 없음
+ */
+static long long int shape_share(const FtpShaper *shaper, netbuf *nData)
+{
+    long long int rate = shaper->rate, share;
+    int weight = 0, changed = 1;
+    // 전역 제한 계산 중에 접속 그룹의 몫을 계산하므로, 계산용 필드를 단계별로 따로 쓴다
+    int level = (shaper == &shaper_global) ? 0 : 1;
+    netbuf *n;
+    if (rate <= 0)
+        return 0;
+    for (n = shaper_list; n != NULL; n = n->shapelist)
+    {
+        if (level && (n->shaper != shaper))
+            continue;
+        n->shapecap[level] = shape_cap(shaper, n);
+        n->shapefixed[level] = 0;
+        weight += n->weight;
+    }
+    while (changed && (weight > 0))
+    {
+        changed = 0;
+        for (n = shaper_list; n != NULL; n = n->shapelist)
+        {
+            if ((level && (n->shaper != shaper)) || n->shapefixed[level])
+                continue;
+            // 최대 전송률이 현재 몫 (rate * weight / 전체 weight) 이하
+            if ((n->shapecap[level] > 0) && (n->shapecap[level] * weight <= rate * n->weight))
+            {
+                n->shapefixed[level] = 1;
+                rate -= n->shapecap[level];
+                weight -= n->weight;
+                changed = 1;
+            }
+        }
+    }
+    if (nData->shapefixed[level] || (weight <= 0))
+        share = nData->shapecap[level];
+    else
+        share = rate * nData->weight / weight;
+    return (share < 1) ? 1 : share;
+}
+
+/*
+ * 현재 이 전송에 적용할 전송률 (bytes/초)
+ *
+ * 전송별 제한, 전역 제한과 그룹 제한의 몫 중 가장 작은 값. 0 이면 제한 없음
+ */
+static long long int shape_rate(netbuf *nData)
+{
+    long long int rate = nData->ratelimit;
+    if (!nData->shaping)
+        return 0;
+    SHAPER_LOCK();
+    rate = shape_min(rate, shape_share(&shaper_global, nData));
+    if (nData->shaper)
+        rate = shape_min(rate, shape_share(nData->shaper, nData));
+    SHAPER_UNLOCK();
+    return rate;
+}
+
+/*
+ * 전송 사용량 측정
+ *
+ * FTPLIB_SHAPE_WINDOW 마다 실제 전송률을 확인해서, 받은 몫의 90% 도 쓰지 못한 경우는
+ * 실제 전송률보다 조금 높은 값을 최대 전송률로 기록해서 남는 몫을 다른 전송이 쓰게 한다.
+ * 몫을 다 쓰게 되면 제한을 풀어서 다시 가중치 몫을 받는다
+ */
+static void shape_measure(netbuf *nData, int len, long long int rate, double now)
+{
+    long long int measured;
+    if (nData->shapewindow == 0)
+        nData->shapewindow = now;
+    nData->shapebytes += len;
+    if (now - nData->shapewindow < FTPLIB_SHAPE_WINDOW)
+        return;
+    measured = (long long int)(nData->shapebytes * 1000 / (now - nData->shapewindow));
+    SHAPER_LOCK();
+    nData->shapedemand = (measured * 10 < rate * 9) ? measured + measured / 4 + 1 : 0;
+    SHAPER_UNLOCK();
+    nData->shapewindow = now;
+    nData->shapebytes = 0;
+}
+
+/*
+ * 전송률 제한시 한 번에 전송할 최대 길이
+ *
+ * 한 번의 전송이 FTPLIB_SHAPE_BURST 보다 길어지지 않도록 나눈다
+ */
+static int shape_max(netbuf *nData, int max)
+{
+    long long int rate = shape_rate(nData), lim;
+    if (rate <= 0)
+        return max;
+    lim = rate * FTPLIB_SHAPE_BURST / 1000;
+    if (lim < TMP_BUFSIZ)
+        lim = TMP_BUFSIZ;
+    return (max > lim) ? (int)lim : max;
+}
+
+/*
+ * 전송한 길이만큼 전송률 제한 대기
+ *
+ * 전송마다 다음 전송 가능 시각을 앞당기는 토큰 버킷. 쉬는 동안 쌓인 여유는
+ * FTPLIB_SHAPE_BURST 까지만 인정한다
+ */
+static void shape_wait(netbuf *nData, int len)
+{
+    long long int rate;
+    double now, wait;
+#if !defined(_WIN32)
+    struct timeval tv;
+#endif
+    if (len <= 0)
+        return;
+    rate = shape_rate(nData);
+    if (rate <= 0)
+        return;
+    now = (double)ftp_now();
+    shape_measure(nData, len, rate, now);
+    if (nData->shapenext < now - FTPLIB_SHAPE_BURST)
+        nData->shapenext = now - FTPLIB_SHAPE_BURST;
+    nData->shapenext += (double)len * 1000 / rate;
+    wait = nData->shapenext - now;
+    if (wait < 1)
+        return;
+#if defined(_WIN32)
+    Sleep((DWORD)wait);
+#else
+    tv.tv_sec = (long)(wait / 1000);
+    tv.tv_usec = ((long)wait % 1000) * 1000;
+    select(0, NULL, NULL, NULL, &tv);
+#endif
+}
+
+/*
+ * 데이터 전송 길이 반영. 전송 중 NOOP 과 전송량 콜백을 처리한다
+ *
+ * return 0 if user callback aborted the transfer, 1 otherwise
+ */
+static int data_progress(netbuf *nData, int len)
+{
+    shape_wait(nData, len);
+    data_keepalive(nData);
+    nData->xfered += len;
+    if (nData->idlecb && nData->cbbytes)
+    {
+        nData->xfered1 += len;
+        if (nData->xfered1 > nData->cbbytes)
+        {
+            if (nData->idlecb(nData, (fsz_t)nData->xfered, nData->idlearg) == 0)
+                return 0;
+            nData->xfered1 = 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * FtpInit for stupid operating systems that require it (Windows NT)
+ */
+GLOBALDEF void FtpInit(void)
+{
+#if defined(_WIN32)
+    WORD wVersionRequested;
+    WSADATA wsadata;
+    int err;
+    wVersionRequested = MAKEWORD(1,1);
+    if ((err = WSAStartup(wVersionRequested,&wsadata)) != 0)
+        fprintf(stderr,"Network failed to start: %d\n",err);
+#endif
+}
+
+/*
+ * FtpLastResponse - return a pointer to the last response received
+ */
+GLOBALDEF char *FtpLastResponse(netbuf *nControl)
+{
+    if ((nControl) && (nControl->dir == FTPLIB_CONTROL))
+        return nControl->response;
+    return NULL;
+}
+
+/*
+ * 주소 해석 결과 캐시
+ *
+ * getaddrinfo 는 TTL 을 알려주지 않으므로 resolver_ttl 동안만 결과를 재사용한다.
+ * 모든 주소로 접속에 실패한 경우에는 바로 무효화한다.
+ */
+#define FTPLIB_MAX_ADDRS 16
+
+struct ftp_addr {
+    struct sockaddr_storage ss;
+    socklen_t len;
+};
+
+struct ftp_addrcache {
+    struct ftp_addrcache *next;
+    char *key;
+    long long int expires;
+    int count;
+    struct ftp_addr addr[FTPLIB_MAX_ADDRS];
+};
+
+static struct ftp_addrcache *resolver_cache = NULL;
+static int resolver_ttl = FTPLIB_RESOLVER_TTL;
+#if defined(FTPLIB_USE_PTHREAD)
+static pthread_mutex_t resolver_lock = PTHREAD_MUTEX_INITIALIZER;
+#define RESOLVER_LOCK() pthread_mutex_lock(&resolver_lock)
+#define RESOLVER_UNLOCK() pthread_mutex_unlock(&resolver_lock)
+#else
+#define RESOLVER_LOCK()
+#define RESOLVER_UNLOCK()
+#endif
+
+/*
+ * 캐시 항목 제거. RESOLVER_LOCK 상태에서 호출한다
+ */
+static void resolver_remove(const char *key)
+{
+    struct ftp_addrcache **pp = &resolver_cache, *p;
+    long long int now = ftp_now();
+    
+    while ((p = *pp) != NULL)
+    {
+        if (((key != NULL) && (strcmp(p->key, key) == 0)) ||
+            ((key == NULL) && (p->expires <= now)))
+        {
+            *pp = p->next;
+            free(p->key);
+            free(p);
+        }
+        else
+            pp = &p->next;
+    }
+}
+
+/*
+ * FtpResolverCache - set resolver cache lifetime
+ *
+ * 0 으로 지정하면 캐시를 사용하지 않고, 보관 중인 항목도 모두 제거한다
+ */
+GLOBALDEF void FtpResolverCache(int ttl)
+{
+    struct ftp_addrcache *p;
+    
+    RESOLVER_LOCK();
+    resolver_ttl = ttl;
+    if (ttl <= 0)
+    {
+        while ((p = resolver_cache) != NULL)
+        {
+            resolver_cache = p->next;
+            free(p->key);
+            free(p);
+        }
+    }
+    RESOLVER_UNLOCK();
+}
+
+/*
+ * 같은 주소 체계가 연달아 오지 않도록 정렬
+ *
+ * getaddrinfo 가 정렬한 첫 주소 체계부터 IPv6/IPv4 를 번갈아 시도한다 (RFC 8305)
+ */
+static void interleave_addrs(struct ftp_addr *addr, int count)
+{
+    struct ftp_addr tmp[FTPLIB_MAX_ADDRS];
+    int used[FTPLIB_MAX_ADDRS] = { 0 };
+    int i, n = 0, family = addr[0].ss.ss_family;
+    
+    while (n < count)
+    {
+        for (i = 0; i < count; i++)
+            if (!used[i] && (addr[i].ss.ss_family == family))
+                break;
+        if (i == count)
+            for (i = 0; used[i]; i++)
+                ;
+        used[i] = 1;
+        tmp[n++] = addr[i];
+        family = (addr[i].ss.ss_family == AF_INET6) ? AF_INET : AF_INET6;
+    }
+    memcpy(addr, tmp, sizeof(struct ftp_addr) * count);
+}
+
+/*
+ * host:port 주소 해석. 캐시에 있는 경우 캐시 결과를 사용한다
+ *
+ * return number of addresses, 0 on error
+ */
+static int resolve_host(const char *lhost, const char *pnum, struct ftp_addr *addr, int *cached)
+{
+    struct addrinfo hints, *res, *ai;
+    struct ftp_addrcache *p;
+    char key[TMP_BUFSIZ];
+    int count = 0, rv;
+    
+    *cached = 0;
+    snprintf(key, sizeof(key), "%s:%s", lhost, pnum);
+    RESOLVER_LOCK();
+    resolver_remove(NULL);
+    for (p = resolver_cache; p != NULL; p = p->next)
+    {
+        if (strcmp(p->key, key) == 0)
+        {
+            count = p->count;
+            memcpy(addr, p->addr, sizeof(struct ftp_addr) * count);
+            *cached = 1;
+            break;
+        }
+    }
+    RESOLVER_UNLOCK();
+    if (count > 0)
+        return count;
+    
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = FTPLIB_ADDRESS_FAMILY;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    if ((rv = getaddrinfo(lhost, pnum, &hints, &res)) != 0)
+    {
+        if (ftplib_debug)
+            fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rv));
+        return 0;
+    }
+    for (ai = res; (ai != NULL) && (count < FTPLIB_MAX_ADDRS); ai = ai->ai_next)
+    {
+        if ((ai->ai_family != AF_INET) && (ai->ai_family != AF_INET6))
+            continue;
+        memcpy(&addr[count].ss, ai->ai_addr, ai->ai_addrlen);
+        addr[count].len = (socklen_t)ai->ai_addrlen;
+        count++;
+    }
+    freeaddrinfo(res);
+    if (count == 0)
+        return 0;
+    interleave_addrs(addr, count);
+    
+    RESOLVER_LOCK();
+    if (resolver_ttl > 0)
+    {
+        resolver_remove(key);
+        p = calloc(1, sizeof(struct ftp_addrcache));
+        if (p != NULL)
+        {
+            p->key = strdup(key);
+            p->expires = ftp_now() + (long long int)resolver_ttl * 1000;
+            p->count = count;
+            memcpy(p->addr, addr, sizeof(struct ftp_addr) * count);
+            p->next = resolver_cache;
+            resolver_cache = p;
+        }
+    }
+    RESOLVER_UNLOCK();
+    return count;
+}
+
+/*
+ * 여러 주소로 동시에 접속 시도 (Happy Eyeballs)
+ *
+ * FTPLIB_CONNECT_STAGGER 간격으로 다음 주소 접속을 시작하고, 먼저 접속된 소켓을 사용한다.
+ * 접속이 실패한 주소가 있으면 간격을 기다리지 않고 바로 다음 주소를 시도한다.
+ *
+ * return connected socket, -1 on error
+ */
+static int connect_race(struct ftp_addr *addr, int count)
+{
+    int fds[FTPLIB_MAX_ADDRS];
+    int next = 0, pending = 0, winner = -1, i, rv, err;
+    long long int deadline = ftp_now() + FTPLIB_CONNECT_TIMEOUT * 1000;
+    long long int wait;
+    socklen_t l;
+    fd_set wfd;
+    struct timeval tv;
+    
+    for (i = 0; i < count; i++)
+        fds[i] = -1;
+    while ((winner == -1) && ((next < count) || (pending > 0)))
+    {
+        // 다음 주소 접속 시작
+        if (next < count)
+        {
+            int s = socket(addr[next].ss.ss_family, SOCK_STREAM, IPPROTO_TCP);
+            if ((s != -1) && set_nonblock(s, 1))
+            {
+                rv = connect(s, (struct sockaddr *)&addr[next].ss, addr[next].len);
+                if (rv == 0)
+                {
+                    fds[next++] = s;
+                    winner = next - 1;
+                    break;
+                }
+#if defined(_WIN32)
+                if (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+                if (errno == EINPROGRESS)
+#endif
+                {
+                    fds[next++] = s;
+                    pending++;
+                }
+                else
+                {
+                    if (ftplib_debug)
+                        perror("connect");
+                    net_close(s);
+                    next++;
+                    continue;
+                }
+            }
+            else
+            {
+                if (ftplib_debug)
+                    perror("socket");
+                if (s != -1)
+                    net_close(s);
+                next++;
+                continue;
+            }
+        }
+        wait = deadline - ftp_now();
+        if (wait <= 0)
+            break;
+        if ((next < count) && (wait > FTPLIB_CONNECT_STAGGER))
+            wait = FTPLIB_CONNECT_STAGGER;
+        FD_ZERO(&wfd);
+        rv = -1;
+        for (i = 0; i < next; i++)
+        {
+            if (fds[i] != -1)
+            {
+                FD_SET(fds[i], &wfd);
+                if (fds[i] > rv)
+                    rv = fds[i];
+            }
+        }
+        tv.tv_sec = (long)(wait / 1000);
+        tv.tv_usec = (long)(wait % 1000) * 1000;
+        rv = select(rv + 1, NULL, &wfd, NULL, &tv);
+        if (rv == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        for (i = 0; (i < next) && (rv > 0); i++)
+        {
+            if ((fds[i] == -1) || !FD_ISSET(fds[i], &wfd))
+                continue;
+            err = 0;
+            l = sizeof(err);
+            getsockopt(fds[i], SOL_SOCKET, SO_ERROR, SETSOCKOPT_OPTVAL_TYPE &err, &l);
+            if (err == 0)
+            {
+                winner = i;
+                break;
+            }
+            if (ftplib_debug)
+                fprintf(stderr, "connect: %s\n", strerror(err));
+            net_close(fds[i]);
+            fds[i] = -1;
+            pending--;
+        }
+    }
+    // 나머지 접속 시도 취소
+    for (i = 0; i < next; i++)
+        if ((i != winner) && (fds[i] != -1))
+            net_close(fds[i]);
+    if (winner == -1)
+        return -1;
+    set_nonblock(fds[winner], 0);
+    return fds[winner];
+}
+
+/*
+ * FtpConnect - connect to remote server
+ *
+ * return 1 if connected, 0 if not
+ */
+GLOBALDEF int FtpConnect(const char *host, netbuf **nControl)
+{
+    int sControl;
+    int on = 1;
+    netbuf *ctrl;
+    char *lhost;
+    char *pnum;
+    char *p;
+    struct ftp_addr addr[FTPLIB_MAX_ADDRS];
+    int count, cached;
+    
+    lhost = strdup(host);
+    // [IPv6 주소]:포트 형식
+    if ((lhost[0] == '[') && ((p = strchr(lhost, ']')) != NULL))
+    {
+        *p++ = '\0';
+        pnum = ((*p == ':') && p[1]) ? p + 1 : "ftp";
+        memmove(lhost, lhost + 1, strlen(lhost + 1) + 1);
+    }
+    // 콜론이 여러 개인 경우는 포트 없는 IPv6 주소
+    else if (((pnum = strchr(lhost, ':')) == NULL) || (strchr(pnum + 1, ':') != NULL))
+        pnum = "ftp";
+    else
+        *pnum++ = '\0';
+    count = resolve_host(lhost, pnum, addr, &cached);
+    if (count == 0)
+    {
+        free(lhost);
+        return 0;
+    }
+    /** Timeout after FTPLIB_CONNECT_TIMEOUT seconds. */
+    sControl = connect_race(addr, count);
     if (sControl == -1)
+    {
+        // 캐시된 주소가 모두 실패한 경우, 주소가 바뀌었을 수 있으므로 캐시를 지우고 한번 더 시도
+        if (cached)
+        {
+            char key[TMP_BUFSIZ];
+            snprintf(key, sizeof(key), "%s:%s", lhost, pnum);
+            RESOLVER_LOCK();
+            resolver_remove(key);
+            RESOLVER_UNLOCK();
+            count = resolve_host(lhost, pnum, addr, &cached);
+            if (count > 0)
+                sControl = connect_race(addr, count);
+        }
+        if (sControl == -1)
+        {
+            free(lhost);
+            return 0;
+        }
+    }
+    free(lhost);
+    if (setsockopt(sControl, SOL_SOCKET, SO_REUSEADDR,
+                   SETSOCKOPT_OPTVAL_TYPE &on, sizeof(on)) == -1)
+    {
+        if (ftplib_debug)
+            perror("setsockopt SO_REUSEADDR");
+        net_close(sControl);
+        return 0;
+    }
+    ctrl = calloc(1, sizeof(netbuf));
+    if (ctrl == NULL)
+    {
+        if (ftplib_debug)
+            perror("calloc");
+        net_close(sControl);
+        return 0;
+    }
+    ctrl->buf = malloc(FTPLIB_BUFSIZ);
+    if (ctrl->buf == NULL)
+    {
+        if (ftplib_debug)
+            perror("calloc");
+        net_close(sControl);
+        free(ctrl);
+        return 0;
+    }
+    ctrl->handle = sControl;
+    ctrl->dir = FTPLIB_CONTROL;
+    ctrl->ctrl = NULL;
+    ctrl->cmode = FTPLIB_DEFMODE;
+    ctrl->idlecb = NULL;
+    ctrl->idletime.tv_sec = ctrl->idletime.tv_usec = 0;
+    ctrl->idlearg = NULL;
+    ctrl->xfered = 0;
+    ctrl->xfered1 = 0;
+    ctrl->cbbytes = 0;
+    ctrl->lastcmd = ftp_now();
+    if (readresp('2', ctrl) == 0)
+    {
+        net_close(sControl);
+        free(ctrl->buf);
+        free(ctrl);
+        return 0;
+    }
+    *nControl = ctrl;
+    return 1;
+}
+
+GLOBALDEF int FtpSetCallback(const FtpCallbackOptions *opt, netbuf *nControl)
+{
+    nControl->idlecb = opt->cbFunc;
+    nControl->idlearg = opt->cbArg;
+    nControl->idletime.tv_sec = opt->idleTime / 1000;
+    nControl->idletime.tv_usec = (opt->idleTime % 1000) * 1000;
+    nControl->cbbytes = opt->bytesXferred;
+    return 1;
+}
+
+GLOBALDEF int FtpClearCallback(netbuf *nControl)
+{
+    nControl->idlecb = NULL;
+    nControl->idlearg = NULL;
+    nControl->idletime.tv_sec = 0;
+    nControl->idletime.tv_usec = 0;
+    nControl->cbbytes = 0;
+    return 1;
+}
+
+/*
+ * FtpOptions - change connection options
+ *
+ * returns 1 if successful, 0 on error
+ */
+GLOBALDEF int FtpOptions(int opt, long val, netbuf *nControl)
+{
+    int v,rv=0;
+    switch (opt)
+    {
+        case FTPLIB_CONNMODE:
+            v = (int) val;
+            if ((v == FTPLIB_PASSIVE) || (v == FTPLIB_PORT))
+            {
+                nControl->cmode = v;
+                rv = 1;
+            }
+            break;
+        case FTPLIB_CALLBACK:
+            nControl->idlecb = (FtpCallback) val;
+            rv = 1;
+            break;
+        case FTPLIB_IDLETIME:
+            v = (int) val;
+            rv = 1;
+            nControl->idletime.tv_sec = v / 1000;
+            nControl->idletime.tv_usec = (v % 1000) * 1000;
+            break;
+        case FTPLIB_CALLBACKARG:
+            rv = 1;
+            nControl->idlearg = (void *) val;
+            break;
+        case FTPLIB_CALLBACKBYTES:
+            rv = 1;
+            nControl->cbbytes = (int) val;
+            break;
+        case FTPLIB_KEEPALIVE:
+            rv = 1;
+            nControl->keepalive = (int) val;
+            break;
+        case FTPLIB_PASVPEER:
+            rv = 1;
+            nControl->pasvpeer = (int) val;
+            break;
+        case FTPLIB_EPSV:
+            rv = 1;
+            nControl->epsv = val ? 0 : -1;
+            break;
+        case FTPLIB_PREOPEN:
+            rv = 1;
+            nControl->preopen = (int) val;
+            if (!nControl->preopen)
+                preopen_discard(nControl);
+            break;
+        case FTPLIB_STALLTIME:
+            rv = 1;
+            nControl->stalltime = (int) val;
+            break;
+        case FTPLIB_NODELAY:
+            v = val ? 1 : 0;
+            if (setsockopt(nControl->handle, IPPROTO_TCP, TCP_NODELAY,
+                           SETSOCKOPT_OPTVAL_TYPE &v, sizeof(v)) == 0)
+                rv = 1;
+            else if (ftplib_debug)
+                perror("setsockopt TCP_NODELAY");
+            break;
+        case FTPLIB_SOCKBUF:
+            if ((val >= -1) && (val <= FTPLIB_SOCKBUF_MAX))
+            {
+                rv = 1;
+                nControl->sockbuf = (int) val;
+            }
+            break;
+        case FTPLIB_IOSIZE:
+            if ((val >= 0) && (val <= FTPLIB_IOSIZE_MAX))
+            {
+                rv = 1;
+                nControl->iosize = (int) val;
+            }
+            break;
+        case FTPLIB_RATELIMIT:
+            if (val >= 0)
+            {
+                rv = 1;
+                nControl->ratelimit = val;
+            }
+            break;
+        case FTPLIB_WEIGHT:
+            if (val >= 1)
+            {
+                rv = 1;
+                nControl->weight = (int) val;
+            }
+            break;
+        case FTPLIB_SHAPER:
+            rv = 1;
+            nControl->shaper = (FtpShaper *) val;
+            break;
+    }
+    return rv;
+}
+
+/*
+ * send_cmd - send a command and wait for expected response
+ *
+ * 여러 줄 응답의 중간 줄은 body 가 NULL 이 아니면 body 에 쓴다
+ *
+ * return 1 if proper response received, 0 otherwise
+ */
+static int send_cmd(const char *cmd, char expresp, char *body, int max, netbuf *nControl)
+{
+    char buf[TMP_BUFSIZ];
+    long long int start;
+    int rv;
+    if (nControl->dir != FTPLIB_CONTROL)
+        return 0;
+    if (ftplib_debug > 2)
+        fprintf(stderr,"%s\n",cmd);
+    if ((strlen(cmd) + 3) > sizeof(buf))
+        return 0;
+    sprintf(buf,"%s\r\n", cmd);
+    invalidate_state(cmd, nControl);
+    start = ftp_now();
+    if (nb_write(nControl,buf,strlen(buf)) <= 0)
     {
         if (ftplib_debug)
-            perror("socket");
+            perror("write");
+        return 0;
+    }
+    nControl->lastcmd = start;
+    rv = readresp_body(expresp, nControl, body, max);
+    // 서버 처리 시간이 섞이지 않도록 최소값을 RTT 로 사용. 밀리초 미만은 1 로 기록
+    if (rv)
+    {
+        long long int rtt = ftp_now() - start;
+        if (rtt < 1)
+            rtt = 1;
+        if ((nControl->rtt == 0) || (rtt < nControl->rtt))
+            nControl->rtt = (int)rtt;
+    }
+    return rv;
+}
+
+/*
+ * FtpSendCmd - send a command and wait for expected response
+ *
+ * return 1 if proper response received, 0 otherwise
+ */
+GLOBALDEF int FtpSendCmd(const char *cmd, char expresp, netbuf *nControl)
+{
+    return send_cmd(cmd, expresp, NULL, 0, nControl);
+}
+
+/*
+ * FtpPing - send a NOOP and wait for the reply at most ms milliseconds
+ *
+ * 반쯤 끊어진 접속 (NAT 만료 등) 에서 TCP 재전송 시간만큼 막히지 않도록
+ * 응답 대기 시간을 제한한다. 시간 안에 응답이 없으면 제어 접속을 재사용할 수 없는 상태로 표시한다.
+ *
+ * return 1 if a positive reply was received, 0 otherwise
+ */
+GLOBALDEF int FtpPing(int ms, netbuf *nControl)
+{
+    if ((nControl->dir != FTPLIB_CONTROL) || (nControl->data != NULL))
+        return 0;
+    if (ftplib_debug > 2)
+        fprintf(stderr,"NOOP\n");
+    if (nb_write(nControl, "NOOP\r\n", 6) != 6)
+    {
+        if (ftplib_debug)
+            perror("write");
+        return 0;
+    }
+    nControl->lastcmd = ftp_now();
+    if (!reply_wait(nControl, ms))
+    {
+        strcpy(nControl->response, "timed out waiting for NOOP reply");
+        nControl->desync = 1;
+        return 0;
+    }
+    return readresp('2', nControl);
+}
+
+/*
+ * FtpKeepAlive - send a NOOP to keep the control connection alive
+ *
+ * return 1 if successful, 0 otherwise
+ */
+GLOBALDEF int FtpKeepAlive(netbuf *nControl)
+{
+    if (nControl->dir != FTPLIB_CONTROL)
+        return 0;
+    // 응답이 없는 유휴 접속이 호출한 쪽을 막지 않도록 대기 시간을 제한한다
+    if (nControl->data == NULL)
+        return FtpPing(FTPLIB_PING_TIMEOUT, nControl);
+    data_keepalive(nControl->data);
+    return 1;
+}
+
+/*
+ * FtpLogin - log in to remote server
+ *
+ * return 1 if logged in, 0 otherwise
+ */
+GLOBALDEF int FtpLogin(const char *user, const char *pass, netbuf *nControl)
+{
+    char tempbuf[64];
+    
+    if (((strlen(user) + 7) > sizeof(tempbuf)) ||
+        ((strlen(pass) + 7) > sizeof(tempbuf)))
+        return 0;
+    sprintf(tempbuf,"USER %s",user);
+    if (!FtpSendCmd(tempbuf,'3',nControl))
+    {
+        if (nControl->response[0] == '2')
+            return 1;
+        return 0;
+    }
+    sprintf(tempbuf,"PASS %s",pass);
+    return FtpSendCmd(tempbuf,'2',nControl);
+}
+
+/*
+ * FtpAuthTLS - upgrade the control connection with AUTH TLS
+ *
+ * 로그인 전에 호출한다. 성공시 PBSZ 0, PROT P (FTPLIB_TLS_CLEARDATA 인 경우 PROT C) 까지 전송한다.
+ *
+ * return 1 if successful, 0 otherwise
+ */
+GLOBALDEF int FtpAuthTLS(const char *host, int flags, netbuf *nControl)
+{
+#if defined(FTPLIB_USE_OPENSSL)
+    SSL_CTX *ctx;
+    SSL *ssl;
+    char name[256];
+    size_t l = 0;
+    
+    if ((nControl->dir != FTPLIB_CONTROL) || (nControl->tls != NULL))
+        return 0;
+    if (!FtpSendCmd("AUTH TLS",'2',nControl))
+        return 0;
+    ctx = SSL_CTX_new(TLS_client_method());
+    if (ctx == NULL)
+    {
+        tls_error("SSL_CTX_new", nControl);
+        return 0;
+    }
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    // 데이터 접속에서 제어 접속 세션을 재사용할 수 있도록 클라이언트 세션 유지
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+#if defined(SSL_OP_IGNORE_UNEXPECTED_EOF)
+    SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+#if defined(SSL_OP_ENABLE_KTLS)
+    // 지원되는 경우 커널 TLS 사용. sendfile/splice 로 암호화된 데이터를 보낼 수 있다
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+    if (!(flags & FTPLIB_TLS_NOVERIFY))
+    {
+        SSL_CTX_set_default_verify_paths(ctx);
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+    }
+    ssl = SSL_new(ctx);
+    // ssl 이 ctx 참조를 유지한다
+    SSL_CTX_free(ctx);
+    if (ssl == NULL)
+    {
+        tls_error("SSL_new", nControl);
+        return 0;
+    }
+    // host 에서 포트를 제외한 서버 이름
+    if (host != NULL)
+    {
+        while (host[l] && (host[l] != ':') && (l < sizeof(name) - 1))
+        {
+            name[l] = host[l];
+            l++;
+        }
+    }
+    name[l] = '\0';
+    if (l > 0)
+    {
+        SSL_set_tlsext_host_name(ssl, name);
+        if (!(flags & FTPLIB_TLS_NOVERIFY))
+            SSL_set1_host(ssl, name);
+    }
+    SSL_set_fd(ssl, nControl->handle);
+    if (SSL_connect(ssl) != 1)
+    {
+        tls_error("TLS handshake failed", nControl);
+        SSL_free(ssl);
+        return 0;
+    }
+    nControl->tls = ssl;
+    if (!FtpSendCmd("PBSZ 0",'2',nControl))
+        return 0;
+    if (flags & FTPLIB_TLS_CLEARDATA)
+        return FtpSendCmd("PROT C",'2',nControl);
+    if (!FtpSendCmd("PROT P",'2',nControl))
+        return 0;
+    nControl->prot = 1;
+    return 1;
+#else
+    strcpy(nControl->response, "TLS is not supported by this build\n");
+    return 0;
+#endif
+}
+
+/*
+ * FtpTLSOffload - check whether kernel TLS is active on a data connection
+ *
+ * return FTPLIB_KTLS_SEND and/or FTPLIB_KTLS_RECV, 0 if not active
+ */
+GLOBALDEF int FtpTLSOffload(netbuf *nData)
+{
+    int rv = 0;
+#if defined(FTPLIB_USE_OPENSSL) && !defined(OPENSSL_NO_KTLS) && defined(BIO_get_ktls_send)
+    if (nData->tls != NULL)
+    {
+        if (BIO_get_ktls_send(SSL_get_wbio((SSL *)nData->tls)))
+            rv |= FTPLIB_KTLS_SEND;
+        if (BIO_get_ktls_recv(SSL_get_rbio((SSL *)nData->tls)))
+            rv |= FTPLIB_KTLS_RECV;
+    }
+#endif
+    return rv;
+}
+
+#if defined(FTPLIB_USE_SPLICE) || defined(FTPLIB_USE_SENDFILE)
+/*
+ * 데이터 접속을 사용자 영역을 거치지 않고 (splice/sendfile) 전송할 수 있는지 확인
+ *
+ * TLS 를 사용하지 않거나, 해당 방향에 커널 TLS 가 적용된 경우에만 가능하다
+ *
+ * return 1 if the kernel path can be used, 0 otherwise
+ */
+static int ktls_direct(netbuf *nData, int flag)
+{
+    if (nData->tls == NULL)
+        return 1;
+#if defined(FTPLIB_USE_KTLS)
+    // 이미 복호화되어 OpenSSL 에 남아 있는 데이터는 SSL_read 로 먼저 읽어야 한다
+    if ((flag == FTPLIB_KTLS_RECV) && SSL_pending((SSL *)nData->tls))
+        return 0;
+    return (FtpTLSOffload(nData) & flag) != 0;
+#else
+    return 0;
+#endif
+}
+#endif
+
+/*
+ * FtpLoginPipelined - log in with USER, PASS, TYPE (and OPTS UTF8) in a single write
+ *
+ * 응답을 기다리지 않고 명령을 한번에 보낸 후, 보낸 순서대로 응답을 모두 읽는다.
+ * 서버가 로그인을 거부한 경우에도 남은 응답을 모두 읽어서 응답 순서를 맞춘다.
+ * 파이프라인 입력을 버리는 서버도 있으므로, 응답을 FTPLIB_PIPELINE_TIMEOUT 안에 받지 못하면
+ * 실패로 보고 nControl->desync 를 1 로 설정한다.
+ *
+ * return 1 if logged in, 0 otherwise
+ */
+GLOBALDEF int FtpLoginPipelined(const char *user, const char *pass, char mode, int utf8, netbuf *nControl)
+{
+    char buf[TMP_BUFSIZ];
+    int cmds = 3, i, rv = 1;
+    
+    if (nControl->dir != FTPLIB_CONTROL)
+        return 0;
+    if ((strlen(user) + strlen(pass) + 40) > sizeof(buf))
+        return 0;
+    sprintf(buf,"USER %s\r\nPASS %s\r\nTYPE %c\r\n",user,pass,mode);
+    if (utf8)
+    {
+        strcat(buf,"OPTS UTF8 ON\r\n");
+        cmds++;
+    }
+    if (ftplib_debug > 2)
+        fprintf(stderr,"USER %s\nPASS ****\nTYPE %c\n",user,mode);
+    if (nb_write(nControl,buf,strlen(buf)) <= 0)
+    {
+        if (ftplib_debug)
+            perror("write");
+        return 0;
+    }
+    invalidate_state("USER", nControl);
+    nControl->lastcmd = ftp_now();
+    for (i = 0; i < cmds; i++)
+    {
+        if (!reply_wait(nControl, FTPLIB_PIPELINE_TIMEOUT))
+        {
+            strcpy(nControl->response, "timed out waiting for pipelined login reply");
+            nControl->desync = 1;
+            return 0;
+        }
+        nControl->response[0] = '\0';
+        readresp('2', nControl);
+        // 응답을 읽지 못한 경우, 응답 순서를 맞출 수 없으므로 바로 실패 처리
+        if (!isdigit((unsigned char)nControl->response[0]))
+            return 0;
+        switch (i)
+        {
+            case 0:
+                // USER: 331 암호 요구, 230 로그인 완료 (이 경우 PASS는 503 응답)
+                if ((nControl->response[0] != '3') && (nControl->response[0] != '2'))
+                    rv = 0;
+                break;
+            case 1:
+                if ((nControl->response[0] != '2') &&
+                    (strncmp(nControl->response, "503", 3) != 0))
+                    rv = 0;
+                break;
+            case 2:
+                if (nControl->response[0] != '2')
+                    rv = 0;
+                break;
+            default:
+                // OPTS UTF8 는 지원하지 않는 서버도 있으므로 결과를 무시한다
+                break;
+        }
+        // 실패한 응답을 FtpLastResponse 로 확인할 수 있도록 보관
+        if (rv == 0)
+        {
+            char result[RESPONSE_BUFSIZ];
+            strncpy(result, nControl->response, sizeof(result));
+            for (i++; i < cmds; i++)
+            {
+                if (!reply_wait(nControl, FTPLIB_PIPELINE_TIMEOUT))
+                {
+                    nControl->desync = 1;
+                    break;
+                }
+                readresp('2', nControl);
+            }
+            strncpy(nControl->response, result, sizeof(nControl->response));
+            return 0;
+        }
+    }
+    nControl->type = mode;
+    return rv;
+}
+
+/*
+ * 사설/루프백/미지정 IPv4 주소인지 확인
+ */
+static int is_private_v4(const struct in_addr *addr)
+{
+    unsigned long h = ntohl(addr->s_addr);
+    return ((h >> 24) == 10) ||         /* 10.0.0.0/8 */
+           ((h >> 20) == 0xAC1) ||      /* 172.16.0.0/12 */
+           ((h >> 16) == 0xC0A8) ||     /* 192.168.0.0/16 */
+           ((h >> 16) == 0xA9FE) ||     /* 169.254.0.0/16 */
+           ((h >> 24) == 127) ||
+           (h == 0);
+}
+
+/*
+ * FtpParseEpsv - extract the port from an EPSV reply
+ *
+ * 응답 형식: 229 ... (|||port|). 구분 문자는 | 가 아니어도 네 개가 같으면 된다
+ *
+ * return port, 0 on error
+ */
+GLOBALDEF unsigned int FtpParseEpsv(const char *response)
+{
+    const char *cp = strchr(response, '(');
+    char delim, *end;
+    unsigned long port;
+    
+    if ((cp == NULL) || (cp[1] == '\0'))
+        return 0;
+    delim = cp[1];
+    if ((cp[2] != delim) || (cp[3] != delim))
+        return 0;
+    port = strtoul(cp + 4, &end, 10);
+    if ((*end != delim) || (port == 0) || (port > 65535))
+        return 0;
+    return (unsigned int)port;
+}
+
+/*
+ * 읽어 들인 EPSV/PASV 응답에서 데이터 접속 주소 확인
+ *
+ * PASV 응답의 주소를 무시하도록 지정되었거나, 응답 주소가 사설 주소인데 제어 접속은 공인 주소인
+ * 경우(NAT 뒤의 서버)에는 제어 접속 주소를 사용한다.
+ *
+ * return 1 if successful, 0 otherwise
+ */
+static int passive_reply(netbuf *nControl, int epsv, struct sockaddr_storage *ss, socklen_t *len)
+{
+    struct sockaddr_storage peer;
+    socklen_t l = sizeof(peer);
+    struct sockaddr_in *in = (struct sockaddr_in *)ss;
+    unsigned int v[6], port;
+    char *cp;
+    
+    if (nControl->response[0] != '2')
         return 0;
-    }
-    if (setsockopt(sControl, SOL_SOCKET, SO_REUSEADDR,
-                   SETSOCKOPT_OPTVAL_TYPE &on, sizeof(on)) == -1)
+    if (getpeername(nControl->handle, (struct sockaddr *)&peer, &l) < 0)
     {
         if (ftplib_debug)
-            perror("setsockopt SO_REUSEADDR");
-        net_close(sControl);
+            perror("getpeername");
         return 0;
     }
-    /** This does not work with the connect() method.
-     if (setsockopt(sControl, SOL_SOCKET, SO_SNDTIMEO,
-     (char *)&timeout, sizeof(timeout)) < 0)
-     {
-     if (ftplib_debug)
-     perror("setsockopt SO_SNDTIMEO");
-     net_close(sControl);
-     return 0;
-     } */
-    if (connect(sControl, (struct sockaddr *)&sin, sizeof(sin)) == -1)
+    if (epsv)
     {
-        if (ftplib_debug)
-            perror("connect");
-        net_close(sControl);
-        return 0;
+        if ((port = FtpParseEpsv(nControl->response)) == 0)
+            return 0;
+        memcpy(ss, &peer, l);
+        *len = l;
+        if (peer.ss_family == AF_INET6)
+            ((struct sockaddr_in6 *)ss)->sin6_port = htons(port);
+        else
+            in->sin_port = htons(port);
+        return 1;
     }
-    ctrl = calloc(1, sizeof(netbuf));
-    if (ctrl == NULL)
-    {
-        if (ftplib_debug)
-            perror("calloc");
-        net_close(sControl);
+    if (peer.ss_family != AF_INET)
         return 0;
-    }
-    ctrl->buf = malloc(FTPLIB_BUFSIZ);
-    if (ctrl->buf == NULL)
-    {
-        if (ftplib_debug)
-            perror("calloc");
-        net_close(sControl);
-        free(ctrl);
+    cp = strchr(nControl->response,'(');
+    if (cp == NULL)
         return 0;
+    cp++;
+    if (sscanf(cp,"%u,%u,%u,%u,%u,%u",&v[2],&v[3],&v[4],&v[5],&v[0],&v[1]) != 6)
+        return 0;
+    memset(ss, 0, sizeof(*ss));
+    in->sin_family = AF_INET;
+    in->sin_addr.s_addr = htonl((v[2] << 24) | (v[3] << 16) | (v[4] << 8) | v[5]);
+    in->sin_port = htons((v[0] << 8) | v[1]);
+    if (nControl->pasvpeer ||
+        (is_private_v4(&in->sin_addr) &&
+         !is_private_v4(&((struct sockaddr_in *)&peer)->sin_addr)))
+        in->sin_addr = ((struct sockaddr_in *)&peer)->sin_addr;
+    *len = sizeof(struct sockaddr_in);
+    return 1;
+}
+
+/*
+ * EPSV 응답 확인 후, 지원하지 않는 서버(5xx)는 제어 접속에 기록해서 이후에는 바로 PASV 를 사용한다
+ *
+ * return 1 if EPSV succeeded, 0 otherwise
+ */
+static int epsv_result(netbuf *nControl, struct sockaddr_storage *ss, socklen_t *len)
+{
+    if (passive_reply(nControl, 1, ss, len))
+    {
+        nControl->epsv = 1;
+        return 1;
     }
-    ctrl->handle = sControl;
-    ctrl->dir = FTPLIB_CONTROL;
-    ctrl->ctrl = NULL;
-    ctrl->cmode = FTPLIB_DEFMODE;
-    ctrl->idlecb = NULL;
-    ctrl->idletime.tv_sec = ctrl->idletime.tv_usec = 0;
-    ctrl->idlearg = NULL;
-    ctrl->xfered = 0;
-    ctrl->xfered1 = 0;
-    ctrl->cbbytes = 0;
-    if (readresp('2', ctrl) == 0)
+    if (nControl->response[0] == '5')
+        nControl->epsv = -1;
+    return 0;
+}
+
+/*
+ * 패시브 모드 데이터 접속 주소 확인
+ *
+ * EPSV 를 우선 사용하고, 지원하지 않는 서버는 PASV 를 사용한다. PASV 는 IPv4 만 지원한다
+ *
+ * return 1 if successful, 0 otherwise
+ */
+static int passive_addr(netbuf *nControl, struct sockaddr_storage *ss, socklen_t *len)
+{
+    if (nControl->epsv >= 0)
     {
-        net_close(sControl);
-        free(ctrl->buf);
-        free(ctrl);
-        return 0;
+        FtpSendCmd("EPSV",'2',nControl);
+        if (epsv_result(nControl, ss, len))
+            return 1;
+        // 응답을 읽지 못했거나 일시적인 오류인 경우는 PASV 도 같으므로 실패 처리
+        if (nControl->epsv >= 0)
+            return 0;
     }
-    *nControl = ctrl;
-    return 1;
+    if (!FtpSendCmd("PASV",'2',nControl))
+        return 0;
+    return passive_reply(nControl, 0, ss, len);
 }
 
-GLOBALDEF int FtpSetCallback(const FtpCallbackOptions *opt, netbuf *nControl)
+/*
+ * 전송 버퍼 크기. FTPLIB_IOSIZE 로 지정하지 않은 경우 FTPLIB_BUFSIZ
+ */
+static int io_size(netbuf *nControl)
 {
-    nControl->idlecb = opt->cbFunc;
-    nControl->idlearg = opt->cbArg;
-    nControl->idletime.tv_sec = opt->idleTime / 1000;
-    nControl->idletime.tv_usec = (opt->idleTime % 1000) * 1000;
-    nControl->cbbytes = opt->bytesXferred;
-    return 1;
+    return (nControl->iosize > 0) ? nControl->iosize : FTPLIB_BUFSIZ;
 }
 
-GLOBALDEF int FtpClearCallback(netbuf *nControl)
+/*
+ * 데이터 소켓 버퍼 크기 결정
+ *
+ * 자동 조정(FTPLIB_SOCKBUF -1)인 경우 제어 접속에서 측정한 최소 RTT 와
+ * 이전 전송의 최대 전송률로 대역폭 지연 곱(BDP)을 구한다.
+ * 측정된 전송률이 현재 창 크기에 제한되었을 수 있으므로 BDP 의 두 배를 사용해서
+ * 다음 전송에서 창이 늘어날 여지를 둔다.
+ *
+ * return buffer size, 0 to keep the system default
+ */
+static int data_sockbuf(netbuf *nControl)
 {
-    nControl->idlecb = NULL;
-    nControl->idlearg = NULL;
-    nControl->idletime.tv_sec = 0;
-    nControl->idletime.tv_usec = 0;
-    nControl->cbbytes = 0;
-    return 1;
+    long long int size;
+    if (nControl->sockbuf >= 0)
+        return nControl->sockbuf;
+    if ((nControl->rtt == 0) || (nControl->rate == 0))
+        return 0;
+    size = nControl->rate * nControl->rtt / 1000 * 2;
+    if (size < FTPLIB_SOCKBUF_MIN)
+        size = FTPLIB_SOCKBUF_MIN;
+    if (size > FTPLIB_SOCKBUF_MAX)
+        size = FTPLIB_SOCKBUF_MAX;
+    return (int)size;
 }
 
 /*
- * FtpOptions - change connection options
+ * 데이터 소켓 버퍼 크기 지정
  *
- * returns 1 if successful, 0 on error
+ * TCP 창 크기 협상에 반영되도록 connect/listen 전에 호출해야 한다.
+ * 자동 조정인 경우 시스템 기본값보다 작게는 지정하지 않는다.
+ *
+ * @param dir FTPLIB_READ / FTPLIB_WRITE. 방향을 모르는 경우 0
  */
-GLOBALDEF int FtpOptions(int opt, long val, netbuf *nControl)
+static void tune_data_socket(netbuf *nControl, int s, int dir)
 {
-    int v,rv=0;
-    switch (opt)
-    {
-        case FTPLIB_CONNMODE:
-            v = (int) val;
-            if ((v == FTPLIB_PASSIVE) || (v == FTPLIB_PORT))
-            {
-                nControl->cmode = v;
-                rv = 1;
-            }
-            break;
-        case FTPLIB_CALLBACK:
-            nControl->idlecb = (FtpCallback) val;
-            rv = 1;
-            break;
-        case FTPLIB_IDLETIME:
-            v = (int) val;
-            rv = 1;
-            nControl->idletime.tv_sec = v / 1000;
-            nControl->idletime.tv_usec = (v % 1000) * 1000;
-            break;
-        case FTPLIB_CALLBACKARG:
-            rv = 1;
-            nControl->idlearg = (void *) val;
-            break;
-        case FTPLIB_CALLBACKBYTES:
-            rv = 1;
-            nControl->cbbytes = (int) val;
-            break;
-    }
-    return rv;
+    int size = data_sockbuf(nControl);
+    int cur;
+    socklen_t l = sizeof(cur);
+    if (size <= 0)
+        return;
+    if ((nControl->sockbuf < 0) &&
+        (getsockopt(s, SOL_SOCKET, (dir == FTPLIB_WRITE) ? SO_SNDBUF : SO_RCVBUF,
+                    SETSOCKOPT_OPTVAL_TYPE &cur, &l) == 0) &&
+        (cur >= size))
+        return;
+    if ((dir != FTPLIB_WRITE) &&
+        (setsockopt(s, SOL_SOCKET, SO_RCVBUF, SETSOCKOPT_OPTVAL_TYPE &size, sizeof(size)) == -1) &&
+        ftplib_debug)
+        perror("setsockopt SO_RCVBUF");
+    if ((dir != FTPLIB_READ) &&
+        (setsockopt(s, SOL_SOCKET, SO_SNDBUF, SETSOCKOPT_OPTVAL_TYPE &size, sizeof(size)) == -1) &&
+        ftplib_debug)
+        perror("setsockopt SO_SNDBUF");
 }
 
 /*
- * FtpSendCmd - send a command and wait for expected response
+ * 종료된 데이터 접속의 전송률을 제어 접속에 반영
  *
- * return 1 if proper response received, 0 otherwise
+ * 짧은 전송은 접속 준비 시간이 대부분이라 측정하지 않는다.
+ * 최대값(병목 대역폭 추정치)을 유지한다.
  */
-GLOBALDEF int FtpSendCmd(const char *cmd, char expresp, netbuf *nControl)
+static void data_rate(netbuf *nControl, netbuf *nData)
 {
-    char buf[TMP_BUFSIZ];
-    if (nControl->dir != FTPLIB_CONTROL)
-        return 0;
+    long long int elapsed = ftp_now() - nData->opened;
+    long long int rate;
+    if ((nData->xfered < FTPLIB_RATE_MINBYTES) || (elapsed <= 0))
+        return;
+    rate = (long long int)nData->xfered * 1000 / elapsed;
+    if (rate > nControl->rate)
+        nControl->rate = rate;
+}
+
+/*
+ * 다음 전송의 패시브 데이터 접속 요청 (FTPLIB_PREOPEN)
+ *
+ * 전송 결과 응답을 기다리기 전에 EPSV/PASV 를 보내서 응답 대기 시간을 겹치게 한다.
+ * 응답은 preopen_finish 에서 읽는다.
+ */
+static void preopen_send(netbuf *nControl)
+{
+    const char *cmd = (nControl->epsv >= 0) ? "EPSV\r\n" : "PASV\r\n";
+    
+    nControl->present = 0;
+    if (!nControl->preopen || (nControl->cmode != FTPLIB_PASSIVE) || nControl->hasspare)
+        return;
     if (ftplib_debug > 2)
-        fprintf(stderr,"%s\n",cmd);
-    if ((strlen(cmd) + 3) > sizeof(buf))
-        return 0;
-    sprintf(buf,"%s\r\n", cmd);
-    if (net_write(nControl->handle,buf,strlen(buf)) <= 0)
-    {
-        if (ftplib_debug)
-            perror("write");
-        return 0;
-    }
-    return readresp(expresp, nControl);
+        fprintf(stderr,"%.4s\n",cmd);
+    if (nb_write(nControl, cmd, 6) != 6)
+        return;
+    nControl->lastcmd = ftp_now();
+    nControl->present = (nControl->epsv >= 0) ? 1 : 2;
 }
 
 /*
- * FtpLogin - log in to remote server
+ * preopen_send 응답을 읽고 데이터 접속 시작
  *
- * return 1 if logged in, 0 otherwise
+ * 접속 완료는 기다리지 않고, 다음 FtpOpenPort 에서 확인한다
  */
-GLOBALDEF int FtpLogin(const char *user, const char *pass, netbuf *nControl)
+static void preopen_finish(netbuf *nControl)
 {
-    char tempbuf[64];
+    struct sockaddr_storage ss;
+    socklen_t l = sizeof(ss);
+    char result[RESPONSE_BUFSIZ];
+    int epsv = (nControl->present == 1);
+    int s, ok;
     
-    if (((strlen(user) + 7) > sizeof(tempbuf)) ||
-        ((strlen(pass) + 7) > sizeof(tempbuf)))
-        return 0;
-    sprintf(tempbuf,"USER %s",user);
-    if (!FtpSendCmd(tempbuf,'3',nControl))
+    if (nControl->present == 0)
+        return;
+    nControl->present = 0;
+    // 전송 결과 응답을 FtpLastResponse 로 확인할 수 있도록 보관
+    strncpy(result, nControl->response, sizeof(result));
+    readresp('2', nControl);
+    ok = epsv ? epsv_result(nControl, &ss, &l) : passive_reply(nControl, 0, &ss, &l);
+    strncpy(nControl->response, result, sizeof(nControl->response));
+    if (!ok)
+        return;
+    s = socket(ss.ss_family, SOCK_STREAM, IPPROTO_TCP);
+    if (s == -1)
+        return;
+    // 다음 전송 방향을 알 수 없으므로 양방향 버퍼 모두 지정
+    tune_data_socket(nControl, s, 0);
+    if (!set_nonblock(s, 1) ||
+        ((connect(s, (struct sockaddr *)&ss, l) == -1) &&
+#if defined(_WIN32)
+         (WSAGetLastError() != WSAEWOULDBLOCK)))
+#else
+         (errno != EINPROGRESS)))
+#endif
     {
-        if (nControl->response[0] == '2')
-            return 1;
-        return 0;
+        net_close(s);
+        return;
     }
-    sprintf(tempbuf,"PASS %s",pass);
-    return FtpSendCmd(tempbuf,'2',nControl);
+    nControl->spare = s;
+    nControl->sparetime = ftp_now();
+    nControl->hasspare = 1;
 }
 
 /*
- * FtpOpenPort - set up data connection
+ * 미리 열어 둔 데이터 접속을 사용할 수 있으면 반환
  *
- * return 1 if successful, 0 otherwise
+ * 오래되었거나, 접속에 실패했거나, 서버가 이미 닫은 접속은 버린다
+ *
+ * return socket, -1 if not available
  */
-static int FtpOpenPort(netbuf *nControl, netbuf **nData, int mode, int dir)
+static int preopen_take(netbuf *nControl)
 {
-    int sData;
-    union {
-        struct sockaddr sa;
-        struct sockaddr_in in;
-    } sin;
-    struct linger lng = { 0, 0 };
-    unsigned int l;
-    int on=1;
-    netbuf *ctrl;
-    char *cp;
-    unsigned int v[6];
-    char buf[TMP_BUFSIZ];
+    int s = nControl->spare, err = 0, rv;
+    socklen_t l = sizeof(err);
+    fd_set wfd, rfd;
+    struct timeval tv;
     
-    if (nControl->dir != FTPLIB_CONTROL)
+    if (!nControl->hasspare)
         return -1;
-    if ((dir != FTPLIB_READ) && (dir != FTPLIB_WRITE))
+    nControl->hasspare = 0;
+    if (ftp_now() - nControl->sparetime > FTPLIB_PREOPEN_MAXAGE)
     {
-        sprintf(nControl->response, "Invalid direction %d\n", dir);
+        net_close(s);
         return -1;
     }
-    if ((mode != FTPLIB_ASCII) && (mode != FTPLIB_IMAGE))
+    FD_ZERO(&wfd);
+    FD_SET(s, &wfd);
+    tv.tv_sec = FTPLIB_CONNECT_TIMEOUT;
+    tv.tv_usec = 0;
+    rv = select(s + 1, NULL, &wfd, NULL, &tv);
+    if ((rv <= 0) ||
+        (getsockopt(s, SOL_SOCKET, SO_ERROR, SETSOCKOPT_OPTVAL_TYPE &err, &l) == -1) ||
+        (err != 0))
     {
-        sprintf(nControl->response, "Invalid mode %c\n", mode);
+        net_close(s);
+        return -1;
+    }
+    // RETR/STOR 전에 읽을 데이터가 있다면 서버가 접속을 닫은 것
+    FD_ZERO(&rfd);
+    FD_SET(s, &rfd);
+    tv.tv_sec = 0;
+    if (select(s + 1, &rfd, NULL, NULL, &tv) != 0)
+    {
+        net_close(s);
         return -1;
     }
+    set_nonblock(s, 0);
+    if (ftplib_debug > 1)
+        fprintf(stderr, "Using pre-opened data connection\n");
+    return s;
+}
+
+/*
+ * 액티브 모드 데이터 접속 주소를 서버에 전송
+ *
+ * IPv4 는 PORT, IPv6 는 EPRT 를 사용한다
+ *
+ * return 1 if successful, 0 otherwise
+ */
+static int send_port(netbuf *nControl, struct sockaddr_storage *ss)
+{
+    char buf[TMP_BUFSIZ];
+    char host[INET6_ADDRSTRLEN];
+    
+    if (ss->ss_family == AF_INET6)
+    {
+        struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)ss;
+        if (inet_ntop(AF_INET6, &in6->sin6_addr, host, sizeof(host)) == NULL)
+            return 0;
+        sprintf(buf, "EPRT |2|%s|%u|", host, ntohs(in6->sin6_port));
+    }
+    else
+    {
+        struct sockaddr_in *in = (struct sockaddr_in *)ss;
+        unsigned long a = ntohl(in->sin_addr.s_addr);
+        unsigned int p = ntohs(in->sin_port);
+        sprintf(buf, "PORT %lu,%lu,%lu,%lu,%u,%u",
+                (a >> 24) & 0xff, (a >> 16) & 0xff, (a >> 8) & 0xff, a & 0xff,
+                p >> 8, p & 0xff);
+    }
+    return FtpSendCmd(buf,'2',nControl);
+}
+
+/*
+ * 데이터 접속 소켓 생성
+ *
+ * 패시브 모드는 EPSV/PASV 로 받은 주소로 접속하고, 액티브 모드는 대기 소켓을 열고 PORT/EPRT 전송
+ *
+ * return socket, -1 on error
+ */
+static int open_data_socket(netbuf *nControl, int dir)
+{
+    int sData;
+    struct sockaddr_storage sin;
+    struct linger lng = { 0, 0 };
+    socklen_t l;
+    int on=1;
+    
     l = sizeof(sin);
     if (nControl->cmode == FTPLIB_PASSIVE)
     {
-        memset(&sin, 0, l);
-        sin.in.sin_family = AF_INET;
-        if (!FtpSendCmd("PASV",'2',nControl))
-            return -1;
-        cp = strchr(nControl->response,'(');
-        if (cp == NULL)
+        if (!passive_addr(nControl, &sin, &l))
             return -1;
-        cp++;
-        sscanf(cp,"%u,%u,%u,%u,%u,%u",&v[2],&v[3],&v[4],&v[5],&v[0],&v[1]);
-        sin.sa.sa_data[2] = v[2];
-        sin.sa.sa_data[3] = v[3];
-        sin.sa.sa_data[4] = v[4];
-        sin.sa.sa_data[5] = v[5];
-        sin.sa.sa_data[0] = v[0];
-        sin.sa.sa_data[1] = v[1];
     }
     else
     {
-        if (getsockname(nControl->handle, &sin.sa, &l) < 0)
+        if (getsockname(nControl->handle, (struct sockaddr *)&sin, &l) < 0)
         {
             if (ftplib_debug)
                 perror("getsockname");
             return -1;
         }
     }
-    sData = socket(PF_INET,SOCK_STREAM,IPPROTO_TCP);
+    sData = socket(sin.ss_family,SOCK_STREAM,IPPROTO_TCP);
     if (sData == -1)
     {
         if (ftplib_debug)
@@ -932,9 +2402,10 @@ static int FtpOpenPort(netbuf *nControl, netbuf **nData, int mode, int dir)
         net_close(sData);
         return -1;
     }
+    tune_data_socket(nControl, sData, dir);
     if (nControl->cmode == FTPLIB_PASSIVE)
     {
-        if (connect(sData, &sin.sa, sizeof(sin.sa)) == -1)
+        if (connect(sData, (struct sockaddr *)&sin, l) == -1)
         {
             if (ftplib_debug)
                 perror("connect");
@@ -944,8 +2415,11 @@ static int FtpOpenPort(netbuf *nControl, netbuf **nData, int mode, int dir)
     }
     else
     {
-        sin.in.sin_port = 0;
-        if (bind(sData, &sin.sa, sizeof(sin)) == -1)
+        if (sin.ss_family == AF_INET6)
+            ((struct sockaddr_in6 *)&sin)->sin6_port = 0;
+        else
+            ((struct sockaddr_in *)&sin)->sin_port = 0;
+        if (bind(sData, (struct sockaddr *)&sin, l) == -1)
         {
             if (ftplib_debug)
                 perror("bind");
@@ -959,21 +2433,52 @@ static int FtpOpenPort(netbuf *nControl, netbuf **nData, int mode, int dir)
             net_close(sData);
             return -1;
         }
-        if (getsockname(sData, &sin.sa, &l) < 0)
+        l = sizeof(sin);
+        if (getsockname(sData, (struct sockaddr *)&sin, &l) < 0)
+        {
+            net_close(sData);
             return -1;
-        sprintf(buf, "PORT %d,%d,%d,%d,%d,%d",
-                (unsigned char) sin.sa.sa_data[2],
-                (unsigned char) sin.sa.sa_data[3],
-                (unsigned char) sin.sa.sa_data[4],
-                (unsigned char) sin.sa.sa_data[5],
-                (unsigned char) sin.sa.sa_data[0],
-                (unsigned char) sin.sa.sa_data[1]);
-        if (!FtpSendCmd(buf,'2',nControl))
+        }
+        if (!send_port(nControl, &sin))
         {
             net_close(sData);
             return -1;
         }
     }
+    return sData;
+}
+
+/*
+ * FtpOpenPort - set up data connection
+ *
+ * return 1 if successful, 0 otherwise
+ */
+static int FtpOpenPort(netbuf *nControl, netbuf **nData, int mode, int dir)
+{
+    int sData;
+    netbuf *ctrl;
+    
+    if (nControl->dir != FTPLIB_CONTROL)
+        return -1;
+    if ((dir != FTPLIB_READ) && (dir != FTPLIB_WRITE))
+    {
+        sprintf(nControl->response, "Invalid direction %d\n", dir);
+        return -1;
+    }
+    if ((mode != FTPLIB_ASCII) && (mode != FTPLIB_IMAGE))
+    {
+        sprintf(nControl->response, "Invalid mode %c\n", mode);
+        return -1;
+    }
+    sData = -1;
+    if (nControl->cmode == FTPLIB_PASSIVE)
+        sData = preopen_take(nControl);
+    else
+        preopen_discard(nControl);
+    if (sData == -1)
+        sData = open_data_socket(nControl, dir);
+    if (sData == -1)
+        return -1;
     ctrl = calloc(1,sizeof(netbuf));
     if (ctrl == NULL)
     {
@@ -1001,6 +2506,12 @@ static int FtpOpenPort(netbuf *nControl, netbuf **nData, int mode, int dir)
         ctrl->idlecb = nControl->idlecb;
     else
         ctrl->idlecb = NULL;
+    ctrl->stalltime = nControl->stalltime;
+    ctrl->opened = ftp_now();
+    ctrl->ratelimit = nControl->ratelimit;
+    ctrl->weight = nControl->weight > 0 ? nControl->weight : 1;
+    ctrl->shaper = nControl->shaper;
+    shape_start(ctrl);
     *nData = ctrl;
     return 1;
 }
@@ -1013,8 +2524,8 @@ static int FtpOpenPort(netbuf *nControl, netbuf **nData, int mode, int dir)
 static int FtpAcceptConnection(netbuf *nData, netbuf *nControl)
 {
     int sData;
-    struct sockaddr addr;
-    unsigned int l;
+    struct sockaddr_storage addr;
+    socklen_t l;
     int i;
     struct timeval tv;
     fd_set mask;
@@ -1049,7 +2560,7 @@ static int FtpAcceptConnection(netbuf *nData, netbuf *nControl)
         if (FD_ISSET(nData->handle, &mask))
         {
             l = sizeof(addr);
-            sData = accept(nData->handle, &addr, &l);
+            sData = accept(nData->handle, (struct sockaddr *)&addr, &l);
             i = errno;
             net_close(nData->handle);
             if (sData > 0)
@@ -1091,7 +2602,8 @@ GLOBALDEF int FtpAccess(const char *path,
     char buf[TMP_BUFSIZ];
     int dir;
     if ((path == NULL) &&
-        ((typ == FTPLIB_FILE_WRITE) || (typ == FTPLIB_FILE_READ)))
+        ((typ == FTPLIB_FILE_WRITE) || (typ == FTPLIB_FILE_READ) ||
+         (typ == FTPLIB_FILE_WRITE_OFFSET) || (typ == FTPLIB_FILE_APPEND)))
     {
         sprintf(nControl->response,
                 "Missing path argument for file transfer\n");
@@ -1100,9 +2612,8 @@ GLOBALDEF int FtpAccess(const char *path,
 
     if (typ != FTPLIB_ABORT) {
         // 중지 작업이 아닌 경우
-        // TYPE 전송후 결과 확인
-        sprintf(buf, "TYPE %c", mode);
-        if (!FtpSendCmd(buf, '2', nControl))
+        // TYPE 전송후 결과 확인. 이미 같은 모드인 경우 생략
+        if (!FtpType(mode, nControl))
             return 0;
     }
 
@@ -1119,6 +2630,10 @@ GLOBALDEF int FtpAccess(const char *path,
             strcpy(buf,"LIST");
             dir = FTPLIB_READ;
             break;
+        case FTPLIB_MLSD:
+            strcpy(buf,"MLSD");
+            dir = FTPLIB_READ;
+            break;
         case FTPLIB_FILE_READ:
             strcpy(buf,"RETR");
             dir = FTPLIB_READ;
@@ -1133,6 +2648,15 @@ GLOBALDEF int FtpAccess(const char *path,
             strcpy(buf,"STOR");
             dir = FTPLIB_WRITE;
             break;
+        case FTPLIB_FILE_WRITE_OFFSET:
+            // REST 는 포트를 연 후 STOR 직전에 보낸다 (아래 참고)
+            strcpy(buf,"STOR");
+            dir = FTPLIB_WRITE;
+            break;
+        case FTPLIB_FILE_APPEND:
+            strcpy(buf,"APPE");
+            dir = FTPLIB_WRITE;
+            break;
         case FTPLIB_ABORT:
             strcpy(buf,"ABOR");
             dir = FTPLIB_ABORT;
@@ -1157,6 +2681,20 @@ GLOBALDEF int FtpAccess(const char *path,
             return 0;
     }
 
+    // REST 와 전송 명령 사이에 PASV/EPSV/PORT 가 오면 REST 를 초기화하는 서버가 있으므로 STOR 바로 앞에 보낸다.
+    // REST 가 거부되면 STOR 가 처음부터 덮어쓰므로, 파이프라이닝하지 않고 REST 응답부터 확인
+    if (typ == FTPLIB_FILE_WRITE_OFFSET)
+    {
+        char rest[TMP_BUFSIZ];
+        sprintf(rest, "REST %lld", offset);
+        if (!FtpSendCmd(rest, '3', nControl))
+        {
+            FtpClose(*nData);
+            *nData = NULL;
+            return 0;
+        }
+    }
+
     if (!FtpSendCmd(buf, checker, nControl))
     {
         if (nData != NULL) {
@@ -1166,6 +2704,15 @@ GLOBALDEF int FtpAccess(const char *path,
         return 0;
     }
 
+    // REST + RETR 을 한번에 전송한 경우, REST 응답만 읽은 상태이므로
+    // RETR 응답(1xx)까지 읽어야 이후 응답 순서가 어긋나지 않는다
+    if (typ == FTPLIB_FILE_READ_OFFSET && !readresp('1', nControl))
+    {
+        FtpClose(*nData);
+        *nData = NULL;
+        return 0;
+    }
+
     // 중지 성공시 종료 처리
     if (typ == FTPLIB_ABORT) {
         if (nData != NULL) {
@@ -1190,6 +2737,19 @@ GLOBALDEF int FtpAccess(const char *path,
             return 0;
         }
     }
+#if defined(FTPLIB_USE_OPENSSL)
+    // PROT P 인 경우, 서버가 1xx 응답 후 시작하는 데이터 접속 핸드셰이크 진행
+    if (nControl->prot && !tls_connect_data(*nData, nControl))
+    {
+        char result[RESPONSE_BUFSIZ];
+        strncpy(result, nControl->response, sizeof(result));
+        // 데이터 접속을 닫고 서버의 전송 실패 응답까지 읽는다
+        FtpClose(*nData);
+        *nData = NULL;
+        strncpy(nControl->response, result, sizeof(nControl->response));
+        return 0;
+    }
+#endif
     return 1;
 }
 
@@ -1208,23 +2768,154 @@ GLOBALDEF int FtpRead(void *buf, int max, netbuf *nData)
         i = socket_wait(nData);
         if (i != 1)
             return 0;
-        i = net_read(nData->handle, buf, max);
+        i = nb_read(nData, buf, shape_max(nData, max));
     }
     if (i == -1)
         return 0;
-    nData->xfered += i;
-    if (nData->idlecb && nData->cbbytes)
+    if (!data_progress(nData, i))
+        return 0;
+    return i;
+}
+
+#if !defined(_WIN32)
+/*
+ * write_full - write all bytes at a file position
+ *
+ * return 1 if successful, 0 otherwise
+ */
+static int write_full(int fd, const char *buf, int len, long long int offset)
+{
+    while (len > 0)
     {
-        nData->xfered1 += i;
-        if (nData->xfered1 > nData->cbbytes)
+        ssize_t w = pwrite(fd, buf, len, (off_t)offset);
+        if (w == -1 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return 0;
+        buf += w;
+        len -= (int)w;
+        offset += w;
+    }
+    return 1;
+}
+
+#if defined(FTPLIB_USE_SPLICE)
+/*
+ * splice_read - move data from the data socket to a file through a pipe
+ *
+ * return bytecount, 0 on end of data or error, -1 if splice is not
+ * supported for this socket, -2 if the file could not be written
+ */
+static int splice_read(int fd, long long int offset, int max, netbuf *nData)
+{
+    loff_t off = offset;
+    ssize_t in, out;
+    int total = 0;
+    if (!nData->haspipe)
+    {
+        if (pipe(nData->pipefd) == -1)
+            return -1;
+        nData->haspipe = 1;
+        // 기본 파이프 크기(64KB)보다 크게 옮길 수 있도록 시도. 실패해도 무시
+        fcntl(nData->pipefd[1], F_SETPIPE_SZ, FTPLIB_SPLICE_PIPESIZ);
+    }
+    in = splice(nData->handle, NULL, nData->pipefd[1], NULL, max,
+                SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (in == -1)
+    {
+        if (errno == EINVAL || errno == ENOSYS)
+            return -1;
+        strncpy(nData->ctrl->response, strerror(errno),
+                sizeof(nData->ctrl->response));
+        return 0;
+    }
+    while (total < in)
+    {
+        out = splice(nData->pipefd[0], NULL, fd, &off, in - total, SPLICE_F_MOVE);
+        if (out == -1 && errno == EINTR)
+            continue;
+        if (out == -1 && (errno == EINVAL || errno == ENOSYS))
         {
-            if (nData->idlecb(nData, (fsz_t)nData->xfered, nData->idlearg) == 0)
+            // 파일 쪽이 splice 를 지원하지 않는 경우 파이프에 남은 데이터를 복사로 옮긴다
+            char buf[FTPLIB_BUFSIZ];
+            nData->nosplice = 1;
+            while (total < in)
+            {
+                ssize_t r = read(nData->pipefd[0], buf,
+                                 (in - total) < (ssize_t)sizeof(buf) ? (size_t)(in - total) : sizeof(buf));
+                if (r <= 0 || !write_full(fd, buf, (int)r, offset + total))
+                {
+                    strncpy(nData->ctrl->response, strerror(errno),
+                            sizeof(nData->ctrl->response));
+                    return -2;
+                }
+                total += (int)r;
+            }
+            break;
+        }
+        if (out <= 0)
+        {
+            strncpy(nData->ctrl->response, strerror(errno),
+                    sizeof(nData->ctrl->response));
+            return -2;
+        }
+        total += (int)out;
+    }
+    return total;
+}
+#endif
+
+/*
+ * FtpReadFd - read from a data connection directly into a file
+ *
+ * Linux 의 바이너리 전송은 splice() 로 소켓에서 파일로 바로 옮기고 (TLS 는 커널 TLS 수신인 경우만),
+ * 그 외에는 복사 후 pwrite() 로 저장한다.
+ *
+ * return bytecount, 0 on end of data or connection error,
+ * -1 if the file could not be written
+ */
+GLOBALDEF int FtpReadFd(int fd, long long int offset, int max, netbuf *nData)
+{
+    char buf[FTPLIB_BUFSIZ];
+    int i;
+    if (nData->dir != FTPLIB_READ || max <= 0)
+        return 0;
+#if defined(FTPLIB_USE_SPLICE)
+    // ASCII 변환이나 사용자 영역 TLS 복호화가 필요한 경우는 사용자 영역을 거쳐야 한다
+    if ((nData->buf == NULL) && ktls_direct(nData, FTPLIB_KTLS_RECV) && !nData->nosplice)
+    {
+        if (socket_wait(nData) != 1)
+            return 0;
+        i = splice_read(fd, offset, shape_max(nData, max), nData);
+        if (i == -2)
+            return -1;
+        if (i != -1)
+        {
+            nData->ktlsrecord = 0;
+            if (i == 0 || !data_progress(nData, i))
                 return 0;
-            nData->xfered1 = 0;
+            return i;
         }
+        // 커널 TLS 수신은 데이터가 아닌 레코드 (세션 티켓, close_notify) 에서 splice 가 실패하므로
+        // 이번 읽기만 SSL_read 로 처리한다. 연속으로 실패하면 splice 를 사용하지 않는다
+        if ((nData->tls == NULL) || (++nData->ktlsrecord > 1))
+            nData->nosplice = 1;
+    }
+#endif
+    if (max > (int)sizeof(buf))
+        max = sizeof(buf);
+    i = FtpRead(buf, max, nData);
+    if (i <= 0)
+        return 0;
+    if (!write_full(fd, buf, i, offset))
+    {
+        strncpy(nData->ctrl->response, strerror(errno),
+                sizeof(nData->ctrl->response));
+        return -1;
     }
     return i;
 }
+#endif
 
 /*
  * FtpWrite - write to a data connection
@@ -1238,11 +2929,15 @@ GLOBALDEF int FtpWrite(const void *buf, int len, netbuf *nData)
         i = writeline(buf, len, nData);
     else
     {
-        socket_wait(nData);
-        i = net_write(nData->handle, buf, len);
+        // 정체된 경우만 중지. 콜백의 반환값은 기존처럼 무시한다
+        if (!socket_wait(nData) && nData->stalled)
+            return 0;
+        i = nb_write(nData, buf, len);
     }
     if (i == -1)
         return 0;
+    shape_wait(nData, i);
+    data_keepalive(nData);
     nData->xfered += i;
     if (nData->idlecb && nData->cbbytes)
     {
@@ -1256,12 +2951,209 @@ GLOBALDEF int FtpWrite(const void *buf, int len, netbuf *nData)
     return i;
 }
 
+#if !defined(_WIN32)
+#if defined(FTPLIB_USE_SENDFILE)
+/*
+ * send_file - send part of a file on the data socket with sendfile()
+ *
+ * return bytecount, 0 at end of file, -1 on error, -2 if sendfile is
+ * not supported for this file/socket
+ */
+static int send_file(int fd, long long int offset, int max, netbuf *nData)
+{
+#if defined(__APPLE__)
+    off_t len;
+    for (;;)
+    {
+        len = max;
+        if (sendfile(fd, nData->handle, (off_t)offset, &len, NULL, 0) == 0)
+            return (int)len;
+        // 중간에 중단된 경우도 -1 을 반환하며, len 에 보낸 길이가 들어 있다
+        if ((errno == EINTR || errno == EAGAIN) && len > 0)
+            return (int)len;
+        if (errno == EINTR)
+            continue;
+        if (errno == ENOTSOCK || errno == ENOTSUP || errno == EOPNOTSUPP)
+            return -2;
+        break;
+    }
+#else
+    off_t off = (off_t)offset;
+    ssize_t len;
+#if defined(FTPLIB_USE_KTLS)
+    // 커널 TLS 송신이 적용된 경우, 레코드 상태를 OpenSSL 과 맞추도록 SSL_sendfile 사용
+    if (nData->tls != NULL)
+    {
+        ossl_ssize_t sent = SSL_sendfile((SSL *)nData->tls, fd, off, (size_t)max, 0);
+        if (sent >= 0)
+            return (int)sent;
+        ERR_clear_error();
+        if (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)
+            return -2;
+        strncpy(nData->ctrl->response, strerror(errno),
+                sizeof(nData->ctrl->response));
+        return -1;
+    }
+#endif
+    do
+        len = sendfile(nData->handle, fd, &off, max);
+    while (len == -1 && errno == EINTR);
+    if (len >= 0)
+        return (int)len;
+    if (errno == EINVAL || errno == ENOSYS)
+        return -2;
+#endif
+    strncpy(nData->ctrl->response, strerror(errno),
+            sizeof(nData->ctrl->response));
+    return -1;
+}
+#endif
+
+/*
+ * FtpWriteFd - write part of a file to a data connection
+ *
+ * Linux/Apple 의 바이너리 전송은 sendfile() 로 파일에서 소켓으로 바로 보내고 (TLS 는 커널 TLS 송신인 경우만),
+ * 그 외에는 pread() 후 FtpWrite() 로 보낸다.
+ *
+ * return bytecount, 0 at end of file, -1 on error
+ */
+GLOBALDEF int FtpWriteFd(int fd, long long int offset, int max, netbuf *nData)
+{
+    char buf[FTPLIB_BUFSIZ];
+    ssize_t l;
+    int i, c;
+    if (nData->dir != FTPLIB_WRITE || max <= 0)
+        return -1;
+    // 전송량 콜백이 지정한 간격마다 호출되도록 나눠서 보낸다
+    if (nData->idlecb && nData->cbbytes && max > nData->cbbytes)
+        max = nData->cbbytes;
+#if defined(FTPLIB_USE_SENDFILE)
+    // ASCII 변환이나 사용자 영역 TLS 암호화가 필요한 경우는 사용자 영역을 거쳐야 한다
+    if ((nData->buf == NULL) && ktls_direct(nData, FTPLIB_KTLS_SEND) && !nData->nosendfile)
+    {
+        if (!socket_wait(nData) && nData->stalled)
+            return -1;
+        i = send_file(fd, offset, shape_max(nData, max), nData);
+        if (i != -2)
+        {
+            if (i > 0 && !data_progress(nData, i))
+                return -1;
+            return i;
+        }
+        nData->nosendfile = 1;
+    }
+#endif
+    if (max > (int)sizeof(buf))
+        max = sizeof(buf);
+    do
+        l = pread(fd, buf, max, (off_t)offset);
+    while (l == -1 && errno == EINTR);
+    if (l <= 0)
+    {
+        if (l == -1)
+            strncpy(nData->ctrl->response, strerror(errno),
+                    sizeof(nData->ctrl->response));
+        return (int)l;
+    }
+    for (i = 0; i < l; i += c)
+    {
+        c = FtpWrite(buf + i, (int)l - i, nData);
+        if (c <= 0)
+            return -1;
+    }
+    return i;
+}
+#endif
+
+/*
+ * 데이터 접속 자원 해제
+ *
+ * return control connection of the data connection (may be NULL)
+ */
+static netbuf *data_close(netbuf *nData)
+{
+    netbuf *ctrl;
+    if (nData->buf)
+        free(nData->buf);
+#if defined(FTPLIB_USE_SPLICE)
+    if (nData->haspipe)
+    {
+        close(nData->pipefd[0]);
+        close(nData->pipefd[1]);
+    }
+#endif
+#if defined(FTPLIB_USE_OPENSSL)
+    // 업로드 완료를 서버가 확인할 수 있도록 close_notify 전송 후 종료
+    tls_close(nData);
+#endif
+    shutdown(nData->handle,2);
+    net_close(nData->handle);
+    shape_stop(nData);
+    ctrl = nData->ctrl;
+    if (ctrl != NULL && !nData->stalled)
+        data_rate(ctrl, nData);
+    free(nData);
+    if (ctrl != NULL)
+        ctrl->data = NULL;
+    return ctrl;
+}
+
+/*
+ * FtpAbort - stop a transfer before the end of data
+ *
+ * ABOR 를 보내고 데이터 접속을 닫은 뒤, 전송 결과 응답(226/426/451)과
+ * ABOR 응답(225/226), 전송 중 보낸 NOOP 응답을 모두 읽는다.
+ * 응답이 FTPLIB_ABORT_TIMEOUT 안에 오지 않으면 제어 접속을 재사용할 수 없는 상태로 표시한다.
+ *
+ * return 1 if the control connection is ready for the next command, 0 otherwise
+ */
+GLOBALDEF int FtpAbort(netbuf *nData)
+{
+    netbuf *ctrl;
+    int replies, rv = 1;
+    if ((nData->dir != FTPLIB_READ) && (nData->dir != FTPLIB_WRITE))
+        return 0;
+    ctrl = nData->ctrl;
+    // 정체된 서버는 ABOR 에도 응답하지 않을 수 있다
+    if ((ctrl == NULL) || nData->stalled)
+    {
+        FtpClose(nData);
+        return 0;
+    }
+    if (ftplib_debug > 2)
+        fprintf(stderr,"ABOR\n");
+    if (nb_write(ctrl, "ABOR\r\n", 6) != 6)
+        rv = 0;
+    ctrl->lastcmd = ftp_now();
+    // 서버가 보내는 중인 데이터는 읽지 않고 버린다
+    data_close(nData);
+    for (replies = ctrl->noops + 2; rv && (replies > 0); replies--)
+    {
+        if (!reply_wait(ctrl, FTPLIB_ABORT_TIMEOUT))
+        {
+            strcpy(ctrl->response, "timed out waiting for ABOR reply");
+            rv = 0;
+            break;
+        }
+        // 응답 코드는 서버와 시점에 따라 다르므로 읽기 실패만 확인한다
+        ctrl->response[0] = '\0';
+        readresp('2', ctrl);
+        if (ctrl->response[0] == '\0')
+            rv = 0;
+    }
+    ctrl->noops = 0;
+    if (!rv)
+        ctrl->desync = 1;
+    return rv;
+}
+
 /*
  * FtpClose - close a data connection
  */
 GLOBALDEF int FtpClose(netbuf *nData)
 {
     netbuf *ctrl;
+    int stalled = nData->stalled;
     switch (nData->dir)
     {
         case FTPLIB_WRITE:
@@ -1269,30 +3161,41 @@ GLOBALDEF int FtpClose(netbuf *nData)
             if (nData->buf != NULL)
                 writeline(NULL, 0, nData);
         case FTPLIB_READ:
-            if (nData->buf)
-                free(nData->buf);
-            shutdown(nData->handle,2);
-            net_close(nData->handle);
-            ctrl = nData->ctrl;
-            free(nData);
+            ctrl = data_close(nData);
             // ctrl is NULL. Why? All this does is fix the bug. I don't know if
             // there's an underlying issue with the lib.
             if (ctrl == NULL)
                 return 1;
-            ctrl->data = NULL;
-            if (ctrl && ctrl->response[0] != '4' && ctrl->response[0] != 5)
+            // 정체된 서버는 전송 결과 응답도 보내지 않을 수 있으므로 기다리지 않는다.
+            // 응답 순서가 어긋난 제어 접속은 FtpQuit 대신 FtpClose 로 닫아야 한다
+            if (stalled)
+            {
+                ctrl->desync = 1;
+                return 0;
+            }
+            if (ctrl && ctrl->response[0] != '4' && ctrl->response[0] != '5')
             {
-                int resp = readresp('2', ctrl);
+                int resp;
+                // 전송 결과 응답을 기다리는 동안 다음 데이터 접속 요청
+                preopen_send(ctrl);
+                resp = readresp('2', ctrl);
+                resp = readresp_noops(resp, ctrl);
+                preopen_finish(ctrl);
                 return resp;
             }
-            return 1;
+            return readresp_noops(1, ctrl);
         case FTPLIB_CONTROL:
             if (nData->data)
             {
                 nData->ctrl = NULL;
                 FtpClose(nData->data);
             }
+            preopen_discard(nData);
+#if defined(FTPLIB_USE_OPENSSL)
+            tls_close(nData);
+#endif
             net_close(nData->handle);
+            free(nData->buf);
             free(nData);
             return 0;
     }
@@ -1370,6 +3273,7 @@ GLOBALDEF int FtpChdir(const char *path, netbuf *nControl)
     sprintf(buf,"CWD %s",path);
     if (!FtpSendCmd(buf,'2',nControl))
         return 0;
+    set_cwd(path, nControl);
     return 1;
 }
 
@@ -1380,6 +3284,8 @@ GLOBALDEF int FtpChdir(const char *path, netbuf *nControl)
  */
 GLOBALDEF int FtpCDUp(netbuf *nControl)
 {
+    // 상위 디렉토리의 절대 경로는 알 수 없으므로 결과와 관계없이 기록을 지운다
+    nControl->cwd[0] = '\0';
     if (!FtpSendCmd("CDUP",'2',nControl))
         return 0;
     return 1;
@@ -1421,6 +3327,9 @@ GLOBALDEF int FtpPwd(char *path, int max, netbuf *nControl)
     while ((--l) && (*s) && (*s != '"'))
         *b++ = *s++;
     *b++ = '\0';
+    // 잘리지 않은 경우에만 작업 디렉토리 기록
+    if (*s == '"')
+        set_cwd(path, nControl);
     return 1;
 }
 
@@ -1437,6 +3346,7 @@ static int FtpXfer(const char *localfile, const char *path,
     FILE *local = NULL;
     netbuf *nData;
     int rv=1;
+    int iosize = io_size(nControl);
     
     if (localfile != NULL)
     {
@@ -1468,10 +3378,22 @@ static int FtpXfer(const char *localfile, const char *path,
         }
         return 0;
     }
-    dbuf = malloc(FTPLIB_BUFSIZ);
+    dbuf = malloc(iosize);
+#if !defined(_WIN32)
+    if (typ == FTPLIB_FILE_WRITE && localfile != NULL && mode == FTPLIB_IMAGE)
+    {
+        // 바이너리 파일 전송은 사용자 버퍼를 거치지 않는다
+        long long int sent = 0;
+        while ((l = FtpWriteFd(fileno(local), sent, FTPLIB_SENDFILE_SIZ, nData)) > 0)
+            sent += l;
+        if (l < 0)
+            rv = 0;
+    }
+    else
+#endif
     if (typ == FTPLIB_FILE_WRITE)
     {
-        while ((l = (int)fread(dbuf, 1, FTPLIB_BUFSIZ, local)) > 0)
+        while ((l = (int)fread(dbuf, 1, iosize, local)) > 0)
         {
             if ((c = FtpWrite(dbuf, l, nData)) < l)
             {
@@ -1481,9 +3403,24 @@ static int FtpXfer(const char *localfile, const char *path,
             }
         }
     }
+#if !defined(_WIN32)
+    else if (localfile != NULL && mode == FTPLIB_IMAGE)
+    {
+        // 바이너리 파일 저장은 사용자 버퍼를 거치지 않는다
+        long long int written = 0;
+        while ((l = FtpReadFd(fileno(local), written, FTPLIB_SPLICE_PIPESIZ, nData)) > 0)
+            written += l;
+        if (l < 0)
+        {
+            if (ftplib_debug)
+                perror("localfile write");
+            rv = 0;
+        }
+    }
+#endif
     else
     {
-        while ((l = FtpRead(dbuf, FTPLIB_BUFSIZ, nData)) > 0)
+        while ((l = FtpRead(dbuf, iosize, nData)) > 0)
         {
             if (fwrite(dbuf, 1, l, local) == 0)
             {
@@ -1508,8 +3445,13 @@ static int FtpXfer(const char *localfile, const char *path,
  *
  * 데이터 / 디렉토리 읽기 전용 메쏘드이며, 쓰기 용도로 사용해선 안 된다
  *
+ * - 데이터 접속에서 버퍼로 바로 읽으므로, NUL 이 포함된 바이너리 데이터도 잘리지 않는다
+ * - 받을 길이가 정해진 경우는 처음부터 그 크기로 할당하고, 아닌 경우는 두 배씩 늘린다
+ * - 결과는 항상 NUL 로 끝나므로, 목록은 그대로 문자열로 사용할 수 있다
+ *
  * @return 성공시 1 반환, 실패시 0 반환
- * @param bufferData 버퍼데이터 char 이중 포인터. 필요시 이 메쏘드 내부에서 초기화 실행
+ * @param bufferData 버퍼데이터 char 이중 포인터. NULL 이 아닌 경우 malloc 으로 할당된 버퍼로 보고 재사용한다. 사용 후 free 로 해제
+ * @param dataLength 받은 길이를 반환할 포인터. 불필요시 NULL 지정
  * @param FTP 파일 경로
  * @param offset 다운로드 시작점. 불필요시 0으로 지정
  * @param length 다운로드 받을 길이. 불필요시 0으로 지정
@@ -1518,6 +3460,7 @@ static int FtpXfer(const char *localfile, const char *path,
  * @param mode 전송 모드. 바이너리/아스키/이미지 중에서 선택.
  */
 static int FtpXferReadData(char **bufferData,
+                           long long int *dataLength,
                            const char *path,
                            long long int offset,
                            long long int length,
@@ -1525,88 +3468,65 @@ static int FtpXferReadData(char **bufferData,
                            int typ,
                            int mode)
 {
-    char *dbuf;
+    char *buf;
     netbuf *nData;
-    int rv=1;
+    size_t used = 0;
+    size_t capacity;
+    size_t room;
+    int iosize = io_size(nControl);
+    int l, rv=1;
     
+    if (dataLength != NULL)
+        *dataLength = 0;
     if (!FtpAccess(path, typ, mode, offset, nControl, &nData))
     {
         return 0;
     }
     
-    // bufferData가 초기화되지 않은 경우, 초기화
-    if (*bufferData == NULL) {
-        *bufferData = (char *)malloc(sizeof(char) * FTPLIB_BUFFER_LENGTH);
+    // 받을 길이를 아는 경우는 한 번에 할당. 마지막 널값 자리를 더한다
+    capacity = (length > 0) ? (size_t)length + 1 : FTPLIB_BUFFER_LENGTH;
+    if ((buf = realloc(*bufferData, capacity)) == NULL)
+    {
+        strncpy(nControl->response, strerror(errno),
+                sizeof(nControl->response));
+        FtpClose(nData);
+        return 0;
     }
+    *bufferData = buf;
     
-    int isAborted = 0;
-    dbuf = malloc(FTPLIB_BUFSIZ);
-    while ((FtpRead(dbuf, FTPLIB_BUFSIZ, nData)) > 0)
-    {
-        long long int bufferLength = strlen(*bufferData);
-        long long int dbufLength = strlen(dbuf);
-        long long int totalLength = bufferLength + dbufLength;
-        
-        // 현재 bufferData 에 dbuf를 추가한 경우, 메모리 증가가 필요한지 여부를 확인
-        int multiple = ((int)totalLength / FTPLIB_BUFFER_LENGTH) + 1;
-        if (bufferLength < multiple * FTPLIB_BUFFER_LENGTH) {
-            // 메모리 증대 필요시
-            // realloc 실행
-            // https://woo-dev.tistory.com/124
-            char *tempBuffer = *bufferData;
-            *bufferData = (char *)realloc(*bufferData, multiple * FTPLIB_BUFFER_LENGTH);
-            if (bufferData == NULL) {
-                // 실패시 기존 포인터를 해제하고 중지 처리
-                free(tempBuffer);
-                break;
-            }
-        }
-        
-        char *strippedDbuf;
-        if (length > 0 &&
-            totalLength > length) {
-            long long int stripLength = dbufLength - (totalLength - length);
-            strippedDbuf = (char *)malloc(stripLength + 1);
-            strncpy(strippedDbuf, dbuf, stripLength);
-            strippedDbuf[stripLength + 1] = 0;
-            isAborted = 1;
-        }
-        else {
-            strippedDbuf = dbuf;
-        }
-        
-        // bufferData에 strippedDbuf를 추가
-        if (strcat(*bufferData, strippedDbuf) == NULL)
+    for (;;)
+    {
+        if ((length > 0) && (used >= (size_t)length))
+            break;
+        // 남은 공간이 한 번에 읽을 길이보다 작은 경우 두 배로 늘린다
+        if ((length <= 0) && (capacity - used - 1 < (size_t)iosize))
         {
-            if (ftplib_debug)
-                perror("data read error");
-            
-            rv = 0;
-            // 스트립 발생시 strippedDbuf 해제
-            if (isAborted == 1) {
-                free(strippedDbuf);
+            char *grown = realloc(buf, capacity * 2);
+            if (grown == NULL)
+            {
+                if (ftplib_debug)
+                    perror("data read error");
+                rv = 0;
+                break;
             }
-            break;
+            *bufferData = buf = grown;
+            capacity *= 2;
         }
-        
-        // 스트립 발생시
-        // strippedDbuf 해제
-        // 전체 길이가 정해진 길이를 초과한 경우이므로 중지
-        if (isAborted == 1) {
-            free(strippedDbuf);
+        room = capacity - used - 1;
+        if (room > FTPLIB_IOSIZE_MAX)
+            room = FTPLIB_IOSIZE_MAX;
+        if ((l = FtpRead(buf + used, (int)room, nData)) <= 0)
             break;
-        }
+        used += l;
     }
+    buf[used] = '\0';
+    if (dataLength != NULL)
+        *dataLength = (long long int)used;
     
-    free(dbuf);
-    
-    if (isAborted == 0) {
-        FtpClose(nData);
-    }
-    else {
-        // 중지 발생시
-        
-    }
+    // 정해진 길이를 받은 경우는 서버의 전송 도중에 닫으므로, 결과 응답이 실패여도 성공으로 본다
+    if (!FtpClose(nData) &&
+        ((length <= 0) || (used < (size_t)length)))
+        rv = 0;
     return rv;
 }
 /*
@@ -1636,13 +3556,18 @@ GLOBALDEF int FtpDir(const char *outputfile, const char *path, netbuf *nControl)
  * LIST command 전송, 결과를 Data 포인터로 쓴다
  *
  * @return 1 if successful, 0 otherwise
- * @param bufferData: 결과를 쓸 이중 포인터
+ * @param bufferData: 결과를 쓸 이중 포인터. 결과는 NUL 로 끝나며, 사용 후 free 로 해제
+ * @param dataLength: 받은 길이를 반환할 포인터. 불필요시 NULL
  * @param path: FTP 경로
  * @param nControl: 접속할 FTP 주소/정보가 격납된 netbuf 포인터
  */
-GLOBALDEF int FtpDirData(char **bufferData, const char *path, netbuf *nControl)
+GLOBALDEF int FtpDirData(char **bufferData,
+                         long long int *dataLength,
+                         const char *path,
+                         netbuf *nControl)
 {
     return FtpXferReadData(bufferData,
+                           dataLength,
                            path,
                            0,
                            0,
@@ -1700,8 +3625,7 @@ GLOBALDEF int FtpSize(const char *path, unsigned int *size, char mode, netbuf *n
     
     if ((strlen(path) + 7) > sizeof(cmd))
         return 0;
-    sprintf(cmd, "TYPE %c", mode);
-    if (!FtpSendCmd(cmd, '2', nControl))
+    if (!FtpType(mode, nControl))
         return 0;
     sprintf(cmd,"SIZE %s",path);
     if (!FtpSendCmd(cmd, '2', nControl))
@@ -1730,8 +3654,7 @@ GLOBALDEF int FtpSizeLong(const char *path, fsz_t *size, char mode, netbuf *nCon
     
     if ((strlen(path) + 7) > sizeof(cmd))
         return 0;
-    sprintf(cmd, "TYPE %c", mode);
-    if (!FtpSendCmd(cmd, '2', nControl))
+    if (!FtpType(mode, nControl))
         return 0;
     sprintf(cmd,"SIZE %s",path);
     if (!FtpSendCmd(cmd,'2',nControl))
@@ -1767,6 +3690,103 @@ GLOBALDEF int FtpModDate(const char *path, char *dt, int max, netbuf *nControl)
     return rv;
 }
 
+/*
+ * FtpFeatures - determine the features supported by the server
+ *
+ * return FTPLIB_FEAT_* flags, 0 if the control connection failed
+ */
+GLOBALDEF int FtpFeatures(netbuf *nControl)
+{
+    char body[RESPONSE_BUFSIZ * 4];
+    char *s;
+    int features = FTPLIB_FEAT_CHECKED;
+
+    if (nControl->features != 0)
+        return nControl->features;
+    if (!send_cmd("FEAT", '2', body, sizeof(body), nControl))
+    {
+        // 4xx/5xx 는 FEAT 미지원. 응답이 없으면 다음에 다시 확인한다
+        if (nControl->response[0] != '4' && nControl->response[0] != '5')
+            return 0;
+        nControl->features = features;
+        return features;
+    }
+    // 기능 줄은 " MLST type*;size*;" 처럼 공백으로 시작한다
+    // 여러 접속에서 동시에 호출되므로 strtok 대신 직접 줄을 나눈다
+    for (s = body; *s != '\0'; s += strspn(s, "\r\n"))
+    {
+        char *line = s;
+        s += strcspn(s, "\r\n");
+        if (*s != '\0')
+            *s++ = '\0';
+        while (*line == ' ')
+            line++;
+        if (is_cmd(line, "MLST"))
+            features |= FTPLIB_FEAT_MLST;
+        else if (is_cmd(line, "SIZE"))
+            features |= FTPLIB_FEAT_SIZE;
+        else if (is_cmd(line, "MDTM"))
+            features |= FTPLIB_FEAT_MDTM;
+    }
+    nControl->features = features;
+    return features;
+}
+
+/**
+ * FtpMlsdData
+ *
+ * MLSD command 전송, 결과를 Data 포인터로 쓴다
+ *
+ * @return 1 if successful, 0 otherwise
+ * @param bufferData: 결과를 쓸 이중 포인터. 결과는 NUL 로 끝나며, 사용 후 free 로 해제
+ * @param dataLength: 받은 길이를 반환할 포인터. 불필요시 NULL
+ * @param path: FTP 경로
+ * @param nControl: 접속할 FTP 주소/정보가 격납된 netbuf 포인터
+ */
+GLOBALDEF int FtpMlsdData(char **bufferData,
+                          long long int *dataLength,
+                          const char *path,
+                          netbuf *nControl)
+{
+    return FtpXferReadData(bufferData,
+                           dataLength,
+                           path,
+                           0,
+                           0,
+                           nControl,
+                           FTPLIB_MLSD,
+                           FTPLIB_ASCII);
+}
+
+/*
+ * FtpMlst - determine the facts of a single remote path
+ *
+ * return 1 if successful, 0 otherwise
+ */
+GLOBALDEF int FtpMlst(const char *path, char *facts, int max, netbuf *nControl)
+{
+    char buf[TMP_BUFSIZ];
+    char body[RESPONSE_BUFSIZ];
+    char *s;
+    int l;
+
+    if ((strlen(path) + 6) > sizeof(buf) || max <= 0)
+        return 0;
+    sprintf(buf, "MLST %s", path);
+    if (!send_cmd(buf, '2', body, sizeof(body), nControl))
+        return 0;
+    // 사실 줄은 응답의 첫 중간 줄. 한 줄로 온 응답은 형식 오류로 본다
+    s = body;
+    while (*s == ' ')
+        s++;
+    l = strcspn(s, "\r\n");
+    if (l == 0 || l >= max)
+        return 0;
+    memcpy(facts, s, l);
+    facts[l] = '\0';
+    return 1;
+}
+
 /*
  * FtpGet - issue a GET command and write received data to output
  *
@@ -1783,13 +3803,15 @@ GLOBALDEF int FtpGet(const char *outputfile, const char *path,
  * - Get Command 로 정해진 위치에서 정해진 길이만큼의 데이터를 다운로드 받는 메쏘드
  *
  * @return 성공시 1 반환. 실패시 0 반환
- * @param bufferData 결과를 쓸 이중 포인터
+ * @param bufferData 결과를 쓸 이중 포인터. 사용 후 free 로 해제
+ * @param dataLength 받은 길이를 반환할 포인터. 불필요시 NULL
  * @param path FTP 경로
  * @param offset 다운로드 개시 위치
  * @param length 다운로드 길이
  * @param nControl 접속할 FTP 주소/정보가 격납된 netbuf 포인터
  */
 GLOBALDEF int FtpGetData(char **bufferData,
+                         long long int *dataLength,
                          const char *path,
                          char mode,
                          long long int offset,
@@ -1797,6 +3819,7 @@ GLOBALDEF int FtpGetData(char **bufferData,
                          netbuf *nControl)
 {
     return FtpXferReadData(bufferData,
+                           dataLength,
                            path,
                            offset,
                            length,
@@ -1863,6 +3886,10 @@ GLOBALDEF void FtpQuit(netbuf *nControl)
     if (nControl->dir != FTPLIB_CONTROL)
         return;
     FtpSendCmd("QUIT",'2', nControl);
+    preopen_discard(nControl);
+#if defined(FTPLIB_USE_OPENSSL)
+    tls_close(nControl);
+#endif
     net_close(nControl->handle);
     free(nControl->buf);
     free(nControl);
@@ -40,7 +40,10 @@
 #define FTPLIB_DIR_VERBOSE              2
 #define FTPLIB_FILE_READ                3
 #define FTPLIB_FILE_READ_OFFSET         4
+#define FTPLIB_MLSD                     5
 #define FTPLIB_FILE_WRITE               9
+#define FTPLIB_FILE_WRITE_OFFSET        10
+#define FTPLIB_FILE_APPEND              11
 #define FTPLIB_ABORT                    99
 
 /* FtpAccess() mode codes */
@@ -59,6 +62,46 @@
 #define FTPLIB_IDLETIME 3
 #define FTPLIB_CALLBACKARG 4
 #define FTPLIB_CALLBACKBYTES 5
+// 전송 중 제어 접속으로 NOOP을 보내는 간격 (밀리초). 0 이면 사용 안함
+#define FTPLIB_KEEPALIVE 6
+// 0 이 아닌 경우 PASV 응답의 주소를 무시하고 제어 접속 주소로 데이터 접속
+#define FTPLIB_PASVPEER 7
+// 0 인 경우 EPSV 를 사용하지 않고 바로 PASV 사용. 기본값은 1
+#define FTPLIB_EPSV 8
+// 0 이 아닌 경우 전송 완료시 다음 전송에 사용할 패시브 데이터 접속을 미리 연다
+#define FTPLIB_PREOPEN 9
+// 데이터 접속에서 이 시간(밀리초) 동안 읽거나 쓸 수 없으면 전송 중지. 0 이면 사용 안함
+#define FTPLIB_STALLTIME 10
+// 0 이 아닌 경우 제어 접속에 TCP_NODELAY 지정. 파이프라이닝한 명령이 지연 없이 전송된다
+#define FTPLIB_NODELAY 11
+// 데이터 소켓 버퍼(SO_RCVBUF/SO_SNDBUF) 크기 (bytes).
+// 0 이면 시스템 기본값, -1 이면 측정한 RTT 와 전송률로 자동 조정
+#define FTPLIB_SOCKBUF 12
+// FtpGet/FtpPut 등에서 한 번에 읽고 쓰는 버퍼 크기 (bytes). 0 이면 FTPLIB_BUFSIZ
+#define FTPLIB_IOSIZE 13
+// 이 접속의 전송마다 적용할 최대 전송률 (bytes/초). 0 이면 제한 없음
+#define FTPLIB_RATELIMIT 14
+// 전송률 제한을 함께 적용받는 전송끼리 나눠 가질 때의 가중치. 기본값 1
+#define FTPLIB_WEIGHT 15
+// 전송률 제한을 함께 적용받는 그룹 (FtpShaper *). 0 이면 그룹 없음
+#define FTPLIB_SHAPER 16
+
+/* FtpAuthTLS() flags */
+// 서버 인증서를 확인하지 않는다 (자체 서명 인증서 테스트용)
+#define FTPLIB_TLS_NOVERIFY 1
+// 데이터 접속은 암호화하지 않는다 (PROT C)
+#define FTPLIB_TLS_CLEARDATA 2
+
+/* FtpFeatures() flags */
+// FEAT 응답을 받았는지 여부. 서버가 FEAT 를 지원하지 않아도 설정된다
+#define FTPLIB_FEAT_CHECKED 1
+#define FTPLIB_FEAT_MLST 2
+#define FTPLIB_FEAT_SIZE 4
+#define FTPLIB_FEAT_MDTM 8
+
+/* FtpTLSOffload() flags */
+#define FTPLIB_KTLS_SEND 1
+#define FTPLIB_KTLS_RECV 2
 
 /* Buffer Length */
 // 디렉토리/데이터 읽기에 사용되는 버퍼 크기
@@ -68,6 +111,35 @@
 #define RESPONSE_BUFSIZ 1024
 #define TMP_BUFSIZ 1024
 #define ACCEPT_TIMEOUT 30
+// 접속 제한 시간 (초)
+#define FTPLIB_CONNECT_TIMEOUT 20
+// 다음 주소로 접속을 시작하기 전 대기 시간 (밀리초)
+#define FTPLIB_CONNECT_STAGGER 250
+// 미리 열어 둔 데이터 접속을 사용할 수 있는 시간 (밀리초)
+#define FTPLIB_PREOPEN_MAXAGE 10000
+// FtpReadFd 의 splice 파이프 크기
+#define FTPLIB_SPLICE_PIPESIZ 1048576
+// FtpXfer 에서 FtpWriteFd 로 한 번에 보내는 최대 길이
+#define FTPLIB_SENDFILE_SIZ 1048576
+// FTPLIB_SOCKBUF 자동 조정 범위
+#define FTPLIB_SOCKBUF_MIN 65536
+#define FTPLIB_SOCKBUF_MAX 16777216
+// 전송률 측정에 사용하는 최소 전송 길이
+#define FTPLIB_RATE_MINBYTES 262144
+// ABOR 응답 대기 시간 (밀리초)
+#define FTPLIB_ABORT_TIMEOUT 5000
+// 유휴 접속 상태 확인 NOOP 응답 대기 시간 (밀리초)
+#define FTPLIB_PING_TIMEOUT 5000
+// 파이프라인 로그인 응답 대기 시간 (밀리초). 지나면 파이프라이닝을 거부한 서버로 본다
+#define FTPLIB_PIPELINE_TIMEOUT 10000
+// FTPLIB_IOSIZE 최대값
+#define FTPLIB_IOSIZE_MAX 4194304
+// 전송률 제한시 쉬는 동안 쌓아 둘 수 있는 최대 전송 시간 (밀리초)
+#define FTPLIB_SHAPE_BURST 100
+// 전송률 제한시 전송별 사용량을 측정하는 간격 (밀리초)
+#define FTPLIB_SHAPE_WINDOW 500
+// 주소 해석 결과 유지 시간 기본값 (초)
+#define FTPLIB_RESOLVER_TTL 60
 
 #define FTPLIB_CONTROL 0
 #define FTPLIB_READ 1
@@ -84,6 +156,7 @@ typedef uint32_t fsz_t;
 #endif
 
 typedef struct NetBuf netbuf;
+typedef struct FtpShaper FtpShaper;
 typedef int (*FtpCallback)(netbuf *nControl, fsz_t xfered, void *arg);
 
 typedef struct FtpCallbackOptions {
@@ -109,23 +182,246 @@ struct NetBuf {
     unsigned long int cbbytes;
     unsigned long int xfered1;
     char response[RESPONSE_BUFSIZ];
+    // 제어 접속으로 마지막 명령을 보낸 시각 (밀리초)
+    long long int lastcmd;
+    // 전송 중 NOOP 전송 간격 (밀리초)
+    int keepalive;
+    // 응답을 아직 읽지 않은 NOOP 수
+    int noops;
+    // 서버에 설정된 전송 모드 (TYPE). 알 수 없는 경우 0
+    char type;
+    // 서버의 현재 작업 디렉토리 (절대 경로). 알 수 없는 경우 빈 문자열
+    char cwd[TMP_BUFSIZ];
+    // TLS 세션 (FTPLIB_USE_OPENSSL 빌드에서 SSL *). 평문 접속인 경우 NULL
+    void *tls;
+    // 데이터 접속 암호화 여부 (PROT P)
+    int prot;
+    // 다음 데이터 접속에서 재사용할 TLS 세션 (SSL_SESSION *)
+    void *tlssession;
+    // EPSV 지원 여부. 1 지원, 0 확인 전, -1 미지원
+    int epsv;
+    // PASV 응답 주소 대신 제어 접속 주소 사용 여부
+    int pasvpeer;
+    // 데이터 접속 미리 열기 사용 여부
+    int preopen;
+    // 응답을 아직 읽지 않은 미리 열기 명령. 0 없음, 1 EPSV, 2 PASV
+    int present;
+    // 미리 열어 둔 데이터 접속 소켓과 연 시각
+    int hasspare;
+    int spare;
+    long long int sparetime;
+    // 데이터 접속 정체 판단 시간 (밀리초). 0 이면 사용 안함
+    int stalltime;
+    // 데이터 접속이 정체되어 전송을 중지했는지 여부
+    int stalled;
+    // FtpReadFd 의 splice 용 파이프. haspipe 가 0 이면 아직 만들지 않은 상태
+    int haspipe;
+    int pipefd[2];
+    // splice 를 지원하지 않는 소켓/파일이라 복사로 대체하는지 여부
+    int nosplice;
+    // 커널 TLS 수신에서 splice 가 연속으로 실패한 횟수 (데이터가 아닌 레코드)
+    int ktlsrecord;
+    // sendfile 을 지원하지 않는 파일/소켓이라 복사로 대체하는지 여부
+    int nosendfile;
+    // 데이터 소켓 버퍼 크기. 0 시스템 기본값, -1 자동 조정
+    int sockbuf;
+    // 전송 버퍼 크기. 0 이면 FTPLIB_BUFSIZ
+    int iosize;
+    // 제어 접속 명령 왕복 시간의 최소값 (밀리초). 0 이면 측정 전
+    int rtt;
+    // 데이터 접속에서 측정한 최대 전송률 (bytes/초). 0 이면 측정 전
+    long long int rate;
+    // 데이터 접속을 연 시각 (밀리초)
+    long long int opened;
+    // 응답 순서를 알 수 없는 제어 접속인지 여부. 1 인 경우 재사용하지 말아야 한다
+    int desync;
+    // 전송마다 적용할 최대 전송률 (bytes/초). 0 이면 제한 없음
+    long long int ratelimit;
+    // 전송률 제한을 나눠 가질 때의 가중치
+    int weight;
+    // 전송률 제한을 함께 적용받는 그룹. NULL 이면 전역 제한만 적용
+    FtpShaper *shaper;
+    // 전송률 제한에 등록된 데이터 접속인지 여부
+    int shaping;
+    // 전송률 제한에 따라 다음 전송을 시작할 수 있는 시각 (밀리초)
+    double shapenext;
+    // 전송률 제한에 등록된 다음 데이터 접속
+    netbuf *shapelist;
+    // 사용량 측정 구간 시작 시각 (밀리초)과 구간의 전송 길이
+    double shapewindow;
+    long long int shapebytes;
+    // 측정한 사용량으로 정한 최대 전송률 (bytes/초). 0 이면 몫을 다 쓰고 있음
+    long long int shapedemand;
+    // 몫 계산용 (전역 제한, 그룹 제한). 최대 전송률과 고정 여부
+    long long int shapecap[2];
+    int shapefixed[2];
+    // FEAT 로 확인한 서버 기능 (FTPLIB_FEAT_*). 0 이면 확인 전
+    int features;
 };
 
 GLOBALREF int ftplib_debug;
 GLOBALREF void FtpInit(void);
 GLOBALREF char *FtpLastResponse(netbuf *nControl);
 GLOBALREF int FtpConnect(const char *host, netbuf **nControl);
+/**
+ * FtpResolverCache
+ *
+ * FtpConnect 의 주소 해석 결과 캐시 유지 시간 지정. 모든 접속이 캐시를 공유한다.
+ *
+ * @param ttl 유지 시간(초). 0 이하인 경우 캐시를 사용하지 않고 보관 중인 결과도 제거한다
+ */
+GLOBALDEF void FtpResolverCache(int ttl);
+/**
+ * FtpShaperNew
+ *
+ * 전송률 제한 그룹 생성. FTPLIB_SHAPER 로 같은 그룹을 지정한 접속의 전송들이
+ * 그룹의 전송률을 가중치(FTPLIB_WEIGHT)에 비례해서 나눠 가진다.
+ * 전송별 제한이나 서버 속도 때문에 몫을 다 쓰지 못하는 전송의 나머지는 다른 전송들이 나눠 가진다.
+ *
+ * @param rate 최대 전송률 (bytes/초). 0 이면 제한 없음
+ * @return 성공시 그룹 반환. 실패시 NULL 반환
+ */
+GLOBALREF FtpShaper *FtpShaperNew(long long int rate);
+/**
+ * FtpShaperRate
+ *
+ * 전송률 제한 그룹의 최대 전송률 변경. 진행 중인 전송에도 바로 적용된다.
+ *
+ * @param shaper 전송률 제한 그룹. NULL 인 경우 모든 전송에 적용되는 전역 제한을 변경한다
+ * @param rate 최대 전송률 (bytes/초). 0 이면 제한 없음
+ */
+GLOBALREF void FtpShaperRate(FtpShaper *shaper, long long int rate);
+/**
+ * FtpShaperFree
+ *
+ * 전송률 제한 그룹 해제. 그룹을 지정한 접속의 전송이 모두 끝난 후에 호출해야 한다.
+ */
+GLOBALREF void FtpShaperFree(FtpShaper *shaper);
 GLOBALREF int FtpOptions(int opt, long val, netbuf *nControl);
 GLOBALREF int FtpSetCallback(const FtpCallbackOptions *opt, netbuf *nControl);
 GLOBALREF int FtpClearCallback(netbuf *nControl);
 GLOBALREF int FtpLogin(const char *user, const char *pass, netbuf *nControl);
+/**
+ * FtpLoginPipelined
+ *
+ * USER, PASS, TYPE (utf8 인 경우 OPTS UTF8 ON 포함) 명령을 한번에 보낸 후 응답을 순서대로 확인한다.
+ * FtpLogin 후 TYPE 을 보내는 것보다 왕복 시간이 줄어든다.
+ * 실패한 경우 파이프라이닝을 지원하지 않는 서버일 수 있으므로, 재접속 후 FtpLogin 을 사용한다.
+ *
+ * @return 1 if logged in, 0 otherwise
+ * @param user 사용자명
+ * @param pass 암호
+ * @param mode TYPE 에 지정할 전송 모드 (FTPLIB_ASCII / FTPLIB_IMAGE)
+ * @param utf8 0 이 아닌 경우 OPTS UTF8 ON 전송
+ * @param nControl 제어 접속 netbuf 포인터
+ */
+GLOBALDEF int FtpLoginPipelined(const char *user, const char *pass, char mode, int utf8, netbuf *nControl);
+/**
+ * FtpAuthTLS
+ *
+ * AUTH TLS 로 제어 접속을 암호화하고 PBSZ 0, PROT P 를 전송한다. 로그인 전에 호출한다.
+ * 데이터 접속은 제어 접속의 TLS 세션을 재사용하며, 가능한 경우 커널 TLS를 사용한다.
+ * FTPLIB_USE_OPENSSL 로 빌드하지 않은 경우 항상 실패한다.
+ *
+ * @return 1 if successful, 0 otherwise
+ * @param host 인증서 확인과 SNI에 사용할 서버 주소. 포트가 포함되어 있어도 된다. NULL 이면 생략
+ * @param flags FTPLIB_TLS_NOVERIFY, FTPLIB_TLS_CLEARDATA 조합
+ * @param nControl 제어 접속 netbuf 포인터
+ */
+GLOBALDEF int FtpAuthTLS(const char *host, int flags, netbuf *nControl);
+/**
+ * FtpTLSOffload
+ *
+ * 데이터 접속에 커널 TLS가 적용되었는지 확인.
+ * FtpReadFd/FtpWriteFd 는 FTPLIB_KTLS_RECV/FTPLIB_KTLS_SEND 인 경우 TLS 전송에도 splice/sendfile 을 사용한다.
+ *
+ * @return FTPLIB_KTLS_SEND, FTPLIB_KTLS_RECV 조합. 사용하지 않는 경우 0
+ * @param nData 데이터 접속 netbuf 포인터
+ */
+GLOBALDEF int FtpTLSOffload(netbuf *nData);
 GLOBALREF int FtpAccess(const char *path, int typ, int mode, long long int offset, netbuf *nControl, netbuf **nData);
+/**
+ * FtpParseEpsv
+ *
+ * EPSV 응답 (229 ... (|||port|)) 에서 데이터 접속 포트 추출.
+ *
+ * @return 포트 번호. 형식이 맞지 않거나 범위를 벗어난 경우 0
+ * @param response 서버 응답
+ */
+GLOBALDEF unsigned int FtpParseEpsv(const char *response);
 GLOBALREF int FtpRead(void *buf, int max, netbuf *nData);
+#if !defined(_WIN32)
+/**
+ * FtpReadFd
+ *
+ * 데이터 접속에서 읽은 내용을 파일의 지정 위치에 바로 저장.
+ * Linux 의 바이너리 전송은 splice() 로 사용자 영역 복사 없이 옮기고,
+ * ASCII 전송, 커널 TLS 수신이 적용되지 않은 TLS 전송, 다른 플랫폼은 FtpRead 후 pwrite() 로 저장한다.
+ *
+ * @return 저장한 길이. 전송 끝이나 접속 실패시 0, 파일 저장 실패시 -1
+ * @param fd 저장할 파일 디스크립터
+ * @param offset 저장할 파일 위치
+ * @param max 최대 길이
+ * @param nData 데이터 접속 netbuf 포인터
+ */
+GLOBALREF int FtpReadFd(int fd, long long int offset, int max, netbuf *nData);
+#endif
 GLOBALREF int FtpWrite(const void *buf, int len, netbuf *nData);
+#if !defined(_WIN32)
+/**
+ * FtpWriteFd
+ *
+ * 파일의 지정 위치부터 읽어서 데이터 접속으로 전송.
+ * Linux/Apple 의 바이너리 전송은 sendfile() 로 사용자 영역 복사 없이 보내고
+ * (커널 TLS 송신이 적용된 Linux 의 TLS 전송은 SSL_sendfile),
+ * ASCII 전송과 그 외 TLS 전송은 pread() 후 FtpWrite 로 보낸다.
+ * 전송량 콜백(FTPLIB_CALLBACKBYTES)이 지정된 경우 그 간격보다 길게 보내지 않는다.
+ *
+ * @return 전송한 길이. 파일 끝이면 0, 실패시 -1
+ * @param fd 전송할 파일 디스크립터
+ * @param offset 전송할 파일 위치
+ * @param max 최대 길이
+ * @param nData 데이터 접속 netbuf 포인터
+ */
+GLOBALREF int FtpWriteFd(int fd, long long int offset, int max, netbuf *nData);
+#endif
 GLOBALREF int FtpClose(netbuf *nData);
+/**
+ * FtpAbort
+ *
+ * 전송을 끝까지 받지 않고 중지. ABOR 전송 후 데이터 접속을 닫고 응답을 모두 읽어서,
+ * 제어 접속을 다음 명령에 그대로 사용할 수 있게 한다. nData 는 해제된다.
+ *
+ * @return 제어 접속을 재사용할 수 있으면 1, 아니면 0. 0 인 경우 nControl->desync 가 1 로 설정된다
+ * @param nData 데이터 접속 netbuf 포인터
+ */
+GLOBALREF int FtpAbort(netbuf *nData);
 GLOBALREF int FtpSite(const char *cmd, netbuf *nControl);
 GLOBALREF int FtpSysType(char *buf, int max, netbuf *nControl);
 GLOBALREF int FtpSendCmd(const char *cmd, char expresp, netbuf *nControl);
+/**
+ * FtpKeepAlive
+ *
+ * 제어 접속 유지를 위해 NOOP 전송
+ * - 데이터 전송 중이 아닌 경우, NOOP 응답을 FTPLIB_PING_TIMEOUT 까지 기다린다.
+ *   시간 안에 응답이 없으면 nControl->desync 가 1 로 설정된다
+ * - 데이터 전송 중인 경우, 응답은 FtpClose 에서 전송 결과와 함께 읽는다
+ *
+ * @return 1 if successful, 0 otherwise
+ * @param nControl 제어 접속 netbuf 포인터
+ */
+GLOBALDEF int FtpKeepAlive(netbuf *nControl);
+/**
+ * FtpPing
+ *
+ * NOOP 전송 후 응답을 최대 ms 밀리초까지 기다린다
+ * - 시간 안에 응답이 없으면 nControl->desync 를 1 로 설정하므로, FtpQuit 대신 FtpClose 로 닫아야 한다
+ *
+ * @return 1 if successful, 0 otherwise
+ * @param ms 응답 대기 시간 (밀리초)
+ * @param nControl 제어 접속 netbuf 포인터
+ */
+GLOBALDEF int FtpPing(int ms, netbuf *nControl);
 GLOBALREF int FtpMkdir(const char *path, netbuf *nControl);
 GLOBALREF int FtpChdir(const char *path, netbuf *nControl);
 GLOBALREF int FtpCDUp(netbuf *nControl);
@@ -139,30 +435,76 @@ GLOBALREF int FtpDir(const char *output, const char *path, netbuf *nControl);
  * LIST command 전송, 결과를 Data 포인터로 쓴다
  *
  * @return 1 if successful, 0 otherwise
- * @param bufferData 결과를 쓸 이중 포인터
+ * @param bufferData 결과를 쓸 이중 포인터. 결과는 NUL 로 끝나며, 사용 후 free 로 해제
+ * @param dataLength 받은 길이를 반환할 포인터. 불필요시 NULL
  * @param path FTP 경로
  * @param nControl 접속할 FTP 주소/정보가 격납된 netbuf 포인터
  */
-GLOBALDEF int FtpDirData(char **bufferData, const char *path, netbuf *nControl);
+GLOBALDEF int FtpDirData(char **bufferData,
+                         long long int *dataLength,
+                         const char *path,
+                         netbuf *nControl);
 
 GLOBALREF int FtpSize(const char *path, unsigned int *size, char mode, netbuf *nControl);
 #if defined(__UINT64_MAX)
 GLOBALREF int FtpSizeLong(const char *path, fsz_t *size, char mode, netbuf *nControl);
 #endif
 GLOBALREF int FtpModDate(const char *path, char *dt, int max, netbuf *nControl);
+/**
+ * FtpFeatures
+ *
+ * FEAT 전송, 서버가 지원하는 기능을 반환
+ * - 결과는 접속마다 기억하고, 로그인 후 처음 호출할 때만 FEAT 를 보낸다
+ * - FEAT 를 지원하지 않는 서버는 FTPLIB_FEAT_CHECKED 만 반환한다
+ *
+ * @return FTPLIB_FEAT_* 조합. 제어 접속 오류시 0
+ * @param nControl 제어 접속 netbuf 포인터
+ */
+GLOBALDEF int FtpFeatures(netbuf *nControl);
+/**
+ * FtpMlsdData
+ *
+ * MLSD command 전송, 결과를 Data 포인터로 쓴다
+ * - 서버가 MLST 기능을 지원하는지 FtpFeatures 로 먼저 확인해야 한다
+ *
+ * @return 1 if successful, 0 otherwise
+ * @param bufferData 결과를 쓸 이중 포인터. 결과는 NUL 로 끝나며, 사용 후 free 로 해제
+ * @param dataLength 받은 길이를 반환할 포인터. 불필요시 NULL
+ * @param path FTP 경로
+ * @param nControl 접속할 FTP 주소/정보가 격납된 netbuf 포인터
+ */
+GLOBALDEF int FtpMlsdData(char **bufferData,
+                          long long int *dataLength,
+                          const char *path,
+                          netbuf *nControl);
+/**
+ * FtpMlst
+ *
+ * MLST command 전송, 경로 하나의 사실 (facts) 줄을 반환
+ * - "type=file;size=10;modify=20240101000000; /path" 형식. 앞의 공백과 줄 끝은 제거된다
+ *
+ * @return 1 if successful, 0 otherwise
+ * @param path FTP 경로
+ * @param facts 결과를 쓸 버퍼
+ * @param max facts 크기
+ * @param nControl 제어 접속 netbuf 포인터
+ */
+GLOBALDEF int FtpMlst(const char *path, char *facts, int max, netbuf *nControl);
 GLOBALREF int FtpGet(const char *output, const char *path, char mode, netbuf *nControl);
 /**
  * FtpGetData
  * - Get Command 로 정해진 위치에서 정해진 길이만큼의 데이터를 다운로드 받는 메쏘드
  *
  * @return 성공시 1 반환. 실패시 0 반환
- * @param bufferData 결과를 쓸 이중 포인터
+ * @param bufferData 결과를 쓸 이중 포인터. 바이너리 데이터도 잘리지 않으며, 사용 후 free 로 해제
+ * @param dataLength 받은 길이를 반환할 포인터. 불필요시 NULL
  * @param path FTP 경로
  * @param offset 다운로드 개시 위치
  * @param length 다운로드 길이
  * @param nControl 접속할 FTP 주소/정보가 격납된 netbuf 포인터
  */
 GLOBALDEF int FtpGetData(char **bufferData,
+                         long long int *dataLength,
                          const char *path,
                          char mode,
                          long long int offset,